@@ -81,10 +81,19 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK 0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS 0
+#define configGENERATE_RUN_TIME_STATS 1
 #define configUSE_TRACE_FACILITY 1
 #define configUSE_STATS_FORMATTING_FUNCTIONS 0
 
+/* Run time is counted in microseconds of the 64-bit hardware timer, which
+neither needs setting up nor wraps. Read by app/task_stats.cpp. */
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#ifndef __ASSEMBLER__
+#include "hardware/timer.h"
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() time_us_64()
+
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES 0
 #define configMAX_CO_ROUTINE_PRIORITIES 1
@@ -152,5 +161,6 @@ to exclude the API function. */
 #endif
 
 /* A header file that defines trace macro can be included here. */
+#include "trace_hooks.h"
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,358 @@
+#include "bench.h"
+
+#include <array>
+#include <iterator>
+#include <type_traits>
+
+#include "led_animation.h"
+#include "logging.h"
+#include "noise_floor.h"
+#include "response_curve.h"
+#include "sensor_math.h"
+#include "usb_midi_packet.h"
+
+namespace
+{
+// Inputs are read round robin from tables filled at compile time, large enough that the branches inside the kernels
+// cannot be learned from the iteration count
+constexpr size_t kNumInputs = 256;
+static_assert((kNumInputs & (kNumInputs - 1)) == 0, "Input count must be a power of two");
+
+// Same constants as midi_controller.cpp and cap_touch.cpp
+constexpr float kHallA1 = 0.80f;
+constexpr float kPitchBendHysteresis = 0.01f;
+constexpr float kStrikePositionMinWeight = 0.02f;
+constexpr float kRangeA1 = 0.50f;
+constexpr float kRangeMinMm = 5.0f;
+constexpr float kRangeMaxMm = 17.0f;
+constexpr uint32_t kCapBaseline = 20000;
+constexpr int32_t kTouchThresholdFactor = 20;
+constexpr uint32_t kTouchPressureMin = 50000;
+constexpr uint32_t kTouchPressureMax = 250000;
+
+constexpr uint32_t xorshift(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+constexpr std::array<uint32_t, kNumInputs> make_random(uint32_t seed)
+{
+    std::array<uint32_t, kNumInputs> table{};
+    uint32_t x = seed;
+    for (auto& value : table)
+    {
+        x = xorshift(x);
+        value = x;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, kNumInputs> kRandom = make_random(0x4D424E43);
+
+// 12-bit ADC readings wandering around the midpoint
+constexpr std::array<uint16_t, kNumInputs> make_adc()
+{
+    std::array<uint16_t, kNumInputs> table{};
+    for (size_t i = 0; i < kNumInputs; ++i)
+    {
+        table[i] = static_cast<uint16_t>(1024 + kRandom[i] % 2048);
+    }
+    return table;
+}
+
+// VL6180X ranges in mm, some out of the mapped span on either side
+constexpr std::array<uint8_t, kNumInputs> make_range()
+{
+    std::array<uint8_t, kNumInputs> table{};
+    for (size_t i = 0; i < kNumInputs; ++i)
+    {
+        table[i] = static_cast<uint8_t>(kRandom[i] % 24);
+    }
+    return table;
+}
+
+// Charge totals from untouched to pressed hard, a few under the baseline
+constexpr std::array<uint32_t, kNumInputs> make_cap_totals()
+{
+    std::array<uint32_t, kNumInputs> table{};
+    for (size_t i = 0; i < kNumInputs; ++i)
+    {
+        table[i] = kCapBaseline - 1000 + kRandom[i] % 300000;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, kNumInputs> kAdc = make_adc();
+constexpr std::array<uint8_t, kNumInputs> kRange = make_range();
+constexpr std::array<uint32_t, kNumInputs> kCapTotals = make_cap_totals();
+
+// The continuous kernels run on both arithmetics of sensor_math.h, whichever one the firmware is built with
+template <typename T>
+constexpr T value(float x)
+{
+    if constexpr (std::is_same_v<T, fixed::Q15>)
+    {
+        return fixed::q15(x);
+    }
+    else
+    {
+        return x;
+    }
+}
+
+template <typename T>
+using Accumulator = std::conditional_t<std::is_same_v<T, fixed::Q15>, fixed::Q31, float>;
+
+constexpr size_t input(uint32_t i, size_t offset = 0)
+{
+    return (i + offset) & (kNumInputs - 1);
+}
+
+// Three readings to the weighted displacement and the strike position, the Hall source and filter before the low pass
+template <typename T>
+void hall_weighting(uint32_t iterations)
+{
+    const T min_weight = value<T>(kStrikePositionMinWeight);
+    T position = value<T>(0.5f);
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        T hall1 = sensor_math::hall_deflection<T>(kAdc[input(i)]);
+        T hall2 = sensor_math::hall_deflection<T>(kAdc[input(i, 85)]);
+        T hall3 = sensor_math::hall_deflection<T>(kAdc[input(i, 170)]);
+        T weighted = sensor_math::hall_weighted(hall1, hall2, hall3);
+        position = sensor_math::strike_position(hall1, hall2, hall3, min_weight, position);
+        bench::keep(weighted);
+    }
+    bench::keep(position);
+}
+
+// The low pass, hysteresis and pitch bend scaling of the Hall pipeline
+template <typename T>
+void hall_iir(uint32_t iterations)
+{
+    const T a1 = value<T>(kHallA1);
+    const T hysteresis = value<T>(kPitchBendHysteresis);
+    Accumulator<T> state = {};
+    T last_sent = {};
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        state = sensor_math::one_pole(sensor_math::hall_deflection<T>(kAdc[input(i)]), state, a1);
+        T output = sensor_math::narrow(state);
+        if (sensor_math::exceeds_hysteresis(output, last_sent, hysteresis))
+        {
+            last_sent = output;
+            bench::keep(sensor_math::to_pitch_bend(output));
+        }
+    }
+    bench::keep(state);
+}
+
+// The range pipeline from the reading to the change test of the controller value
+template <typename T>
+void range_normalize(uint32_t iterations)
+{
+    const T a1 = value<T>(kRangeA1);
+    const T min = value<T>(kRangeMinMm / sensor_math::kRangeFullScaleMm);
+    const T max = value<T>(kRangeMaxMm / sensor_math::kRangeFullScaleMm);
+    Accumulator<T> state = {};
+    uint8_t last_cc = 0;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        state = sensor_math::one_pole(sensor_math::range_fraction<T>(kRange[input(i)]), state, a1);
+        uint8_t cc = sensor_math::to_cc(sensor_math::normalize_range(sensor_math::narrow(state), min, max));
+        if (cc != last_cc)
+        {
+            last_cc = cc;
+            bench::keep(cc);
+        }
+    }
+}
+
+// Response curve of a continuous mapping on Hall deflections, cycling through the curves that use a table
+template <typename T>
+void response_curve_apply(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        Curve curve = static_cast<Curve>(1 + i % (static_cast<uint32_t>(Curve::Count) - 1));
+        bench::keep(response_curve::apply(curve, sensor_math::hall_deflection<T>(kAdc[input(i)])));
+    }
+}
+
+// Noise estimates of midi_controller.cpp's HallConfig and CapPin
+template <typename T>
+struct HallNoise
+{
+    static constexpr T kInitialNoise = value<T>(0.0025f);
+    static constexpr T kMinNoise = value<T>(0.000625f);
+    static constexpr T kMaxNoise = value<T>(0.00625f);
+    static constexpr int kShift = 6;
+    static constexpr int kSlowShift = 10;
+};
+
+struct CapNoise
+{
+    static constexpr uint32_t kInitialNoise = 2500;
+    static constexpr uint32_t kMinNoise = 1000;
+    static constexpr uint32_t kMaxNoise = 7500;
+    static constexpr int kShift = 4;
+    static constexpr int kSlowShift = 8;
+};
+
+// The noise estimate of an idle Hall channel and the hysteresis taken from it
+template <typename T>
+void noise_floor_update(uint32_t iterations)
+{
+    noise_floor::NoiseFloor<T, HallNoise<T>> noise;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        noise.update(sensor_math::hall_deflection<T>(kAdc[input(i)]));
+        bench::keep(noise.margin(4));
+    }
+}
+
+// The end of CapPin::read_pin() with its noise estimate and the pressure of a held pad
+void cap_touch_threshold(uint32_t iterations)
+{
+    noise_floor::NoiseFloor<uint32_t, CapNoise> noise;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        uint32_t total = kCapTotals[input(i)];
+        if (!sensor_math::touch_detected(total, kCapBaseline, noise.margin(kTouchThresholdFactor)))
+        {
+            noise.update(total);
+        }
+        else
+        {
+            uint32_t magnitude = total > kCapBaseline ? total - kCapBaseline : 0;
+            bench::keep(sensor_math::touch_pressure(magnitude, kTouchPressureMin, kTouchPressureMax));
+        }
+    }
+}
+
+// What midi_scheduler::push() writes into its ring for a note
+void midi_channel_encode(uint32_t iterations)
+{
+    uint8_t packet[usb_midi_packet::kSize];
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        const uint32_t random = kRandom[input(i)];
+        const uint8_t msg[3] = {static_cast<uint8_t>(0x90 | (random & 0x0F)),
+                                static_cast<uint8_t>((random >> 8) & 0x7F),
+                                static_cast<uint8_t>((random >> 16) & 0x7F)};
+        usb_midi_packet::encode_channel(static_cast<uint8_t>(i & 0x3), msg, 3 - (random >> 31), packet);
+        bench::keep(packet);
+    }
+}
+
+// A timestamp echo of latency_probe.h: header and command, status, channel and note, the capture time in five bytes
+void midi_sysex_encode(uint32_t iterations)
+{
+    uint8_t msg[] = {0xF0, 0x7D, 0x4D, 0x0A, 0x01, 0x00, 0x3C, 0x00, 0x01, 0x02, 0x03, 0x04, 0xF7};
+    uint8_t packets[usb_midi_packet::sysex_packet_count(sizeof(msg))][usb_midi_packet::kSize];
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        msg[6] = static_cast<uint8_t>(kRandom[input(i)] & 0x7F);
+        size_t count = 0;
+        usb_midi_packet::encode_sysex(2, msg, sizeof(msg),
+                                      [&](const uint8_t* packet)
+                                      {
+                                          for (size_t b = 0; b < usb_midi_packet::kSize; ++b)
+                                          {
+                                              packets[count][b] = packet[b];
+                                          }
+                                          ++count;
+                                      });
+        bench::keep(packets);
+    }
+}
+
+// The animation part of a frame in the LED task: every pixel of a strip evaluated at the frame time
+void led_frame(uint32_t iterations)
+{
+    constexpr uint32_t kPeriodUs = 2000000;
+    Animation animations[8] = {
+        {AnimationType::Solid, 255, 0, 0x250000, 0, 0},        {AnimationType::Blink, 200, -1, 0x000080, 0, 500000},
+        {AnimationType::Pulse, 255, -1, 0x20FF00, 0, 800000},  {AnimationType::Fade, 180, 0, 0xFF0000, 0, kPeriodUs},
+        {AnimationType::Flash, 255, 0, 0x000080, 0, kPeriodUs}, {AnimationType::Pulse, 90, -1, 0x00FF00, 0, 300000},
+        {AnimationType::Fade, 255, 0, 0x00FF80, 0, kPeriodUs},  {AnimationType::Flash, 127, 0, 0x808080, 0, kPeriodUs},
+    };
+    uint32_t colors[8];
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        // Frames 1 ms apart, restarting before the finite animations run out
+        const uint32_t now_us = (i % (kPeriodUs / 1000)) * 1000;
+        for (size_t pixel = 0; pixel < std::size(animations); ++pixel)
+        {
+            bool done;
+            colors[pixel] = led_animation::evaluate(animations[pixel], now_us, &done);
+        }
+        bench::keep(colors);
+    }
+}
+
+// What a LOG_* call records on the caller's side
+void log_capture(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        logger::detail::ArgBuffer buffer;
+        buffer.put(static_cast<unsigned>(i & 0x3));
+        buffer.put(static_cast<unsigned long>(kRandom[input(i)]));
+        buffer.put(kRange[input(i)]);
+        buffer.put("touch");
+        bench::keep(buffer);
+    }
+}
+
+// What the log task does with a record before printing it
+void log_format(uint32_t iterations)
+{
+    const char* fmt = "%-12s cpu %3u.%u%%  stack free %4lu words  prio %u  core %d\n";
+    char message[MAX_LOG_MESSAGE_SIZE];
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        const uint32_t random = kRandom[input(i)];
+        logger::detail::ArgBuffer buffer;
+        buffer.put("UsbMidiTask");
+        buffer.put(random % 1000 / 10);
+        buffer.put(random % 10);
+        buffer.put(static_cast<unsigned long>(random >> 20));
+        buffer.put(2u);
+        buffer.put(0);
+        logger::detail::format(fmt, buffer, message, sizeof(message));
+        bench::keep(message);
+    }
+}
+
+constexpr bench::Benchmark kBenchmarks[] = {
+    {"BM_HallWeighting<float>", hall_weighting<float>},
+    {"BM_HallWeighting<Q15>", hall_weighting<fixed::Q15>},
+    {"BM_HallIir<float>", hall_iir<float>},
+    {"BM_HallIir<Q15>", hall_iir<fixed::Q15>},
+    {"BM_RangeNormalize<float>", range_normalize<float>},
+    {"BM_RangeNormalize<Q15>", range_normalize<fixed::Q15>},
+    {"BM_ResponseCurve<float>", response_curve_apply<float>},
+    {"BM_ResponseCurve<Q15>", response_curve_apply<fixed::Q15>},
+    {"BM_NoiseFloor<float>", noise_floor_update<float>},
+    {"BM_NoiseFloor<Q15>", noise_floor_update<fixed::Q15>},
+    {"BM_CapTouchThreshold", cap_touch_threshold},
+    {"BM_MidiChannelEncode", midi_channel_encode},
+    {"BM_MidiSysexEncode", midi_sysex_encode},
+    {"BM_LedFrame", led_frame},
+    {"BM_LogCapture", log_capture},
+    {"BM_LogFormat", log_format},
+};
+} // namespace
+
+namespace bench
+{
+const Benchmark* benchmarks(size_t* count)
+{
+    *count = std::size(kBenchmarks);
+    return kBenchmarks;
+}
+} // namespace bench
@@ -0,0 +1,87 @@
+// MembrainBench: the kernel microbenchmarks of bench_cases.cpp on the board, without FreeRTOS or any peripheral. Every
+// benchmark is timed with the DWT cycle counter of the Cortex-M33 and the report is printed over RTT, repeated so a
+// probe attached late still gets one. host/bench/membrain_bench runs the same benchmarks on the host.
+
+#include "hardware/clocks.h"
+#include "hardware/structs/m33.h"
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+namespace
+{
+// A benchmark runs for at least this long (0.1 s at 150 MHz), well within the 32-bit counter
+constexpr uint32_t kMinCycles = 15000000;
+constexpr uint32_t kReportPeriodMs = 10000;
+
+void enable_cycle_counter()
+{
+    m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+    m33_hw->dwt_cyccnt = 0;
+    m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+}
+
+// Doubles the iteration count until a run lasts kMinCycles. Returns the cycles of the last run.
+uint32_t measure(const bench::Benchmark& benchmark, uint32_t* iterations)
+{
+    uint32_t count = 16;
+    while (true)
+    {
+        const uint32_t start = m33_hw->dwt_cyccnt;
+        benchmark.run(count);
+        const uint32_t cycles = m33_hw->dwt_cyccnt - start;
+        if (cycles >= kMinCycles)
+        {
+            *iterations = count;
+            return cycles;
+        }
+        count *= 2;
+    }
+}
+
+void report(uint32_t run)
+{
+    const uint32_t clock_hz = clock_get_hz(clk_sys);
+    size_t count;
+    const bench::Benchmark* benchmarks = bench::benchmarks(&count);
+
+    size_t name_width = 10;
+    for (size_t i = 0; i < count; ++i)
+    {
+        name_width = strlen(benchmarks[i].name) > name_width ? strlen(benchmarks[i].name) : name_width;
+    }
+
+    char rule[96];
+    const size_t rule_width = name_width + 41 < sizeof(rule) ? name_width + 41 : sizeof(rule) - 1;
+    memset(rule, '-', rule_width);
+    rule[rule_width] = '\0';
+
+    printf("MembrainBench run %lu at %lu MHz, DWT cycles per iteration\n", static_cast<unsigned long>(run),
+           static_cast<unsigned long>(clock_hz / 1000000));
+    printf("%s\n%-*s %12s %13s %12s\n%s\n", rule, static_cast<int>(name_width), "Benchmark", "Cycles", "Time",
+           "Iterations", rule);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t iterations;
+        const uint32_t cycles = measure(benchmarks[i], &iterations);
+        const double per_iteration = static_cast<double>(cycles) / iterations;
+        printf("%-*s %12.1f %10.1f ns %12lu\n", static_cast<int>(name_width), benchmarks[i].name, per_iteration,
+               per_iteration * 1e9 / clock_hz, static_cast<unsigned long>(iterations));
+    }
+}
+} // namespace
+
+int main()
+{
+    stdio_init_all();
+    enable_cycle_counter();
+
+    for (uint32_t run = 1;; ++run)
+    {
+        report(run);
+        sleep_ms(kReportPeriodMs);
+    }
+}
@@ -1,23 +1,21 @@
 #include "cap_touch.h"
 
-#include "hardware/gpio.h"
-#include "pico/stdlib.h"
-#include "pico/sync.h"
-#include "pico/time.h"
-
+#include "hal.h"
 #include "logging.h"
+#include "sensor_math.h"
+#include "telemetry.h"
 
 namespace
 {
-critical_section_t cs;
+hal::CriticalSection cs;
 
-uint32_t kTouchThreshold = 50000;
+constexpr int32_t kTouchThresholdFactor = 20;
 constexpr uint32_t kCalibrateTime = 166;
 } // namespace
 
 void init_cap_touch()
 {
-    critical_section_init(&cs);
+    cs.init();
 }
 
 CapPin::CapPin()
@@ -30,43 +28,43 @@ void CapPin::init(uint32_t gpio, uint32_t samples)
 {
     gpio_ = gpio;
     samples_ = samples;
-    gpio_init(gpio_);
-    gpio_set_dir(gpio_, GPIO_IN);
-    gpio_set_pulls(gpio_, true, false);
+    hal::gpio_init(gpio_);
+    hal::gpio_set_output(gpio_, false);
+    hal::gpio_set_pulls(gpio_, true, false);
 }
 
 void CapPin::calibrate_pin()
 {
     uint16_t j, k = 0;
-    gpio_set_dir(gpio_, GPIO_OUT);
+    hal::gpio_set_output(gpio_, true);
 
     // the idea here is to calibrate for the same number of samples that are specified
     // but to make sure that the value is over a certain number of powerline cycles to
     // average out powerline errors
 
-    unsigned long start = to_ms_since_boot(get_absolute_time());
-    gpio_put(gpio_, 0); // set sensorPin output register LOW
+    unsigned long start = hal::time_ms();
+    hal::gpio_put(gpio_, 0); // set sensorPin output register LOW
 
-    while (to_ms_since_boot(get_absolute_time()) - start < kCalibrateTime)
+    while (hal::time_ms() - start < kCalibrateTime)
     { // sample at least 10 power line cycles
 
         for (unsigned int i = 0; i < samples_; i++)
         { // loop for samples parameter
 
-            gpio_set_dir(gpio_, GPIO_IN); // set sensorPin to INPUT
-            gpio_put(gpio_, 1);           // set sensorPin output register HIGH to set pullups
-            gpio_set_pulls(gpio_, true, false);
+            hal::gpio_set_output(gpio_, false); // set sensorPin to INPUT
+            hal::gpio_put(gpio_, 1);            // set sensorPin output register HIGH to set pullups
+            hal::gpio_set_pulls(gpio_, true, false);
 
             for (j = 0; j < 500; j++)
             {
-                if (gpio_get(gpio_))
+                if (hal::gpio_get(gpio_))
                     break;
             }
 
             total_ += j;
 
-            gpio_put(gpio_, 0);            // Pin output register LOW
-            gpio_set_dir(gpio_, GPIO_OUT); // OUTPUT & LOW now
+            hal::gpio_put(gpio_, 0);           // Pin output register LOW
+            hal::gpio_set_output(gpio_, true); // OUTPUT & LOW now
         }
         k++;
     }
@@ -81,23 +79,23 @@ void CapPin::calibrate_pin()
     {
         baseline_count_ = total_ / k;
         LOG_INFO("Calibrated baselineCount = ");
-        LOG_INFO("%lu\n", baseline_count_);
+        LOG_INFO("%lu\n", static_cast<unsigned long>(baseline_count_));
     }
 }
 
 bool CapPin::read_pin()
 {
-    critical_section_enter_blocking(&cs);
+    cs.enter();
 
-    gpio_set_dir(gpio_, GPIO_IN);
-    gpio_put(gpio_, 1);
+    hal::gpio_set_output(gpio_, false);
+    hal::gpio_put(gpio_, 1);
 
-    critical_section_exit(&cs);
+    cs.exit();
 
     uint16_t j;
     total_ = 0;
 
-    gpio_put(gpio_, 1);
+    hal::gpio_put(gpio_, 1);
 
     //	if (samples < 1) return 0;	  // defensive programming
 
@@ -114,23 +112,23 @@ bool CapPin::read_pin()
     for (unsigned int i = 0; i < samples_; i++)
     { // loop for samples parameter
 
-        critical_section_enter_blocking(&cs);
-        gpio_set_dir(gpio_, GPIO_IN); // set sensorPin to INPUT
-        gpio_put(gpio_, 1);           // set sensorPin output register HIGH to set pullups
-        critical_section_exit(&cs);
+        cs.enter();
+        hal::gpio_set_output(gpio_, false); // set sensorPin to INPUT
+        hal::gpio_put(gpio_, 1);            // set sensorPin output register HIGH to set pullups
+        cs.exit();
 
         for (j = 0; j < 5000; j++)
         {
-            if (gpio_get(gpio_))
+            if (hal::gpio_get(gpio_))
                 break;
         }
 
         total_ += j;
 
-        critical_section_enter_blocking(&cs);
-        gpio_put(gpio_, 0); // Pin output register LOW
-        gpio_set_dir(gpio_, GPIO_OUT);
-        critical_section_exit(&cs);
+        cs.enter();
+        hal::gpio_put(gpio_, 0); // Pin output register LOW
+        hal::gpio_set_output(gpio_, true);
+        cs.exit();
     }
 
     // if pin is grounded (or connected to ground with resistance
@@ -138,13 +136,18 @@ bool CapPin::read_pin()
     // the method will return in about one second.
     if (total_ >= ((unsigned long)samples_ * 450UL))
     {
-        LOG_ERROR("readPin method over timeout, check wiring.\n");
+        telemetry::increment(telemetry::Counter::CapTouchTimeout);
         state_ = false;
     }
 
     // Serial.println(total);
 
-    return ((total_ - baseline_count_) > kTouchThreshold);
+    bool touched = sensor_math::touch_detected(total_, baseline_count_, noise_.margin(kTouchThresholdFactor));
+    if (!touched)
+    {
+        noise_.update(total_);
+    }
+    return touched;
 }
 
 bool CapPin::triggered()
@@ -154,7 +157,7 @@ bool CapPin::triggered()
 
     if (state_ && !prev_state_)
     {
-        LOG_INFO("total_ = %lu\n", total_);
+        LOG_INFO("total_ = %lu\n", static_cast<unsigned long>(total_));
     }
 
     return state_ && !prev_state_;
@@ -163,4 +166,14 @@ bool CapPin::triggered()
 bool CapPin::get_state()
 {
     return state_;
+}
+
+uint32_t CapPin::get_magnitude() const
+{
+    return total_ > baseline_count_ ? total_ - baseline_count_ : 0;
+}
+
+uint32_t CapPin::get_total() const
+{
+    return total_;
 }
\ No newline at end of file
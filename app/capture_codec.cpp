@@ -0,0 +1,288 @@
+#include "capture_codec.h"
+
+namespace
+{
+constexpr uint8_t kValueCounts[capture_codec::NumStreams] = {3, 1, 1, 1, 1, 1, 1, 1, 2};
+
+size_t write_varint(uint32_t value, uint8_t* out)
+{
+    size_t size = 0;
+    while (value >= 0x80)
+    {
+        out[size++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = static_cast<uint8_t>(value);
+    return size;
+}
+
+// Returns the number of bytes read, 0 if more data is needed and -1 if the varint is too long
+int read_varint(const uint8_t* data, size_t size, uint32_t* value)
+{
+    uint32_t result = 0;
+    for (size_t i = 0; i < capture_codec::kMaxVarintSize; ++i)
+    {
+        if (i >= size)
+        {
+            return 0;
+        }
+
+        result |= static_cast<uint32_t>(data[i] & 0x7F) << (7 * i);
+        if ((data[i] & 0x80) == 0)
+        {
+            *value = result;
+            return static_cast<int>(i + 1);
+        }
+    }
+    return -1;
+}
+
+constexpr uint32_t zigzag_encode(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+constexpr int32_t zigzag_decode(uint32_t value)
+{
+    return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+} // namespace
+
+namespace capture_codec
+{
+uint8_t value_count(uint8_t stream)
+{
+    return stream < NumStreams ? kValueCounts[stream] : 0;
+}
+
+size_t write_header(uint8_t* out)
+{
+    for (size_t i = 0; i < sizeof(kMagic); ++i)
+    {
+        out[i] = kMagic[i];
+    }
+    out[4] = kVersion;
+    return kHeaderSize;
+}
+
+bool check_header(const uint8_t* data, size_t size)
+{
+    if (size < kHeaderSize)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(kMagic); ++i)
+    {
+        if (data[i] != kMagic[i])
+        {
+            return false;
+        }
+    }
+    return data[4] == kVersion;
+}
+
+Encoder::Encoder()
+{
+    reset();
+}
+
+void Encoder::reset()
+{
+    has_timestamp_ = false;
+    last_timestamp_ = 0;
+    last_step_ = 0;
+    for (size_t i = 0; i < NumStreams; ++i)
+    {
+        since_keyframe_[i] = kKeyframeInterval;
+        for (auto& value : last_values_[i])
+        {
+            value = 0;
+        }
+    }
+}
+
+size_t Encoder::encode(uint8_t stream, uint32_t timestamp_us, const int32_t* values, uint8_t* out)
+{
+    const uint8_t count = value_count(stream);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int32_t* last = last_values_[stream];
+    const int32_t step_change = static_cast<int32_t>((timestamp_us - last_timestamp_) - last_step_);
+    const bool keyframe = !has_timestamp_ || since_keyframe_[stream] >= kKeyframeInterval ||
+                          step_change > kMaxStepChangeUs || step_change < -kMaxStepChangeUs;
+    size_t size = 0;
+
+    if (keyframe)
+    {
+        out[size++] = kKeyframeFlag | stream;
+        size += write_varint(timestamp_us, out + size);
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            size += write_varint(static_cast<uint32_t>(values[i]), out + size);
+            last[i] = values[i];
+        }
+        since_keyframe_[stream] = 0;
+        last_step_ = 0;
+    }
+    else
+    {
+        int32_t deltas[kMaxValues];
+        bool packable = count > 1;
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            deltas[i] = values[i] - last[i];
+            packable = packable && deltas[i] >= -8 && deltas[i] <= 7;
+            last[i] = values[i];
+        }
+
+        out[size++] = (packable ? kPackedFlag : 0) | stream;
+        size += write_varint(zigzag_encode(step_change), out + size);
+        last_step_ = timestamp_us - last_timestamp_;
+
+        if (packable)
+        {
+            for (uint8_t i = 0; i < count; i += 2)
+            {
+                uint8_t high = i + 1 < count ? static_cast<uint8_t>(deltas[i + 1] & 0x0F) : 0;
+                out[size++] = static_cast<uint8_t>((deltas[i] & 0x0F) | (high << 4));
+            }
+        }
+        else
+        {
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                size += write_varint(zigzag_encode(deltas[i]), out + size);
+            }
+        }
+        ++since_keyframe_[stream];
+    }
+
+    has_timestamp_ = true;
+    last_timestamp_ = timestamp_us;
+    return size;
+}
+
+Decoder::Decoder()
+{
+    reset();
+}
+
+void Decoder::reset()
+{
+    has_clock_ = false;
+    timestamp_ = 0;
+    resync();
+}
+
+void Decoder::resync()
+{
+    has_timestamp_ = false;
+    last_step_ = 0;
+    for (size_t i = 0; i < NumStreams; ++i)
+    {
+        has_keyframe_[i] = false;
+        for (auto& value : last_values_[i])
+        {
+            value = 0;
+        }
+    }
+}
+
+int Decoder::decode(const uint8_t* data, size_t size, Record* record)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    const uint8_t stream = data[0] & kStreamMask;
+    const bool keyframe = (data[0] & kKeyframeFlag) != 0;
+    const bool packed = (data[0] & kPackedFlag) != 0;
+    const uint8_t count = value_count(stream);
+    if (count == 0 || (keyframe && packed))
+    {
+        return -1;
+    }
+
+    // Parse everything first so that an incomplete record leaves the decoder state untouched
+    uint32_t fields[1 + kMaxValues];
+    const uint8_t varints = packed ? 1 : 1 + count;
+    size_t offset = 1;
+    for (uint8_t i = 0; i < varints; ++i)
+    {
+        int read = read_varint(data + offset, size - offset, &fields[i]);
+        if (read <= 0)
+        {
+            return read;
+        }
+        offset += read;
+    }
+
+    if (packed)
+    {
+        const size_t packed_size = (count + 1) / 2;
+        if (size - offset < packed_size)
+        {
+            return 0;
+        }
+
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            // Sign-extend the nibble and store it zigzag encoded like an unpacked delta
+            int32_t nibble = (data[offset + i / 2] >> (4 * (i & 1))) & 0x0F;
+            fields[1 + i] = zigzag_encode(nibble >= 8 ? nibble - 16 : nibble);
+        }
+        offset += packed_size;
+    }
+
+    const int32_t step_change = keyframe ? 0 : zigzag_decode(fields[0]);
+    const int64_t step = static_cast<int64_t>(last_step_) + step_change;
+    if (step_change > kMaxStepChangeUs || step_change < -kMaxStepChangeUs || step < 0)
+    {
+        // Sampling never jumps by this much between two records and time never goes back, the data is corrupted
+        return -1;
+    }
+
+    const bool valid = keyframe || (has_keyframe_[stream] && has_timestamp_);
+
+    if (keyframe)
+    {
+        // The device clock is 32-bit, extend it using the previous timestamp so captures can run past a wrap
+        const uint32_t absolute = fields[0];
+        const int32_t clock_offset = static_cast<int32_t>(absolute - static_cast<uint32_t>(timestamp_));
+        timestamp_ = has_clock_ ? timestamp_ + clock_offset : absolute;
+        has_clock_ = true;
+        has_timestamp_ = true;
+        last_step_ = 0;
+    }
+    else
+    {
+        last_step_ = static_cast<uint32_t>(step);
+        timestamp_ += last_step_;
+    }
+
+    record->stream = stream;
+    record->keyframe = keyframe;
+    record->count = count;
+    record->timestamp_us = timestamp_;
+    record->valid = valid;
+
+    int32_t* last = last_values_[stream];
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        last[i] = keyframe ? static_cast<int32_t>(fields[1 + i]) : last[i] + zigzag_decode(fields[1 + i]);
+        record->values[i] = last[i];
+    }
+
+    if (keyframe)
+    {
+        has_keyframe_[stream] = true;
+    }
+
+    return static_cast<int>(offset);
+}
+} // namespace capture_codec
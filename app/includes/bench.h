@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Microbenchmarks of the per-sample kernels (bench_cases.cpp), shared by the host runner host/bench/membrain_bench and
+// the MembrainBench firmware image. A benchmark runs its kernel the given number of times over inputs that change on
+// every iteration, the runner picks the count and divides the measured time or cycles by it.
+namespace bench
+{
+using Function = void (*)(uint32_t iterations);
+
+struct Benchmark
+{
+    const char* name;
+    Function run;
+};
+
+// Every benchmark, in report order
+const Benchmark* benchmarks(size_t* count);
+
+// Makes the compiler produce value, as if it was read from memory by something it cannot see
+template <typename T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+} // namespace bench
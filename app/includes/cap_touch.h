@@ -2,6 +2,12 @@
 
 #include <cstdint>
 
+#include "noise_floor.h"
+
+// The touch pads are wired to consecutive pins
+constexpr uint32_t kCapTouchFirstGpio = 16;
+constexpr uint32_t kCapTouchGpioCount = 4;
+
 void init_cap_touch();
 void calibrate_pin(unsigned int samples);
 int read_touch(unsigned int samples);
@@ -18,9 +24,27 @@ class CapPin
     bool triggered();
     bool get_state();
 
+    // Charge count of the last read, summed over all samples
+    uint32_t get_total() const;
+
+    // Raw count above the calibrated baseline from the last read, 0 when below baseline.
+    uint32_t get_magnitude() const;
+
     void calibrate_pin();
 
   private:
+    // Charge count noise of the untouched pad, the touch threshold is kTouchThresholdFactor times it. The initial
+    // noise gives the former fixed threshold of 50000; a noisy pad raises it, and with kMappingFlagSensitive a quiet
+    // one lowers it to 20000.
+    struct Noise
+    {
+        static constexpr uint32_t kInitialNoise = 2500;
+        static constexpr uint32_t kMinNoise = 1000;
+        static constexpr uint32_t kMaxNoise = 7500;
+        static constexpr int kShift = 4;
+        static constexpr int kSlowShift = 8;
+    };
+
     uint32_t gpio_;
     uint32_t samples_;
     uint32_t total_;
@@ -30,4 +54,5 @@ class CapPin
     bool calibrate_flag_;
     bool prev_state_;
     bool state_;
+    noise_floor::NoiseFloor<uint32_t, Noise> noise_;
 };
\ No newline at end of file
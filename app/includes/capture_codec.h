@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compact capture format for recorded sensor sessions. Shared with the host decoder, so this must not depend on the
+// pico SDK.
+//
+// A capture starts with a 5-byte header ("MBRC" + version) followed by records. Each record starts with a tag byte:
+// bit 7 set for a keyframe, bit 6 set for a packed delta, bits 0-5 the stream ID.
+//   keyframe: tag, varint absolute timestamp (us, 32-bit device clock), varint value for each channel
+//   delta:    tag, zigzag varint of the change in time step, zigzag varint delta for each channel
+//   packed:   same as delta, but every channel delta fits in 4 bits and they are packed two per byte, low nibble first
+// The time step is the time since the previous record of any stream. Sensors are polled at a steady rate so its change
+// is usually a single byte. A keyframe resets the time step to 0.
+// Every stream sends a keyframe first and then every kKeyframeInterval records, which bounds how far a corrupted or
+// missing record can propagate.
+namespace capture_codec
+{
+constexpr uint8_t kMagic[4] = {'M', 'B', 'R', 'C'};
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 5;
+
+constexpr uint8_t kKeyframeFlag = 0x80;
+constexpr uint8_t kPackedFlag = 0x40;
+constexpr uint8_t kStreamMask = 0x3F;
+constexpr uint32_t kKeyframeInterval = 256;
+
+// Larger changes of the time step are rejected by the decoder as corruption
+constexpr int32_t kMaxStepChangeUs = 1000000;
+
+constexpr size_t kMaxValues = 3;
+constexpr size_t kMaxVarintSize = 5;
+constexpr size_t kMaxRecordSize = 1 + kMaxVarintSize * (1 + kMaxValues);
+
+enum StreamId : uint8_t
+{
+    Hall = 0,      // 3 channels: raw ADC of each Hall sensor
+    CapTouch0 = 1, // 1 channel: charge count, one stream per pad (CapTouch0 + pad)
+    Range = 8,     // 2 channels: range in mm, VL6180X status
+    NumStreams = 9
+};
+
+constexpr size_t kNumCapTouchStreams = Range - CapTouch0;
+
+// Number of channels of a stream, 0 for unknown streams
+uint8_t value_count(uint8_t stream);
+
+// Writes the capture header, out must hold kHeaderSize bytes
+size_t write_header(uint8_t* out);
+bool check_header(const uint8_t* data, size_t size);
+
+class Encoder
+{
+  public:
+    Encoder();
+
+    // Forces a keyframe on every stream and restarts the timestamp chain
+    void reset();
+
+    // Encodes one sample into out, which must hold kMaxRecordSize bytes. Returns the record size, 0 for an unknown
+    // stream. Runs in bounded time: at most one varint per channel plus the timestamp.
+    size_t encode(uint8_t stream, uint32_t timestamp_us, const int32_t* values, uint8_t* out);
+
+  private:
+    bool has_timestamp_;
+    uint32_t last_timestamp_;
+    uint32_t last_step_;
+    int32_t last_values_[NumStreams][kMaxValues];
+    uint32_t since_keyframe_[NumStreams];
+};
+
+struct Record
+{
+    uint8_t stream;
+    bool keyframe;
+    bool valid; // false for a delta record of a stream that has not seen a keyframe yet
+    uint8_t count;
+    uint64_t timestamp_us;
+    int32_t values[kMaxValues];
+};
+
+class Decoder
+{
+  public:
+    Decoder();
+
+    void reset();
+
+    // Called after skipping corrupted data: every stream waits for its next keyframe. The timestamp is kept so that
+    // the 32-bit device clock can still be extended.
+    void resync();
+
+    // Decodes the record at the start of data. Returns the number of bytes consumed, 0 if data holds an incomplete
+    // record and -1 if the data is malformed.
+    int decode(const uint8_t* data, size_t size, Record* record);
+
+  private:
+    bool has_clock_;     // timestamp_ holds a device time that later keyframes can be extended from
+    bool has_timestamp_; // the time step chain is in sync
+    uint64_t timestamp_;
+    uint32_t last_step_;
+    bool has_keyframe_[NumStreams];
+    int32_t last_values_[NumStreams][kMaxValues];
+};
+} // namespace capture_codec
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+
+// Q15 and Q31 fractions for the fixed-point sensor path (sensor_math.h with MEMBRAIN_FIXED_POINT). Conversions and
+// arithmetic saturate instead of wrapping, so an overflow clips the value the way the float path's clamps do.
+namespace fixed
+{
+// -1 to 1 - 2^-15
+struct Q15
+{
+    int16_t raw;
+};
+
+// -1 to 1 - 2^-31
+struct Q31
+{
+    int32_t raw;
+};
+
+constexpr int16_t saturate16(int32_t x)
+{
+    return static_cast<int16_t>(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+}
+
+constexpr int32_t saturate32(int64_t x)
+{
+    return static_cast<int32_t>(x > INT32_MAX ? INT32_MAX : (x < INT32_MIN ? INT32_MIN : x));
+}
+
+// Rounded to nearest, for constants
+constexpr Q15 q15(float x)
+{
+    float scaled = x * 32768.f;
+    return {saturate16(static_cast<int32_t>(scaled < 0.f ? scaled - 0.5f : scaled + 0.5f))};
+}
+
+constexpr float to_float(Q15 x)
+{
+    return x.raw * (1.f / 32768.f);
+}
+
+constexpr Q31 widen(Q15 x)
+{
+    return {static_cast<int32_t>(x.raw) * 65536};
+}
+
+// Rounded to nearest
+constexpr Q15 narrow(Q31 x)
+{
+    return {saturate16(static_cast<int32_t>((static_cast<int64_t>(x.raw) + 32768) >> 16))};
+}
+
+constexpr Q15 add(Q15 a, Q15 b)
+{
+    return {saturate16(a.raw + b.raw)};
+}
+
+constexpr Q15 sub(Q15 a, Q15 b)
+{
+    return {saturate16(a.raw - b.raw)};
+}
+
+// Rounded to nearest. -1 * -1 saturates to the largest Q15.
+constexpr Q15 mul(Q15 a, Q15 b)
+{
+    return {saturate16((a.raw * b.raw + (1 << 14)) >> 15)};
+}
+
+constexpr Q15 abs(Q15 x)
+{
+    return {saturate16(x.raw < 0 ? -x.raw : x.raw)};
+}
+
+constexpr bool operator==(Q15 a, Q15 b)
+{
+    return a.raw == b.raw;
+}
+
+constexpr bool operator!=(Q15 a, Q15 b)
+{
+    return a.raw != b.raw;
+}
+
+constexpr bool operator<(Q15 a, Q15 b)
+{
+    return a.raw < b.raw;
+}
+
+constexpr bool operator<=(Q15 a, Q15 b)
+{
+    return a.raw <= b.raw;
+}
+
+constexpr bool operator>(Q15 a, Q15 b)
+{
+    return a.raw > b.raw;
+}
+} // namespace fixed
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Thin hardware abstraction for the sensor-to-MIDI path. midi_controller and the modules it calls reach the hardware
+// only through these functions, so the same sources build for the board and for the Linux simulation (host/sim).
+// hal_pico.h maps them onto the pico SDK and TinyUSB as inline wrappers that compile to the same code as calling the
+// SDK directly. The Linux backend (host/sim/hal_linux.h) drives them from simulated sensors.
+//
+// Every backend provides, in namespace hal:
+//
+//   Time, since boot
+//     uint32_t time_us();                  Wraps after about 71 minutes, compare with unsigned differences
+//     uint64_t time_us_64();
+//     uint32_t time_ms();
+//     void sleep_ms(uint32_t ms);
+//
+//   GPIO
+//     void gpio_init(uint32_t pin);        Input, no pulls, output register low
+//     void gpio_set_output(uint32_t pin, bool output);
+//     void gpio_set_pulls(uint32_t pin, bool up, bool down);
+//     void gpio_put(uint32_t pin, bool value);
+//     bool gpio_get(uint32_t pin);
+//
+//   ADC
+//     void adc_init();
+//     void adc_gpio_init(uint32_t pin);    Pins kAdcFirstPin onwards are channels 0 onwards
+//     uint16_t adc_read(uint32_t channel); 12-bit conversion of one channel
+//
+//   I2C on the default bus, returning the number of bytes transferred or a negative error
+//     void i2c_init(uint32_t baudrate);    Also sets up the SDA and SCL pins with pull-ups
+//     int i2c_write(uint8_t address, const uint8_t* data, size_t size, bool nostop);
+//     int i2c_read(uint8_t address, uint8_t* data, size_t size, bool nostop);
+//
+//   USB-MIDI, interface 0. Received data is the bytes of every cable in arrival order, the cable number is dropped
+//   (tud_midi_n_stream_read ignores its cable argument). The host sends SysEx on cable 0.
+//     bool usb_midi_mounted();
+//     void usb_enable_sof(bool enabled);   Calls tud_sof_cb() at every start of frame
+//     bool usb_midi_write_packet(const uint8_t packet[4]);
+//     uint32_t usb_midi_available();
+//     uint32_t usb_midi_read(uint8_t* buffer, uint32_t size);
+//
+//   USB vendor bulk interface (sensor_stream)
+//     bool usb_vendor_mounted();
+//     uint32_t usb_vendor_available();
+//     uint32_t usb_vendor_read(void* buffer, uint32_t size);
+//     uint32_t usb_vendor_write_available();
+//     uint32_t usb_vendor_write(const void* data, uint32_t size);
+//     void usb_vendor_flush();
+//
+//   class CriticalSection                  Excludes the other core and interrupts, init() before use
+//     void init(); void enter(); void exit();
+//
+// The LED strips are not covered: they are fed by DMA into PIO and completed from interrupts, so the whole leds.h
+// module is the seam. The simulation links its own implementation of leds.h.
+namespace hal
+{
+constexpr uint32_t kAdcFirstPin = 26;
+} // namespace hal
+
+#if MEMBRAIN_HOST
+#include "hal_linux.h"
+#else
+#include "hal_pico.h"
+#endif
@@ -0,0 +1,175 @@
+#pragma once
+
+// pico SDK and TinyUSB backend of hal.h. Include hal.h instead of this file.
+
+#include "hardware/adc.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "pico/binary_info.h"
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "pico/time.h"
+
+#include "tusb.h"
+
+namespace hal
+{
+inline uint32_t time_us()
+{
+    return time_us_32();
+}
+
+inline uint64_t time_us_64()
+{
+    return ::time_us_64();
+}
+
+inline uint32_t time_ms()
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+inline void sleep_ms(uint32_t ms)
+{
+    ::sleep_ms(ms);
+}
+
+inline void gpio_init(uint32_t pin)
+{
+    ::gpio_init(pin);
+}
+
+inline void gpio_set_output(uint32_t pin, bool output)
+{
+    gpio_set_dir(pin, output ? GPIO_OUT : GPIO_IN);
+}
+
+inline void gpio_set_pulls(uint32_t pin, bool up, bool down)
+{
+    ::gpio_set_pulls(pin, up, down);
+}
+
+inline void gpio_put(uint32_t pin, bool value)
+{
+    ::gpio_put(pin, value);
+}
+
+inline bool gpio_get(uint32_t pin)
+{
+    return ::gpio_get(pin);
+}
+
+inline void adc_init()
+{
+    ::adc_init();
+}
+
+inline void adc_gpio_init(uint32_t pin)
+{
+    ::adc_gpio_init(pin);
+}
+
+inline uint16_t adc_read(uint32_t channel)
+{
+    adc_select_input(channel);
+    return ::adc_read();
+}
+
+inline void i2c_init(uint32_t baudrate)
+{
+    ::i2c_init(i2c_default, baudrate);
+    gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
+    gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
+    // Make the I2C pins available to picotool
+    bi_decl(bi_2pins_with_func(PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C));
+}
+
+inline int i2c_write(uint8_t address, const uint8_t* data, size_t size, bool nostop)
+{
+    return i2c_write_blocking(i2c_default, address, data, size, nostop);
+}
+
+inline int i2c_read(uint8_t address, uint8_t* data, size_t size, bool nostop)
+{
+    return i2c_read_blocking(i2c_default, address, data, size, nostop);
+}
+
+inline bool usb_midi_mounted()
+{
+    return tud_midi_mounted();
+}
+
+inline void usb_enable_sof(bool enabled)
+{
+    tud_sof_cb_enable(enabled);
+}
+
+inline bool usb_midi_write_packet(const uint8_t packet[4])
+{
+    return tud_midi_n_packet_write(0, packet);
+}
+
+inline uint32_t usb_midi_available()
+{
+    return tud_midi_n_available(0, 0);
+}
+
+inline uint32_t usb_midi_read(uint8_t* buffer, uint32_t size)
+{
+    return tud_midi_n_stream_read(0, 0, buffer, size);
+}
+
+inline bool usb_vendor_mounted()
+{
+    return tud_vendor_mounted();
+}
+
+inline uint32_t usb_vendor_available()
+{
+    return tud_vendor_available();
+}
+
+inline uint32_t usb_vendor_read(void* buffer, uint32_t size)
+{
+    return tud_vendor_read(buffer, size);
+}
+
+inline uint32_t usb_vendor_write_available()
+{
+    return tud_vendor_write_available();
+}
+
+inline uint32_t usb_vendor_write(const void* data, uint32_t size)
+{
+    return tud_vendor_write(data, size);
+}
+
+inline void usb_vendor_flush()
+{
+    tud_vendor_write_flush();
+}
+
+class CriticalSection
+{
+  public:
+    void init()
+    {
+        critical_section_init(&cs_);
+    }
+
+    void enter()
+    {
+        critical_section_enter_blocking(&cs_);
+    }
+
+    void exit()
+    {
+        critical_section_exit(&cs_);
+    }
+
+  private:
+    critical_section_t cs_;
+};
+} // namespace hal
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// End-to-end latency measurement support (host side: host/latency).
+//
+// sysex::LatencyMode (payload: 0 = off, 1 = on) enables timestamp echoes. While enabled, every note on and note off is
+// followed on its own cable by a sysex::TimestampEcho message carrying the note and its capture time, released in the
+// same USB frame as the note:
+//   payload: <status high nibble & 7> <channel> <note> <capture time u32>
+//
+// sysex::Ping is answered at any time with the device clock so the host can estimate the clock offset:
+//   request: <token u32>
+//   reply:   <token u32> <device time u32> <release latency u32>
+// The release latency is the lowest capture-to-release time the MIDI scheduler measured, which the reply is held for at
+// least before it is sent.
+namespace latency_probe
+{
+constexpr size_t kEchoPayloadSize = 3 + 5; // status, channel, note, capture time
+constexpr size_t kPingRequestSize = 5;     // token
+constexpr size_t kPingReplySize = 3 * 5;   // token, device time, release latency
+
+void init();
+
+bool enabled();
+
+// Queues the echo of a channel voice message right behind it. Only notes are echoed. MIDI task only.
+void echo(uint32_t capture_time_us, uint8_t cable, const uint8_t* msg, size_t size);
+} // namespace latency_probe
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Time-based LED animations. An animation is described by its start time and durations in microseconds, so what it
+// shows only depends on the current time and not on how often or how late the LED task runs.
+enum class AnimationType : uint8_t
+{
+    Solid = 0,
+    Blink,
+    Fade,
+    Pulse,
+    Flash
+};
+
+struct Animation
+{
+    AnimationType type;
+    uint8_t level;      // Peak level before gamma correction, 0-255
+    int16_t repeat;     // Number of Blink/Pulse cycles, negative repeats forever
+    uint32_t color;     // GRB
+    uint32_t start_us;
+    uint32_t period_us; // Blink/Pulse cycle length, Fade/Flash duration
+};
+
+namespace led_animation
+{
+
+constexpr uint8_t kMaxLevel = 255;
+
+namespace detail
+{
+
+constexpr double sqrt(double x)
+{
+    if (x <= 0.0)
+    {
+        return 0.0;
+    }
+
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 32; ++i)
+    {
+        r = 0.5 * (r + x / r);
+    }
+    return r;
+}
+
+// Gamma 2.5 (x^2 * sqrt(x)) is close to the WS2812 response and cheap to evaluate at compile time
+constexpr std::array<uint8_t, 256> make_gamma_table()
+{
+    std::array<uint8_t, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        double x = static_cast<double>(i) / 255.0;
+        table[i] = static_cast<uint8_t>(x * x * sqrt(x) * 255.0 + 0.5);
+    }
+    return table;
+}
+
+// Soft hits still need to be visible: velocity 1 maps to a quarter of the full level, 127 to the full level
+constexpr std::array<uint8_t, 128> make_velocity_table()
+{
+    std::array<uint8_t, 128> table{};
+    for (size_t i = 1; i < table.size(); ++i)
+    {
+        table[i] = static_cast<uint8_t>(64 + (i * (kMaxLevel - 64) + 63) / 127);
+    }
+    return table;
+}
+
+} // namespace detail
+
+// Perceptual level (0-255) to PWM duty (0-255)
+constexpr std::array<uint8_t, 256> kGammaTable = detail::make_gamma_table();
+
+// MIDI velocity to perceptual level
+constexpr std::array<uint8_t, 128> kVelocityLevel = detail::make_velocity_table();
+
+static_assert(kGammaTable[0] == 0 && kGammaTable[255] == 255, "Gamma table must preserve the endpoints");
+static_assert(kVelocityLevel[0] == 0 && kVelocityLevel[127] == kMaxLevel, "Velocity table must span the full level");
+
+// Scales every channel of a GRB color by the gamma corrected level. kMaxLevel leaves the color untouched.
+uint32_t scale_color(uint32_t grb, uint8_t level);
+
+// Returns the color the animation shows at now_us. done is set once a finite animation has run to completion.
+// Animations repeating forever are rebased to their current cycle so they survive the 32-bit timer wrap.
+uint32_t evaluate(Animation& animation, uint32_t now_us, bool* done);
+
+} // namespace led_animation
@@ -6,6 +6,7 @@
 // Colors are defined as GRB
 #define DIM_GREEN (0x250000)
 #define DIM_BLUE  (0x000025)
+#define BLUE      (0x000080)
 
 enum Pixels : uint32_t
 {
@@ -22,6 +23,19 @@ enum Pixels : uint32_t
 uint32_t urgb_to_u32(uint8_t r, uint8_t g, uint8_t b);
 
 void start_led_task();
+
+// Lock-free and callable from any task or core: the command is queued and applied by the LED task on its next frame.
+// set_led sets the pixel's base color and cancels any animation running on it. The animations below play on top of
+// the base color and return to it once done. Timing is in milliseconds from the call, a negative repeat loops forever.
 void set_led(Pixels pixel, uint32_t color);
-void set_led_blinking(Pixels pixel, uint32_t color, uint32_t period, int repeat);
+void fade_led(Pixels pixel, uint32_t color, uint32_t duration_ms);
+void pulse_led(Pixels pixel, uint32_t color, uint32_t period_ms, int repeat);
+// Brightness scales with the MIDI velocity (0-127)
+void flash_led(Pixels pixel, uint32_t color, uint8_t velocity, uint32_t duration_ms);
+
+// Pixels beyond the status pixels, on the additional strips when several strips are driven in parallel
+Pixels strip_pixel(uint32_t strip, uint32_t index);
+
+// Commands lost because the command ring was full
+uint32_t led_dropped_commands();
 void led_task(void* params);
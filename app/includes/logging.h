@@ -1,10 +1,17 @@
 #pragma once
 
-#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
 
 constexpr size_t MAX_LOG_MESSAGE_SIZE = 256;
 
-enum class LogLevel
+// Raw bytes of the arguments of one log call, eight words of the target. Arguments past this size are printed as '?'.
+constexpr size_t MAX_LOG_ARGS_SIZE = 8 * sizeof(void*);
+
+enum class LogLevel : uint8_t
 {
     Debug,
     Info,
@@ -12,6 +19,9 @@ enum class LogLevel
     Error
 };
 
+// Logging is deferred: the caller only records the timestamp, the format string pointer and the raw arguments into a
+// lock-free ring of its core, and a low priority task formats and prints the records later. The format string and any
+// %s argument must therefore outlive the call, which string literals do.
 #define LOG_DEBUG(fmt, ...)   logger::log(LogLevel::Debug, __FILE_NAME__, fmt, ##__VA_ARGS__)
 #define LOG_INFO(fmt, ...)    logger::log(LogLevel::Info, __FILE_NAME__, fmt, ##__VA_ARGS__)
 #define LOG_WARNING(fmt, ...) logger::log(LogLevel::Warning, __FILE_NAME__, fmt, ##__VA_ARGS__)
@@ -19,6 +29,71 @@ enum class LogLevel
 
 namespace logger
 {
+namespace detail
+{
+// Arguments are stored with the size printf reads them with after default promotion: integers up to int as int, wider
+// integers as themselves, floating point as double and pointers as pointers.
+struct ArgBuffer
+{
+    uint8_t data[MAX_LOG_ARGS_SIZE];
+    uint8_t size = 0;
+    bool truncated = false;
+
+    template <typename T>
+    void put(T value)
+    {
+        if constexpr (std::is_floating_point<T>::value)
+        {
+            write(static_cast<double>(value));
+        }
+        else if constexpr (std::is_pointer<T>::value || std::is_null_pointer<T>::value)
+        {
+            write(static_cast<const void*>(value));
+        }
+        else if constexpr (std::is_enum<T>::value)
+        {
+            put(static_cast<typename std::underlying_type<T>::type>(value));
+        }
+        else if constexpr (sizeof(T) <= sizeof(int))
+        {
+            write(static_cast<int>(value));
+        }
+        else
+        {
+            write(value);
+        }
+    }
+
+    template <typename T>
+    void write(T value)
+    {
+        if (truncated || size + sizeof(T) > sizeof(data))
+        {
+            truncated = true;
+            return;
+        }
+        memcpy(data + size, &value, sizeof(T));
+        size += sizeof(T);
+    }
+};
+
+void push(LogLevel level, const char* filename, const char* fmt, const ArgBuffer& args);
+
+// Writes the message of a record into out, always terminated. Runs in the log task (log_format.cpp).
+void format(const char* fmt, const ArgBuffer& args, char* out, size_t size);
+} // namespace detail
+
+// Starts the formatter task. Records logged before the scheduler starts are printed once it runs.
 void init_logging();
-void log(LogLevel level, const char* filename, const char* fmt, ...);
-}
\ No newline at end of file
+
+template <typename... Args>
+void log(LogLevel level, const char* filename, const char* fmt, Args... args)
+{
+    detail::ArgBuffer buffer;
+    (buffer.put(args), ...);
+    detail::push(level, filename, fmt, buffer);
+}
+
+// Records lost because a ring was full
+uint32_t dropped_records();
+} // namespace logger
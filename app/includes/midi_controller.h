@@ -3,4 +3,10 @@
 #define USB_MIDI_TASK_PRIORITY   (tskIDLE_PRIORITY + 2UL)
 #define USB_MIDI_TASK_STACK_SIZE 1024
 
-void start_midi_task();
\ No newline at end of file
+// Sets up the sensors and the mapping, then starts the control loop in its own task
+void start_midi_task();
+
+// For hosts that run the control loop from their own task, like the replay harness in host/sim: init_midi_controller()
+// is start_midi_task() without the task and run_midi_cycle() one pass of the task's loop.
+void init_midi_controller();
+void run_midi_cycle();
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "response_curve.h"
+
+// Every sensor that can produce MIDI has a fixed source ID used to index the mapping table.
+enum class SourceId : uint8_t
+{
+    Touch0 = 0,
+    Touch1,
+    Touch2,
+    Touch3,
+    Piezo,
+    Hall,
+    Range,
+    Slider,      // Finger position along the four pads
+    SliderSpeed, // How fast it moves
+    Count
+};
+
+constexpr size_t kNumSources = static_cast<size_t>(SourceId::Count);
+
+enum class MappingType : uint8_t
+{
+    None = 0,
+    Note,
+    ControlChange,
+    PitchBend,
+    Count
+};
+
+// For momentary sources (pads, piezo) value is the note velocity or the CC value sent on activation.
+// Continuous sources (Hall, range, slider) ignore value and are shaped by curve, which momentary sources ignore.
+struct Mapping
+{
+    MappingType type;
+    uint8_t channel; // 0-based MIDI channel
+    uint8_t number;  // Note or CC number
+    uint8_t value;
+    Curve curve = Curve::Linear;
+};
+
+constexpr uint8_t kMappingFlagMpe = 0x01;
+// Dead zones and thresholds may shrink below their defaults on a quiet sensor (noise_floor::set_sensitive)
+constexpr uint8_t kMappingFlagSensitive = 0x02;
+
+struct MappingTable
+{
+    uint8_t flags;
+    Mapping sources[kNumSources];
+
+    const Mapping& operator[](SourceId id) const
+    {
+        return sources[static_cast<size_t>(id)];
+    }
+};
+
+// Double-buffered mapping table. The MIDI loop reads the front table for a whole control cycle and calls commit()
+// between cycles, new tables received over SysEx are written to the back table and only become visible on commit().
+namespace mapping
+{
+void init();
+
+const MappingTable& active();
+
+// Copies table into the back buffer. Returns false if a previously staged table was not committed yet.
+bool stage(const MappingTable& table);
+
+// Swaps the buffers if a table was staged. Returns true when the active table changed.
+bool commit();
+} // namespace mapping
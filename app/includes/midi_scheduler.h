@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Frame-aligned MIDI output.
+// Sensor handlers push timestamped messages from the MIDI task. Each one is held until kReleaseLatencyUs after its
+// capture and the USB start-of-frame callback (tud_task context) releases the ones that are due, so all TinyUSB MIDI
+// writes happen in that callback. The hold absorbs how long the control loop took to get from the reading to the
+// message, as long as that stays under kReleaseLatencyUs. What remains is the wait for the first start of frame after
+// the due time, 0 to 1 ms, so latency lies between kReleaseLatencyUs and one frame more; the stats report that spread
+// as jitter.
+// Each virtual cable has its own queue and cables are drained in order (notes first, see usb_descriptors.h).
+namespace midi_scheduler
+{
+// At least one frame
+constexpr uint32_t kReleaseLatencyUs = 1000;
+constexpr size_t kQueueSize = 256;
+
+struct Stats
+{
+    uint32_t min_latency_us;
+    uint32_t max_latency_us;
+    uint32_t avg_latency_us;
+    uint32_t jitter_us; // max - min
+    uint32_t released;
+    uint32_t dropped;
+};
+
+// Called from the start of frame callback with every packet handed to TinyUSB. The host replay harness logs the MIDI
+// output through it, nothing sets it on the board.
+using ReleaseHook = void (*)(uint32_t timestamp_us, uint32_t release_time_us, const uint8_t packet[4]);
+
+// Must be called after tusb_init()
+void init();
+
+// Queues a channel voice message (2 or 3 bytes) captured at timestamp_us. Returns false if the queue is full.
+bool push(uint32_t timestamp_us, uint8_t cable, const uint8_t* msg, size_t size);
+
+// Queues a complete SysEx message, including the F0 and F7 bytes.
+bool push_sysex(uint32_t timestamp_us, uint8_t cable, const uint8_t* msg, size_t size);
+
+void set_release_hook(ReleaseHook hook);
+
+Stats get_stats();
+void reset_stats();
+
+// Lowest capture-to-release time since boot, kReleaseLatencyUs until a message was released. No message is sent
+// sooner after its capture.
+uint32_t min_release_latency_us();
+} // namespace midi_scheduler
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// MIDI Polyphonic Expression zone manager.
+// Implements a single zone (lower zone by default: master channel 1, member channels 2..16) and hands out one member
+// channel per sounding note so that pitch bend, slide (CC74) and pressure can be sent per note.
+// All operations are constant-time and allocation-free so they can be called from the MIDI control loop.
+class MpeZone
+{
+  public:
+    static constexpr uint8_t kNoChannel = 0xFF;
+    static constexpr uint8_t kNoNote = 0xFF;
+    static constexpr uint8_t kMaxMemberChannels = 15;
+
+    MpeZone();
+
+    // master_channel is 0-based (0 = MIDI channel 1). Member channels are the num_member_channels channels that
+    // directly follow the master channel.
+    void init(uint8_t master_channel, uint8_t num_member_channels);
+
+    // Allocates a member channel for note. If every member channel is busy, the least recently allocated channel is
+    // stolen and the note it was playing is written to stolen_note (kNoNote otherwise).
+    uint8_t allocate(uint8_t note, uint8_t* stolen_note);
+    void release(uint8_t channel);
+
+    uint8_t master_channel() const;
+    uint8_t member_count() const;
+    bool is_active(uint8_t channel) const;
+    uint8_t note(uint8_t channel) const;
+
+  private:
+    uint16_t member_mask_;
+    uint16_t free_mask_;
+    uint8_t master_channel_;
+    uint8_t member_count_;
+    uint8_t cursor_;
+    uint8_t notes_[16];
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free multi-producer / single-consumer ring (per-slot sequence numbers, as in D. Vyukov's bounded
+// queue). Producers never block: push() fails when the ring is full. Safe across both RP2350 cores, which support
+// exclusive accesses to SRAM from either core.
+template <typename T, size_t N>
+class MpscRing
+{
+    static_assert((N & (N - 1)) == 0, "Ring size must be a power of two");
+
+  public:
+    MpscRing() : enqueue_pos_(0), dequeue_pos_(0)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any task or core
+    bool push(const T& value)
+    {
+        uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &slots_[pos & (N - 1)];
+            int32_t diff = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool pop(T* value)
+    {
+        Slot& slot = slots_[dequeue_pos_ & (N - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1)
+        {
+            return false;
+        }
+
+        *value = slot.value;
+        slot.sequence.store(dequeue_pos_ + N, std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        T value;
+    };
+
+    Slot slots_[N];
+    std::atomic<uint32_t> enqueue_pos_;
+    uint32_t dequeue_pos_;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "fixed_point.h"
+
+// Running noise estimate of one sensor channel, from which the channel's dead zone and hysteresis are derived instead
+// of being fixed constants. The estimate is the average absolute second difference |x[n] - 2 x[n-1] + x[n-2]| of
+// samples taken while the channel is idle, about 2 standard deviations for white noise. It needs no mean, and neither
+// a drifting baseline nor a steady ramp counts as noise.
+//
+// Config provides, in the sample type:
+//   kInitialNoise           estimate at start up
+//   kMinNoise, kMaxNoise    range the estimate is kept in. Unless set_sensitive is on, the margins use no less than
+//                           kInitialNoise, so they start at the initial noise and only grow.
+// and the averaging time constants as shifts, 2^shift samples:
+//   kShift                  for differences that look like noise
+//   kSlowShift              for the ones that look like signal
+namespace noise_floor
+{
+// A second difference over this many times the estimate is taken as signal
+constexpr int32_t kOutlierFactor = 4;
+
+namespace detail
+{
+inline bool g_sensitive = false;
+
+template <typename T>
+struct Arithmetic;
+
+template <>
+struct Arithmetic<float>
+{
+    using State = float;
+
+    static float curvature(float x0, float x1, float x2)
+    {
+        return std::abs(x0 - 2.f * x1 + x2);
+    }
+
+    static float times(float x, int32_t factor)
+    {
+        return x * factor;
+    }
+
+    static State state(float x)
+    {
+        return x;
+    }
+
+    static float value(State state)
+    {
+        return state;
+    }
+
+    static State average(State state, float x, int shift)
+    {
+        return state + (x - state) * (1.f / static_cast<float>(1 << shift));
+    }
+};
+
+// Q31 state so that the average does not stall on Q15 rounding
+template <>
+struct Arithmetic<fixed::Q15>
+{
+    using State = fixed::Q31;
+
+    static fixed::Q15 curvature(fixed::Q15 x0, fixed::Q15 x1, fixed::Q15 x2)
+    {
+        return {fixed::saturate16(std::abs(x0.raw - 2 * x1.raw + x2.raw))};
+    }
+
+    static fixed::Q15 times(fixed::Q15 x, int32_t factor)
+    {
+        return {fixed::saturate16(x.raw * factor)};
+    }
+
+    static State state(fixed::Q15 x)
+    {
+        return fixed::widen(x);
+    }
+
+    static fixed::Q15 value(State state)
+    {
+        return fixed::narrow(state);
+    }
+
+    static State average(State state, fixed::Q15 x, int shift)
+    {
+        int64_t difference = static_cast<int64_t>(fixed::widen(x).raw) - state.raw;
+        return {fixed::saturate32(state.raw + (difference >> shift))};
+    }
+};
+
+// Charge counts, the state keeps 8 fractional bits
+template <>
+struct Arithmetic<uint32_t>
+{
+    using State = uint32_t;
+
+    static uint32_t curvature(uint32_t x0, uint32_t x1, uint32_t x2)
+    {
+        int64_t curvature = static_cast<int64_t>(x0) - 2 * static_cast<int64_t>(x1) + x2;
+        return static_cast<uint32_t>(curvature < 0 ? -curvature : curvature);
+    }
+
+    static uint32_t times(uint32_t x, int32_t factor)
+    {
+        return x * static_cast<uint32_t>(factor);
+    }
+
+    static State state(uint32_t x)
+    {
+        return x << 8;
+    }
+
+    static uint32_t value(State state)
+    {
+        return state >> 8;
+    }
+
+    static State average(State state, uint32_t x, int shift)
+    {
+        int64_t difference = (static_cast<int64_t>(x) << 8) - state;
+        return static_cast<State>(state + (difference >> shift));
+    }
+};
+} // namespace detail
+
+// Lets the margins of every channel shrink below their initial value, down to kMinNoise, when the measured noise is
+// lower (mapping flag kMappingFlagSensitive). Set from the MIDI task, which runs all the estimates.
+inline void set_sensitive(bool sensitive)
+{
+    detail::g_sensitive = sensitive;
+}
+
+template <typename T, typename Config>
+class NoiseFloor
+{
+  public:
+    // Feeds a sample taken while the channel is idle. A difference far above the estimate only nudges it up, so a
+    // movement slipping into an idle window hardly counts while a lasting rise of the noise is still followed.
+    void update(T sample)
+    {
+        if (primed_ < 2)
+        {
+            previous_[1] = previous_[0];
+            previous_[0] = sample;
+            ++primed_;
+            return;
+        }
+
+        T difference = Arithmetic::curvature(sample, previous_[0], previous_[1]);
+        previous_[1] = previous_[0];
+        previous_[0] = sample;
+
+        T current = estimate();
+        if (difference <= Arithmetic::times(current, kOutlierFactor))
+        {
+            state_ = Arithmetic::average(state_, difference, Config::kShift);
+        }
+        else
+        {
+            state_ = Arithmetic::average(state_, Arithmetic::times(current, 2), Config::kSlowShift);
+        }
+
+        if (Arithmetic::value(state_) < Config::kMinNoise)
+        {
+            state_ = Arithmetic::state(Config::kMinNoise);
+        }
+    }
+
+    T level() const
+    {
+        T floor = detail::g_sensitive ? Config::kMinNoise : Config::kInitialNoise;
+        return std::clamp(Arithmetic::value(state_), floor, Config::kMaxNoise);
+    }
+
+    // factor times the noise, a dead zone or hysteresis that scales with it
+    T margin(int32_t factor) const
+    {
+        return Arithmetic::times(level(), factor);
+    }
+
+  private:
+    using Arithmetic = detail::Arithmetic<T>;
+
+    // Tracked down to kMinNoise even when the margins do not use it, so turning set_sensitive on acts at once
+    T estimate() const
+    {
+        return std::clamp(Arithmetic::value(state_), Config::kMinNoise, Config::kMaxNoise);
+    }
+
+    typename Arithmetic::State state_ = Arithmetic::state(Config::kInitialNoise);
+    T previous_[2] = {};
+    uint8_t primed_ = 0;
+};
+} // namespace noise_floor
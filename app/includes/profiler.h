@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+
+// Control loop latency histograms. Every section keeps log2 buckets of its duration in microseconds: bucket 0 counts
+// 0 us, bucket n counts [2^(n-1), 2^n) us and the last bucket also takes everything longer. Recording and reading
+// both happen in the MIDI task (SysEx handlers run there), so nothing is locked and the loop is never held up.
+namespace profiler
+{
+constexpr size_t kNumBuckets = 24;
+
+enum class Section : uint8_t
+{
+    Loop = 0, // One full control cycle
+    PitchBend,
+    PiezoTrigger,
+    TouchPad,
+    Vl6180,
+    Count
+};
+
+constexpr size_t kNumSections = static_cast<size_t>(Section::Count);
+
+// Percentiles are the upper bound of the bucket they fall in, capped by the exact maximum
+struct Summary
+{
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+};
+
+// Registers the SysEx commands
+void init();
+
+void record(Section section, uint32_t elapsed_us);
+
+Summary summary(Section section);
+const uint32_t* buckets(Section section);
+void reset();
+
+// Logs every section's summary
+void log_summary();
+
+// Times the enclosing scope
+class ScopedTimer
+{
+  public:
+    explicit ScopedTimer(Section section) : section_(section), start_us_(hal::time_us())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        record(section_, hal::time_us() - start_us_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    Section section_;
+    uint32_t start_us_;
+};
+} // namespace profiler
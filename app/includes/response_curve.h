@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "fixed_point.h"
+
+// Response curves shaping a continuous source between the sensor and MIDI, chosen per mapping (Mapping::curve). Each
+// curve is a table of kSegments + 1 points on [0, 1] computed at compile time, so applying one is a table read and a
+// linear interpolation whatever the curve. Bipolar values (-1 to 1) are shaped symmetrically around 0.
+enum class Curve : uint8_t
+{
+    Linear = 0,
+    Exponential, // Slow start, most of the range at the top
+    Logarithmic, // Inverse of Exponential
+    SCurve,      // Fine control at both ends
+    Count
+};
+
+namespace response_curve
+{
+constexpr size_t kSegments = 64;
+constexpr int32_t kOne = 32768;
+constexpr int kSegmentShift = 9; // Q15 input to segment, 32768 / kSegments = 2^9
+
+namespace detail
+{
+// Steepness of Exponential and Logarithmic: the slope at the steep end is e^3, about 20 times the one at the other
+constexpr double kSteepness = 3.0;
+
+constexpr double exp(double x)
+{
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 60; ++n)
+    {
+        term *= x / n;
+        sum += term;
+    }
+    return sum;
+}
+
+// ln(x) = 2 atanh((x - 1) / (x + 1)), x > 0
+constexpr double log(double x)
+{
+    double z = (x - 1.0) / (x + 1.0);
+    double power = z;
+    double sum = 0.0;
+    for (int n = 1; n < 400; n += 2)
+    {
+        sum += power / n;
+        power *= z * z;
+    }
+    return 2.0 * sum;
+}
+
+constexpr double shape(Curve curve, double x)
+{
+    switch (curve)
+    {
+    case Curve::Exponential:
+        return (exp(kSteepness * x) - 1.0) / (exp(kSteepness) - 1.0);
+    case Curve::Logarithmic:
+        return log(1.0 + (exp(kSteepness) - 1.0) * x) / kSteepness;
+    case Curve::SCurve:
+        return x * x * x * (x * (6.0 * x - 15.0) + 10.0);
+    default:
+        return x;
+    }
+}
+
+using Table = std::array<uint16_t, kSegments + 1>;
+
+// 1 is stored as kOne
+constexpr Table make_table(Curve curve)
+{
+    Table table{};
+    for (size_t i = 0; i <= kSegments; ++i)
+    {
+        double y = shape(curve, static_cast<double>(i) / kSegments);
+        table[i] = static_cast<uint16_t>(y * kOne + 0.5);
+    }
+    return table;
+}
+
+constexpr Table kTables[] = {
+    make_table(Curve::Linear),
+    make_table(Curve::Exponential),
+    make_table(Curve::Logarithmic),
+    make_table(Curve::SCurve),
+};
+static_assert(std::size(kTables) == static_cast<size_t>(Curve::Count), "One table per curve");
+
+constexpr const Table& table(Curve curve)
+{
+    return kTables[static_cast<size_t>(curve) < std::size(kTables) ? static_cast<size_t>(curve) : 0];
+}
+} // namespace detail
+
+inline float apply(Curve curve, float value)
+{
+    if (curve == Curve::Linear)
+    {
+        return value;
+    }
+
+    const detail::Table& table = detail::table(curve);
+    float magnitude = value < 0.f ? -value : value;
+    float position = (magnitude < 1.f ? magnitude : 1.f) * kSegments;
+    size_t i = static_cast<size_t>(position);
+    i = i < kSegments ? i : kSegments - 1;
+    float shaped = (table[i] + (table[i + 1] - table[i]) * (position - i)) * (1.f / kOne);
+    return value < 0.f ? -shaped : shaped;
+}
+
+inline fixed::Q15 apply(Curve curve, fixed::Q15 value)
+{
+    if (curve == Curve::Linear)
+    {
+        return value;
+    }
+
+    const detail::Table& table = detail::table(curve);
+    int32_t magnitude = value.raw < 0 ? -value.raw : value.raw;
+    magnitude = magnitude < INT16_MAX ? magnitude : INT16_MAX;
+    int32_t i = magnitude >> kSegmentShift;
+    int32_t fraction = magnitude & ((1 << kSegmentShift) - 1);
+    int32_t shaped = table[i] + (((table[i + 1] - table[i]) * fraction) >> kSegmentShift);
+    return {fixed::saturate16(value.raw < 0 ? -shaped : shaped)};
+}
+} // namespace response_curve
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include "fixed_point.h"
+
+// Per-sample arithmetic of the sensor handlers in midi_controller.cpp and cap_touch.cpp. It holds no state and touches
+// no hardware, so the microbenchmarks (bench_cases.cpp) time exactly what the control loop runs.
+//
+// The continuous sensors are processed as Value, float by default. Building with MEMBRAIN_FIXED_POINT=1 makes it
+// fixed::Q15 with Q31 filter state, which keeps the MIDI task off the FPU. Both variants are always compiled so the
+// benchmarks can compare them; the float one is the reference. host/test checks the Q15 kernels against it over their
+// whole input range.
+namespace sensor_math
+{
+constexpr uint16_t kAdcMidpoint = 2048;
+constexpr float kAdcNormalizationFactor = 1.f / 2048.f;
+constexpr uint16_t kPitchBendCenter = 8192;
+constexpr uint16_t kMaxPitchBend = 8191;
+
+// Ranges are carried as a fraction of the VL6180's 8-bit full scale, so they fit Q15
+constexpr float kRangeFullScaleMm = 256.f;
+
+#if MEMBRAIN_FIXED_POINT
+using Value = fixed::Q15;
+using Accumulator = fixed::Q31;
+
+constexpr Value constant(float x)
+{
+    return fixed::q15(x);
+}
+#else
+using Value = float;
+using Accumulator = float;
+
+constexpr Value constant(float x)
+{
+    return x;
+}
+#endif
+
+constexpr float to_float(float x)
+{
+    return x;
+}
+
+using fixed::to_float;
+
+// Filter state to the value passed on
+constexpr float narrow(float x)
+{
+    return x;
+}
+
+using fixed::narrow;
+
+// 12-bit reading of a Hall sensor to its deflection around the midpoint, -1 to 1
+template <typename T = float>
+inline T hall_deflection(uint16_t adc)
+{
+    if constexpr (std::is_same_v<T, fixed::Q15>)
+    {
+        return {static_cast<int16_t>((adc - kAdcMidpoint) * 16)};
+    }
+    else
+    {
+        return (adc - static_cast<float>(kAdcMidpoint)) * kAdcNormalizationFactor;
+    }
+}
+
+// Range reading to its fraction of kRangeFullScaleMm
+template <typename T = float>
+inline T range_fraction(uint8_t range_mm)
+{
+    if constexpr (std::is_same_v<T, fixed::Q15>)
+    {
+        return {static_cast<int16_t>(range_mm * 128)};
+    }
+    else
+    {
+        return range_mm * (1.f / kRangeFullScaleMm);
+    }
+}
+
+// Membrane displacement seen by the three Hall sensors, the first one weighted most
+inline float hall_weighted(float hall1, float hall2, float hall3)
+{
+    return (hall3 + 2.f * hall2 + 3.f * hall1) / 6.f;
+}
+
+// Centroid of the deflections with sensor 1 at 0 and sensor 3 at 1. Keeps previous while the membrane is at rest.
+inline float strike_position(float hall1, float hall2, float hall3, float min_weight, float previous)
+{
+    float weight = std::abs(hall1) + std::abs(hall2) + std::abs(hall3);
+    return weight > min_weight ? (0.5f * std::abs(hall2) + std::abs(hall3)) / weight : previous;
+}
+
+// One-pole low pass with unity gain at DC: y = (1 - |a1|) x + a1 y[-1]
+inline float one_pole(float x, float previous, float a1)
+{
+    return (1.f - std::abs(a1)) * x + a1 * previous;
+}
+
+inline bool exceeds_hysteresis(float value, float last_sent, float hysteresis)
+{
+    return std::abs(value - last_sent) > hysteresis;
+}
+
+// Range in mm to 1 at min_mm and closer, 0 at max_mm and farther
+inline float normalize_range(float range_mm, float min_mm, float max_mm)
+{
+    return 1.f - (std::clamp(range_mm, min_mm, max_mm) - min_mm) * (1.f / (max_mm - min_mm));
+}
+
+// 0 to 1 to a 7-bit controller value
+inline uint8_t to_cc(float value)
+{
+    return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 127);
+}
+
+// 0 to 1 to a 14-bit controller value, MSB and LSB
+inline uint16_t to_cc14(float value)
+{
+    return static_cast<uint16_t>(std::clamp(value, 0.f, 1.f) * 16383);
+}
+
+// num / den, at most 1. 0 when den is 0, there is nothing to measure against.
+template <typename T = float>
+inline T fraction(uint32_t num, uint32_t den)
+{
+    if constexpr (std::is_same_v<T, fixed::Q15>)
+    {
+        uint64_t scaled = den != 0 ? (static_cast<uint64_t>(num) << 15) / den : 0;
+        return {static_cast<int16_t>(std::min<uint64_t>(scaled, INT16_MAX))};
+    }
+    else
+    {
+        return den != 0 ? std::min(static_cast<float>(num) / static_cast<float>(den), 1.f) : 0.f;
+    }
+}
+
+// -1 to 1 to a 14-bit pitch bend around the center
+inline uint16_t to_pitch_bend(float value)
+{
+    return static_cast<uint16_t>(kPitchBendCenter + kMaxPitchBend * std::clamp(value, -1.f, 1.f));
+}
+
+// Charge count above the pad's baseline. Counts are unsigned, so a total under the baseline wraps to a large value.
+inline bool touch_detected(uint32_t total, uint32_t baseline, uint32_t threshold)
+{
+    return (total - baseline) > threshold;
+}
+
+// Charge count above the baseline to a 7-bit pressure, 0 at min and below, 127 at max and above
+inline uint8_t touch_pressure(uint32_t magnitude, uint32_t min, uint32_t max)
+{
+    return static_cast<uint8_t>((std::clamp(magnitude, min, max) - min) * (127.f / (max - min)));
+}
+
+// Q15 counterparts of the above. Results in Q15 are rounded to nearest, conversions to MIDI values round down like the
+// float to integer casts do. Q15 cannot hold 1, its largest value stands for it.
+
+inline fixed::Q15 hall_weighted(fixed::Q15 hall1, fixed::Q15 hall2, fixed::Q15 hall3)
+{
+    return {fixed::saturate16((hall3.raw + 2 * hall2.raw + 3 * hall1.raw) / 6)};
+}
+
+inline fixed::Q15 strike_position(fixed::Q15 hall1, fixed::Q15 hall2, fixed::Q15 hall3, fixed::Q15 min_weight,
+                                  fixed::Q15 previous)
+{
+    int32_t abs2 = std::abs(static_cast<int32_t>(hall2.raw));
+    int32_t abs3 = std::abs(static_cast<int32_t>(hall3.raw));
+    int32_t weight = std::abs(static_cast<int32_t>(hall1.raw)) + abs2 + abs3;
+    if (weight <= min_weight.raw)
+    {
+        return previous;
+    }
+    return {fixed::saturate16(((abs2 + 2 * abs3) * 16384 + weight / 2) / weight)};
+}
+
+// The state is Q31 so that slow decays are not lost to Q15 rounding
+inline fixed::Q31 one_pole(fixed::Q15 x, fixed::Q31 previous, fixed::Q15 a1)
+{
+    int64_t b0 = 32768 - std::abs(static_cast<int32_t>(a1.raw));
+    return {fixed::saturate32(b0 * x.raw * 2 + ((static_cast<int64_t>(a1.raw) * previous.raw) >> 15))};
+}
+
+inline bool exceeds_hysteresis(fixed::Q15 value, fixed::Q15 last_sent, fixed::Q15 hysteresis)
+{
+    return std::abs(static_cast<int32_t>(value.raw) - last_sent.raw) > hysteresis.raw;
+}
+
+inline fixed::Q15 normalize_range(fixed::Q15 range, fixed::Q15 min, fixed::Q15 max)
+{
+    int32_t clamped = std::clamp(range.raw, min.raw, max.raw);
+    int32_t span = max.raw - min.raw;
+    return {fixed::saturate16(((max.raw - clamped) * 32768 + span / 2) / span)};
+}
+
+inline uint8_t to_cc(fixed::Q15 value)
+{
+    if (value.raw == INT16_MAX)
+    {
+        return 127;
+    }
+    return static_cast<uint8_t>((std::max<int32_t>(value.raw, 0) * 127) >> 15);
+}
+
+inline uint16_t to_cc14(fixed::Q15 value)
+{
+    if (value.raw == INT16_MAX)
+    {
+        return 16383;
+    }
+    return static_cast<uint16_t>((std::max<int32_t>(value.raw, 0) * 16383) >> 15);
+}
+
+// The shift rounds down on both sides of the center like the float cast does on its always positive result
+inline uint16_t to_pitch_bend(fixed::Q15 value)
+{
+    if (value.raw == INT16_MAX)
+    {
+        return kPitchBendCenter + kMaxPitchBend;
+    }
+    return static_cast<uint16_t>(kPitchBendCenter + ((value.raw * kMaxPitchBend) >> 15));
+}
+} // namespace sensor_math
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+
+#include "hal.h"
+#include "noise_floor.h"
+#include "profiler.h"
+#include "sensor_math.h"
+#include "trace.h"
+
+// Sensor processing composed at compile time. A pipeline chains four stages, plain structs holding their own state:
+//   Source   void init()                          sets the sensor up
+//            bool due()                           whether it is read on this cycle
+//            Sample read()                        reads it and stamps the capture time
+//   Filter   Value process(const Sample&)
+//   Mapper   bool map(const Value&, Output*)      whether the value is worth sending
+//   Emitter  void emit(const Output&)
+// The stages are template parameters, so a pipeline compiles to straight-line code with every stage inlined and no
+// indirect call. Pipelines<> runs a list of pipelines in order and Timed<> puts one under a profiler section and trace
+// span. midi_controller.cpp lists the sensors as one Pipelines<> type.
+namespace sensor_pipeline
+{
+template <typename Source, typename Filter, typename Mapper, typename Emitter>
+class Pipeline
+{
+  public:
+    void init()
+    {
+        source_.init();
+    }
+
+    bool due()
+    {
+        return source_.due();
+    }
+
+    void run()
+    {
+        typename Mapper::Output output;
+        if (mapper_.map(filter_.process(source_.read()), &output))
+        {
+            emitter_.emit(output);
+        }
+    }
+
+    const Mapper& mapper() const
+    {
+        return mapper_;
+    }
+
+  private:
+    Source source_;
+    Filter filter_;
+    Mapper mapper_;
+    Emitter emitter_;
+};
+
+template <typename... Stages>
+class Pipelines
+{
+  public:
+    void init()
+    {
+        std::apply([](auto&... stage) { (stage.init(), ...); }, stages_);
+    }
+
+    bool due()
+    {
+        return true;
+    }
+
+    void run()
+    {
+        std::apply([](auto&... stage) { ((stage.due() ? stage.run() : void()), ...); }, stages_);
+    }
+
+    template <typename Stage>
+    const Stage& get() const
+    {
+        return std::get<Stage>(stages_);
+    }
+
+  private:
+    std::tuple<Stages...> stages_;
+};
+
+// Only the cycles the stage is due on are timed
+template <profiler::Section kSection, trace::Span kSpan, typename Stage>
+class Timed
+{
+  public:
+    void init()
+    {
+        stage_.init();
+    }
+
+    bool due()
+    {
+        return stage_.due();
+    }
+
+    void run()
+    {
+        profiler::ScopedTimer timer(kSection);
+        trace::ScopedSpan span(kSpan);
+        stage_.run();
+    }
+
+    const Stage& stage() const
+    {
+        return stage_;
+    }
+
+  private:
+    Stage stage_;
+};
+
+// Schedules of sources
+struct EveryCycle
+{
+    bool due()
+    {
+        return true;
+    }
+};
+
+template <uint32_t kPeriodMs>
+class EveryPeriod
+{
+  public:
+    bool due()
+    {
+        uint32_t now = hal::time_ms();
+        if (now - last_ms_ < kPeriodMs)
+        {
+            return false;
+        }
+        last_ms_ = now;
+        return true;
+    }
+
+  private:
+    uint32_t last_ms_ = 0;
+};
+
+struct Identity
+{
+    template <typename T>
+    const T& process(const T& value)
+    {
+        return value;
+    }
+};
+
+// One-pole low pass with the coefficient Config::kA1
+template <typename Config>
+class OnePole
+{
+  public:
+    sensor_math::Value process(sensor_math::Value x)
+    {
+        y_ = sensor_math::one_pole(x, y_, Config::kA1);
+        return sensor_math::narrow(y_);
+    }
+
+  private:
+    sensor_math::Accumulator y_ = {};
+};
+
+// Passes a value over the dead zone once it has moved more than the hysteresis from the last one passed. Both scale
+// with the input's noise, Config::kThresholdFactor and Config::kHysteresisFactor times the estimate of a
+// noise_floor::NoiseFloor<Value, Config>. The estimate is fed the values inside the dead zone on either side of rest;
+// values under the dead zone are never passed.
+template <typename Config>
+class AdaptiveHysteresis
+{
+  public:
+    using Output = sensor_math::Value;
+
+    bool map(sensor_math::Value value, sensor_math::Value* output)
+    {
+        sensor_math::Value threshold = noise_.margin(Config::kThresholdFactor);
+        if (value <= threshold)
+        {
+            // A deflection the other way is a movement, not noise
+            if (!sensor_math::exceeds_hysteresis(value, sensor_math::Value{}, threshold))
+            {
+                noise_.update(value);
+            }
+            return false;
+        }
+        if (!sensor_math::exceeds_hysteresis(value, last_, noise_.margin(Config::kHysteresisFactor)))
+        {
+            return false;
+        }
+        last_ = value;
+        *output = value;
+        return true;
+    }
+
+  private:
+    noise_floor::NoiseFloor<sensor_math::Value, Config> noise_;
+    sensor_math::Value last_ = {};
+};
+
+// Passes a 0 to 1 value when it changes as a 7-bit controller value and has moved more than Config::kHysteresisFactor
+// times its noise. Every value feeds the estimate, the outlier test of NoiseFloor keeps movements out of it.
+template <typename Config>
+class AdaptiveCcChange
+{
+  public:
+    using Output = sensor_math::Value;
+
+    bool map(sensor_math::Value value, sensor_math::Value* output)
+    {
+        noise_.update(value);
+        uint8_t cc = sensor_math::to_cc(value);
+        if (cc == last_cc_ ||
+            !sensor_math::exceeds_hysteresis(value, last_, noise_.margin(Config::kHysteresisFactor)))
+        {
+            return false;
+        }
+        last_cc_ = cc;
+        last_ = value;
+        *output = value;
+        return true;
+    }
+
+    uint8_t last() const
+    {
+        return last_cc_;
+    }
+
+  private:
+    noise_floor::NoiseFloor<sensor_math::Value, Config> noise_;
+    sensor_math::Value last_ = {};
+    uint8_t last_cc_ = 0;
+};
+} // namespace sensor_pipeline
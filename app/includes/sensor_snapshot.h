@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sensor_math.h"
+
+constexpr size_t kSnapshotPads = 4;
+
+// Latest sensor state as seen by the MIDI task, published once per control cycle for consumers on the other core.
+struct SensorSnapshot
+{
+    uint32_t timestamp_us;
+    uint32_t hit_count;                    // Incremented on every piezo hit
+    uint32_t hit_time_us;
+    sensor_math::Value strike_position;    // Estimated position of the last hit, 0 to 1 across the Hall sensors
+    sensor_math::Value hall;               // Filtered Hall displacement, -1 to 1
+    uint8_t hit_velocity;                  // 0-127
+    uint8_t touch_pressure[kSnapshotPads]; // 0-127, 0 when the pad is released
+};
+
+namespace sensor_snapshot
+{
+// MIDI task only. Never blocks.
+void publish(const SensorSnapshot& snapshot);
+
+// Any task or core. Returns false if the snapshot was being rewritten on every attempt.
+bool read(SensorSnapshot* snapshot);
+} // namespace sensor_snapshot
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "sensor_stream_format.h"
+
+// Raw sensor streaming on the vendor bulk interface. Frames are only queued once the host sent kCommandStart, and a
+// frame that does not fit in the TinyUSB FIFO is dropped so the MIDI path never waits on the stream.
+namespace sensor_stream
+{
+void init();
+
+bool is_streaming();
+
+void write_hall(uint32_t timestamp_us, const uint16_t adc[3]);
+void write_cap_touch(uint32_t timestamp_us, uint8_t pad, uint32_t total);
+void write_range(uint32_t timestamp_us, uint8_t range_mm, uint8_t status);
+
+// Polls host commands and flushes the queued frames. Called once per control cycle.
+void flush();
+
+uint32_t dropped_frames();
+} // namespace sensor_stream
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// Wire format of the raw sensor stream sent on the vendor bulk interface. Shared with the host tools, so this header
+// must not depend on the pico SDK.
+//
+// The stream is a sequence of frames, each one a FrameHeader followed by the payload of its source. All fields are
+// little endian, which is the native byte order on both ends. When started with kCommandStartCompressed the stream
+// uses the delta-encoded format of capture_codec.h instead.
+namespace sensor_stream
+{
+constexpr uint8_t kFrameMagic = 0xA5;
+
+// Host to device commands, one byte each, written to the vendor OUT endpoint
+constexpr uint8_t kCommandStart = 'S';
+constexpr uint8_t kCommandStartCompressed = 'C'; // stream capture_codec records instead of frames
+constexpr uint8_t kCommandStop = 'X';
+constexpr uint8_t kCommandDumpTrace = 'T'; // stop streaming and send the trace buffer once (trace_format.h)
+
+enum class Source : uint8_t
+{
+    Hall = 1,
+    CapTouch = 2,
+    Range = 3,
+};
+
+struct __attribute__((packed)) FrameHeader
+{
+    uint8_t magic;
+    Source source;
+    uint16_t size; // payload size in bytes
+    uint32_t timestamp_us;
+};
+
+// Raw 12-bit ADC readings of the three Hall sensors
+struct __attribute__((packed)) HallPayload
+{
+    uint16_t adc[3];
+};
+
+// Charge count of one cap-touch pad for a full read (sum over all samples)
+struct __attribute__((packed)) CapTouchPayload
+{
+    uint8_t pad;
+    uint32_t total;
+};
+
+// Unfiltered VL6180X range in mm and the RESULT_RANGE_STATUS error code
+struct __attribute__((packed)) RangePayload
+{
+    uint8_t range_mm;
+    uint8_t status;
+};
+
+static_assert(sizeof(FrameHeader) == 8, "Unexpected frame header size");
+static_assert(sizeof(HallPayload) == 6, "Unexpected Hall payload size");
+static_assert(sizeof(CapTouchPayload) == 5, "Unexpected cap-touch payload size");
+static_assert(sizeof(RangePayload) == 2, "Unexpected range payload size");
+} // namespace sensor_stream
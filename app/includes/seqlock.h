@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock. The writer never waits; readers copy the value and retry if a write happened in the
+// meantime. The value is stored as relaxed atomic words so concurrent reads are well defined on both cores.
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied word by word");
+
+  public:
+    static constexpr int kMaxReadAttempts = 4;
+
+    Seqlock() : sequence_(0)
+    {
+        for (auto& word : words_)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer only
+    void write(const T& value)
+    {
+        uint32_t buffer[kWords] = {0};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i)
+        {
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Any task or core. Returns false if every attempt overlapped a write, value is left untouched in that case.
+    bool read(T* value) const
+    {
+        uint32_t buffer[kWords];
+        for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt)
+        {
+            uint32_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < kWords; ++i)
+            {
+                buffer[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before)
+            {
+                std::memcpy(value, buffer, sizeof(T));
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence_;
+    std::atomic<uint32_t> words_[kWords];
+};
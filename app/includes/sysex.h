@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Membrain SysEx protocol: F0 <manufacturer> <device> <command> <payload...> F7
+// The non-commercial manufacturer ID is used since this is a prototyping platform.
+namespace sysex
+{
+constexpr uint8_t kManufacturerId = 0x7D;
+constexpr uint8_t kDeviceId = 0x4D; // 'M'
+constexpr size_t kMaxMessageSize = 256;
+constexpr size_t kMaxCommands = 32;
+
+enum Command : uint8_t
+{
+    SetMapping = 0x01,
+    ResetMapping = 0x02,
+    DumpMapping = 0x03,
+    SchedulerStats = 0x04,
+    Visualizer = 0x05,
+    TelemetrySnapshot = 0x06,
+    ProfileSummary = 0x07,
+    ProfileHistogram = 0x08,
+    LatencyMode = 0x09,
+    TimestampEcho = 0x0A,
+    Ping = 0x0B,
+    TaskStats = 0x0C,
+    SetCurve = 0x0D,
+};
+
+// 32-bit values are sent as five 7-bit groups, least significant first
+constexpr size_t kEncodedU32Size = 5;
+constexpr size_t kHeaderSize = 4; // F0, manufacturer, device, command
+
+// Payload excludes the header and the terminating F7. All payload bytes are 7-bit.
+using Handler = void (*)(const uint8_t* payload, size_t size);
+
+void register_handler(uint8_t command, Handler handler);
+
+// Reads pending bytes from the MIDI OUT endpoint, of any cable (see hal.h), and dispatches every complete message.
+// Must be called from the MIDI task, handlers run in that context.
+void poll();
+
+// Queues F0 <manufacturer> <device> <command> <payload> F7 on the diagnostics cable. Payload bytes must be 7-bit.
+void send(uint8_t command, const uint8_t* payload, size_t size);
+
+// Same on another cable, released with the events captured at timestamp_us
+void send(uint8_t command, const uint8_t* payload, size_t size, uint8_t cable, uint32_t timestamp_us);
+
+// Writes value to out and returns the position after the encoded bytes
+uint8_t* encode_u32(uint32_t value, uint8_t* out);
+} // namespace sysex
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// FreeRTOS run-time statistics. The kernel charges run time to tasks in microseconds of the hardware timer (see
+// portGET_RUN_TIME_COUNTER_VALUE in FreeRTOSConfig_examples_common.h). poll() samples every task once per
+// kSampleIntervalMs and keeps the CPU load over the last interval, each core's idle time, the stack high-water marks
+// and the heap low-water mark, so stack and heap sizes can be chosen from measurements instead of guesses.
+// Sampling and SysEx requests both run in the MIDI task.
+namespace task_stats
+{
+constexpr uint32_t kSampleIntervalMs = 1000;
+constexpr size_t kMaxTasks = 12;
+constexpr size_t kMaxCores = 2;
+constexpr size_t kMaxNameLength = 12; // Longer task names are truncated
+
+// A task whose free stack falls below this is reported once
+constexpr uint32_t kLowStackWords = 64;
+
+struct TaskSample
+{
+    char name[kMaxNameLength + 1];
+    uint8_t priority;
+    int8_t core;               // Core the task is pinned to, -1 if it can run on any
+    uint16_t cpu_permille;     // Of one core, over the last interval
+    uint32_t stack_free_words; // Lowest since the task started
+};
+
+struct SystemSample
+{
+    size_t core_count;
+    uint16_t idle_permille[kMaxCores];
+    uint32_t heap_free_bytes;
+    uint32_t heap_min_free_bytes;
+    size_t task_count;
+    TaskSample tasks[kMaxTasks];
+};
+
+// Registers the SysEx command
+void init();
+
+// Takes a new sample when the interval elapsed. Called from the MIDI task.
+void poll();
+
+// Latest sample, empty until the first interval elapsed
+const SystemSample& latest();
+
+// Logs the latest sample, one line per task
+void log_summary();
+} // namespace task_stats
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Sensor and pipeline health counters. Failure paths count instead of logging every occurrence, and a summary of the
+// counters that moved is logged at most once per kSummaryIntervalMs. Counters are cumulative since boot, unlike the
+// windowed statistics kept by the modules themselves.
+namespace telemetry
+{
+constexpr uint32_t kSummaryIntervalMs = 5000;
+
+// VL6180X range status codes are 4 bits (VL6180X_ERROR_*)
+constexpr size_t kNumRangeStatuses = 16;
+
+enum class Counter : uint8_t
+{
+    I2cWriteError = 0,
+    I2cReadError,
+    RangeNotReady,
+    RangePollTimeout,
+    CapTouchTimeout,
+    MidiDropped,
+    SensorStreamDropped,
+    LedCommandDropped,
+    LogRecordDropped,
+    Count
+};
+
+constexpr size_t kNumCounters = static_cast<size_t>(Counter::Count);
+
+// Registers the snapshot SysEx command
+void init();
+
+// Lock-free, callable from any task, core or interrupt
+void increment(Counter counter);
+void record_range_status(uint8_t status);
+
+uint32_t get(Counter counter);
+uint32_t range_status_count(uint8_t status);
+
+// Logs the summary when the interval elapsed. Called from the MIDI task.
+void poll();
+} // namespace telemetry
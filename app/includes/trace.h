@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "trace_format.h"
+
+// Scheduler trace recorder for offline timeline analysis. When built with MEMBRAIN_TRACE (cmake -DMEMBRAIN_TRACE=ON),
+// the FreeRTOS trace hooks (trace_hooks.h), the application interrupts and the spans below write 8-byte records into
+// one RAM ring per core, which always holds the latest kRecordsPerCore events. Writers claim a slot with an atomic
+// increment, so any task or interrupt on either core can record without a lock. sensor_stream sends the buffer to the
+// host on kCommandDumpTrace (membrain_capture -t), and membrain_trace converts the dump to a Chrome/Perfetto trace.
+// Without MEMBRAIN_TRACE every recording call compiles to nothing.
+namespace trace
+{
+#if MEMBRAIN_TRACE
+void record(Event event, uint16_t arg);
+#else
+inline void record(Event, uint16_t)
+{
+}
+#endif
+
+// Fills in the buffer header. Called first thing in main(), records written before are kept.
+void init();
+
+// Recording is enabled from boot. Disabling freezes the ring and stamps the dump time.
+void set_enabled(bool enabled);
+
+// The buffer as described in trace_format.h, empty without MEMBRAIN_TRACE
+const uint8_t* data();
+size_t size();
+
+inline void isr_enter(Isr isr)
+{
+    record(Event::IsrEnter, static_cast<uint16_t>(isr));
+}
+
+inline void isr_exit(Isr isr)
+{
+    record(Event::IsrExit, static_cast<uint16_t>(isr));
+}
+
+// Records the enclosing scope as a span
+class ScopedSpan
+{
+  public:
+    explicit ScopedSpan(Span span) : span_(span)
+    {
+        record(Event::SpanBegin, static_cast<uint16_t>(span_));
+    }
+
+    ~ScopedSpan()
+    {
+        record(Event::SpanEnd, static_cast<uint16_t>(span_));
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+  private:
+    Span span_;
+};
+} // namespace trace
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Memory layout of the scheduler trace buffer (trace.h). The device sends the buffer as it is in RAM on the vendor
+// interface when asked with sensor_stream::kCommandDumpTrace, so this header is shared with the host tools and must not
+// depend on the pico SDK. All fields are little endian and naturally aligned, so the structs have no padding and the
+// device can update them with word accesses.
+namespace trace
+{
+constexpr uint32_t kMagic = 0x4352544D; // "MTRC"
+constexpr uint16_t kVersion = 1;
+constexpr size_t kMaxCores = 2;
+constexpr size_t kRecordsPerCore = 4096; // Power of two
+constexpr size_t kMaxTasks = 16;         // Task numbers are 1 to kMaxTasks - 1, 0 is unknown
+constexpr size_t kTaskNameSize = 16;
+
+static_assert((kRecordsPerCore & (kRecordsPerCore - 1)) == 0, "Ring indices are masked");
+
+enum class Event : uint8_t
+{
+    None = 0,        // Never written, marks an unused slot
+    TaskSwitchedIn,  // arg: task number
+    TaskSwitchedOut, // arg: task number
+    IsrEnter,        // arg: Isr
+    IsrExit,         // arg: Isr
+    QueueSend,       // arg: queue number, semaphore gives and mutex releases included
+    QueueReceive,    // arg: queue number, semaphore and mutex takes included
+    QueueBlock,      // arg: queue number, the running task blocks on it
+    TaskNotify,      // arg: task number of the notified task
+    NotifyTake,      // arg: 0
+    NotifyBlock,     // arg: 0, the running task blocks waiting for a notification
+    SpanBegin,       // arg: Span
+    SpanEnd,         // arg: Span
+    Count
+};
+
+// Code sections of interest, drawn on the track of the task that ran them
+enum class Span : uint16_t
+{
+    MidiCycle = 0,
+    PitchBend,
+    PiezoTrigger,
+    TouchPad,
+    Vl6180,
+    MidiRelease, // midi_scheduler frame release in tud_sof_cb
+    ShowFrame,   // LED frame handed to the DMA
+    Count
+};
+
+constexpr const char* kSpanNames[] = {"MIDI cycle", "pitch bend", "piezo", "touch pads",
+                                      "VL6180X",    "MIDI release", "LED frame"};
+static_assert(sizeof(kSpanNames) / sizeof(kSpanNames[0]) == static_cast<size_t>(Span::Count),
+              "Every span needs a name");
+
+// Application interrupt handlers. Kernel interrupts (SysTick, the yield and inter-core interrupts) are visible as
+// task switches.
+enum class Isr : uint16_t
+{
+    LedDma = 0,
+    LedResetAlarm,
+    Count
+};
+
+constexpr const char* kIsrNames[] = {"LED DMA", "LED reset alarm"};
+static_assert(sizeof(kIsrNames) / sizeof(kIsrNames[0]) == static_cast<size_t>(Isr::Count),
+              "Every interrupt needs a name");
+
+struct Record
+{
+    uint32_t timestamp_us; // Lower 32 bits of the 1 MHz timer
+    Event event;
+    uint8_t reserved;
+    uint16_t arg;
+};
+
+struct Header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t core_count;
+    uint8_t reserved;
+    uint32_t records_per_core;
+
+    // Timer value when the buffer was frozen for the dump. Records are older, which is how the host unwraps them.
+    uint32_t dump_time_us;
+
+    // Records ever written per core. The ring holds the last min(write_index, records_per_core) of them, record n is at
+    // index n % records_per_core.
+    uint32_t write_index[kMaxCores];
+
+    // Null-terminated unless the name fills the slot
+    char task_names[kMaxTasks][kTaskNameSize];
+};
+
+// Records of core c start at sizeof(Header) + c * records_per_core * sizeof(Record)
+struct Buffer
+{
+    Header header;
+    Record records[kMaxCores][kRecordsPerCore];
+};
+
+static_assert(sizeof(Record) == 8, "Unexpected trace record size");
+static_assert(sizeof(Header) == 24 + kMaxTasks * kTaskNameSize, "Unexpected trace header size");
+static_assert(sizeof(Buffer) == sizeof(Header) + kMaxCores * kRecordsPerCore * sizeof(Record),
+              "Unexpected trace buffer size");
+} // namespace trace
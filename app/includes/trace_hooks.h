@@ -0,0 +1,43 @@
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+
+// FreeRTOS trace macros feeding the scheduler trace recorder (trace.h). Included at the end of FreeRTOSConfig, so this
+// is also compiled as C by the kernel sources. The macros expand inside tasks.c and queue.c, where pxCurrentTCB,
+// pxTCB and pxQueue are the kernel's own variables.
+#if MEMBRAIN_TRACE && !defined(__ASSEMBLER__)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void trace_task_create(void* task);
+void trace_task_switched_in(void* task);
+void trace_task_switched_out(void* task);
+void trace_task_notify(void* task);
+void trace_task_notify_take(int blocked);
+void trace_queue_create(void* queue);
+void trace_queue_send(void* queue);
+void trace_queue_receive(void* queue);
+void trace_queue_block(void* queue);
+#ifdef __cplusplus
+}
+#endif
+
+#define traceTASK_CREATE(pxNewTCB)                           trace_task_create(pxNewTCB)
+#define traceTASK_SWITCHED_IN()                              trace_task_switched_in(pxCurrentTCB)
+#define traceTASK_SWITCHED_OUT()                             trace_task_switched_out(pxCurrentTCB)
+#define traceTASK_NOTIFY(uxIndexToNotify)                    trace_task_notify(pxTCB)
+#define traceTASK_NOTIFY_FROM_ISR(uxIndexToNotify)           trace_task_notify(pxTCB)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify)      trace_task_notify(pxTCB)
+#define traceTASK_NOTIFY_TAKE(uxIndexToWaitOn)               trace_task_notify_take(0)
+#define traceTASK_NOTIFY_TAKE_BLOCK(uxIndexToWaitOn)         trace_task_notify_take(1)
+#define traceQUEUE_CREATE(pxNewQueue)                        trace_queue_create(pxNewQueue)
+#define traceQUEUE_SEND(pxQueue)                             trace_queue_send(pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)                    trace_queue_send(pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)                          trace_queue_receive(pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)                 trace_queue_receive(pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)                 trace_queue_block(pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)              trace_queue_block(pxQueue)
+
+#endif
+
+#endif
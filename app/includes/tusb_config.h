@@ -82,12 +82,16 @@ extern "C"
 #define CFG_TUD_MSC    0
 #define CFG_TUD_HID    0
 #define CFG_TUD_MIDI   1
-#define CFG_TUD_VENDOR 0
+#define CFG_TUD_VENDOR 1
 
 // MIDI FIFO size of TX and RX
 #define CFG_TUD_MIDI_RX_BUFSIZE (TUD_OPT_HIGH_SPEED ? 512 : 64)
 #define CFG_TUD_MIDI_TX_BUFSIZE (TUD_OPT_HIGH_SPEED ? 512 : 64)
 
+// Vendor FIFO size of TX and RX, TX is large enough to absorb a few ms of raw sensor frames
+#define CFG_TUD_VENDOR_RX_BUFSIZE (TUD_OPT_HIGH_SPEED ? 512 : 64)
+#define CFG_TUD_VENDOR_TX_BUFSIZE 4096
+
 #ifdef __cplusplus
 }
 #endif
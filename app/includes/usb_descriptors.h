@@ -34,4 +34,13 @@ enum
     REPORT_ID_COUNT
 };
 
+// Virtual MIDI cables exposed on the MIDI streaming interface, in output priority order
+enum
+{
+    MIDI_CABLE_NOTES = 0,
+    MIDI_CABLE_CONTROLLERS,
+    MIDI_CABLE_DIAGNOSTICS,
+    MIDI_CABLE_COUNT
+};
+
 #endif /* USB_DESCRIPTORS_H_ */
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// USB-MIDI 1.0 event packets: the cable number and code index number (CIN) in the first byte, then up to three MIDI
+// bytes padded with zeros
+namespace usb_midi_packet
+{
+constexpr size_t kSize = 4;
+
+constexpr size_t sysex_packet_count(size_t size)
+{
+    return (size + 2) / 3;
+}
+
+// Packet of a 2 or 3 byte channel voice message, whose CIN is the status high nibble
+inline void encode_channel(uint8_t cable, const uint8_t* msg, size_t size, uint8_t* packet)
+{
+    packet[0] = static_cast<uint8_t>((cable << 4) | (msg[0] >> 4));
+    packet[1] = msg[0];
+    packet[2] = msg[1];
+    packet[3] = size > 2 ? msg[2] : 0;
+}
+
+// Splits a complete SysEx message, F0 and F7 included, into sysex_packet_count(size) packets handed to emit in order
+template <typename Emit>
+inline void encode_sysex(uint8_t cable, const uint8_t* msg, size_t size, Emit&& emit)
+{
+    uint8_t packet[kSize];
+    const uint8_t header = static_cast<uint8_t>(cable << 4);
+
+    size_t i = 0;
+    for (; size - i > 3; i += 3)
+    {
+        packet[0] = header | 0x4; // SysEx starts or continues
+        packet[1] = msg[i];
+        packet[2] = msg[i + 1];
+        packet[3] = msg[i + 2];
+        emit(packet);
+    }
+
+    // SysEx ends with one, two or three bytes
+    const size_t left = size - i;
+    packet[0] = static_cast<uint8_t>(header | (0x4 + left));
+    packet[1] = msg[i];
+    packet[2] = left > 1 ? msg[i + 1] : 0;
+    packet[3] = left > 2 ? msg[i + 2] : 0;
+    emit(packet);
+}
+} // namespace usb_midi_packet
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LED visualizer driven by the sensor snapshot: ripples spreading from the estimated strike position, a glow following
+// the Hall displacement and per-pad pressure. It runs in the LED task on core 1 and only reads the snapshot, so it adds
+// nothing to the MIDI path on core 0. Toggled with the sysex::Visualizer command (payload: 0 = off, 1 = on).
+namespace visualizer
+{
+void init();
+
+bool enabled();
+void set_enabled(bool enabled);
+
+// Draws the effects over colors[0, count), which holds the regular pixel colors on entry. LED task only.
+void render(uint32_t now_us, uint32_t* colors, size_t count);
+} // namespace visualizer
@@ -54,6 +54,15 @@
 #define VL6180X_ERROR_RANGEUFLOW  14 ///< Raw range algo underflow
 #define VL6180X_ERROR_RANGEOFLOW  15 ///< Raw range algo overflow
 
+struct Vl6180Sample
+{
+    uint8_t range_mm; // unfiltered range of the last successful measurement
+    uint8_t status;   // VL6180X_ERROR_* code of the last measurement
+};
+
 bool init_vl6180x();
 
-float vl6180_read();
\ No newline at end of file
+// Takes a measurement. Returns false if none could be made, vl6180_last_sample() then still holds the previous one.
+bool vl6180_read();
+
+Vl6180Sample vl6180_last_sample();
\ No newline at end of file
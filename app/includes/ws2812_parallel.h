@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "hardware/pio.h"
+
+// Drives up to kMaxStrips WS2812 strips in lockstep from a single state machine running the ws2812_parallel program.
+// Strip n is wired to pin_base + n. Each frame is bit-plane transposed so one 32-bit FIFO word carries the same bit of
+// every strip, which keeps the refresh time equal to that of a single strip no matter how many strips are used.
+// The transfer is done by DMA from a separate plane buffer, pixels can be set while the previous frame is on the wire.
+namespace ws2812_parallel
+{
+constexpr uint32_t kMaxStrips = 8;
+constexpr uint32_t kMaxPixelsPerStrip = 32;
+
+bool init(PIO pio, uint32_t pin_base, uint32_t strip_count, uint32_t pixels_per_strip);
+
+uint32_t strip_count();
+uint32_t pixels_per_strip();
+
+// Sets a pixel of the next frame. Colors are GRB.
+void set_pixel(uint32_t strip, uint32_t index, uint32_t grb);
+
+// True until the previous frame has been sent and the strips latched it
+bool busy();
+
+// Transposes the next frame and starts sending it. The caller must check busy() first.
+void show();
+} // namespace ws2812_parallel
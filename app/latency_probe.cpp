@@ -0,0 +1,78 @@
+#include "latency_probe.h"
+
+#include <atomic>
+
+#include "hal.h"
+#include "logging.h"
+#include "midi_scheduler.h"
+#include "sysex.h"
+
+namespace
+{
+std::atomic<bool> g_enabled{false};
+
+void handle_latency_mode(const uint8_t* payload, size_t size)
+{
+    if (size < 1)
+    {
+        return;
+    }
+
+    bool enabled = payload[0] != 0;
+    if (g_enabled.exchange(enabled, std::memory_order_relaxed) != enabled)
+    {
+        LOG_INFO("Latency measurement %s\n", enabled ? "enabled" : "disabled");
+    }
+}
+
+void handle_ping(const uint8_t* payload, size_t size)
+{
+    // Sampled before anything else so the reply describes when the request was seen
+    uint32_t now = hal::time_us();
+    if (size < latency_probe::kPingRequestSize)
+    {
+        return;
+    }
+
+    uint8_t reply[latency_probe::kPingReplySize];
+    for (size_t i = 0; i < latency_probe::kPingRequestSize; ++i)
+    {
+        reply[i] = payload[i] & 0x7F;
+    }
+    uint8_t* out = sysex::encode_u32(now, reply + latency_probe::kPingRequestSize);
+    sysex::encode_u32(midi_scheduler::min_release_latency_us(), out);
+    sysex::send(sysex::Ping, reply, sizeof(reply));
+}
+} // namespace
+
+namespace latency_probe
+{
+
+void init()
+{
+    sysex::register_handler(sysex::LatencyMode, handle_latency_mode);
+    sysex::register_handler(sysex::Ping, handle_ping);
+}
+
+bool enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void echo(uint32_t capture_time_us, uint8_t cable, const uint8_t* msg, size_t size)
+{
+    uint8_t type = msg[0] & 0xF0;
+    if (!enabled() || size < 2 || (type != 0x80 && type != 0x90))
+    {
+        return;
+    }
+
+    uint8_t payload[kEchoPayloadSize];
+    payload[0] = (msg[0] >> 4) & 0x07;
+    payload[1] = msg[0] & 0x0F;
+    payload[2] = msg[1] & 0x7F;
+    sysex::encode_u32(capture_time_us, payload + 3);
+    sysex::send(sysex::TimestampEcho, payload, sizeof(payload), cable, capture_time_us);
+}
+
+} // namespace latency_probe
@@ -0,0 +1,117 @@
+#include "led_animation.h"
+
+namespace led_animation
+{
+
+namespace
+{
+
+// Level of a triangle wave rising over the first half of the cycle and falling over the second one
+uint8_t triangle(uint32_t phase, uint32_t period)
+{
+    uint32_t half = period / 2;
+    if (half == 0)
+    {
+        return kMaxLevel;
+    }
+
+    uint32_t distance = phase < half ? phase : period - phase;
+    if (distance >= half)
+    {
+        return kMaxLevel;
+    }
+    return static_cast<uint8_t>((static_cast<uint64_t>(distance) * kMaxLevel) / half);
+}
+
+uint8_t scale_level(uint8_t level, uint32_t numerator, uint32_t denominator)
+{
+    return static_cast<uint8_t>((static_cast<uint64_t>(level) * numerator) / denominator);
+}
+
+// Returns the phase within the current cycle, or false once every cycle has been shown
+bool cycle_phase(Animation& animation, uint32_t elapsed, uint32_t* phase)
+{
+    uint32_t cycles = elapsed / animation.period_us;
+    if (animation.repeat >= 0 && cycles >= static_cast<uint32_t>(animation.repeat))
+    {
+        return false;
+    }
+
+    if (animation.repeat < 0 && cycles > 0)
+    {
+        animation.start_us += cycles * animation.period_us;
+    }
+    *phase = elapsed % animation.period_us;
+    return true;
+}
+
+} // namespace
+
+uint32_t scale_color(uint32_t grb, uint8_t level)
+{
+    uint32_t gain = kGammaTable[level];
+    if (gain == kMaxLevel)
+    {
+        return grb;
+    }
+
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+    {
+        uint32_t channel = (grb >> shift) & 0xFF;
+        result |= ((channel * gain + 127) / 255) << shift;
+    }
+    return result;
+}
+
+uint32_t evaluate(Animation& animation, uint32_t now_us, bool* done)
+{
+    *done = false;
+    uint32_t elapsed = now_us - animation.start_us;
+
+    if (animation.type == AnimationType::Solid || animation.period_us == 0)
+    {
+        return scale_color(animation.color, animation.level);
+    }
+
+    uint32_t phase = 0;
+    switch (animation.type)
+    {
+    case AnimationType::Blink:
+        if (!cycle_phase(animation, elapsed, &phase))
+        {
+            break;
+        }
+        return phase < animation.period_us / 2 ? scale_color(animation.color, animation.level) : 0;
+    case AnimationType::Pulse:
+        if (!cycle_phase(animation, elapsed, &phase))
+        {
+            break;
+        }
+        return scale_color(animation.color, scale_level(animation.level, triangle(phase, animation.period_us), 255));
+    case AnimationType::Fade:
+        if (elapsed >= animation.period_us)
+        {
+            break;
+        }
+        return scale_color(animation.color,
+                           scale_level(animation.level, animation.period_us - elapsed, animation.period_us));
+    case AnimationType::Flash:
+    {
+        if (elapsed >= animation.period_us)
+        {
+            break;
+        }
+        // Instant attack and quadratic decay, reads as a strike rather than a fade
+        uint8_t remaining = scale_level(kMaxLevel, animation.period_us - elapsed, animation.period_us);
+        return scale_color(animation.color, scale_level(animation.level, remaining * remaining, 255 * 255));
+    }
+    default:
+        return scale_color(animation.color, animation.level);
+    }
+
+    *done = true;
+    return 0;
+}
+
+} // namespace led_animation
@@ -1,35 +1,95 @@
 #include "pico/stdlib.h"
 #include "pico/time.h"
 
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pio.h"
 #include "ws2812.pio.h"
 
+#include <atomic>
+
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include "cap_touch.h"
+#include "led_animation.h"
 #include "leds.h"
 #include "logging.h"
+#include "mpsc_ring.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "visualizer.h"
+#include "ws2812_parallel.h"
 
 #define WS2812_PIN 15
 #define IS_RGBW    false
 #define NUM_PIXELS 8
 
+// Number of strips of NUM_PIXELS driven in lockstep. With more than one strip the ws2812_parallel program is used on
+// consecutive pins from WS2812_PARALLEL_BASE_PIN instead of WS2812_PIN, GPIO 6 to 13 being free on the board, and
+// pixels are numbered strip by strip, the status pixels being on the first strip.
+#define WS2812_STRIP_COUNT         1
+#define WS2812_PARALLEL_BASE_PIN   6
+#define TOTAL_PIXELS               (NUM_PIXELS * WS2812_STRIP_COUNT)
+
+static_assert(WS2812_STRIP_COUNT == 1 || WS2812_PARALLEL_BASE_PIN + WS2812_STRIP_COUNT <= kCapTouchFirstGpio ||
+                  WS2812_PARALLEL_BASE_PIN >= kCapTouchFirstGpio + kCapTouchGpioCount,
+              "LED strips overlap the cap-touch pins");
+
+// The status pixels are left alone by the visualizer, it draws from the first pad pixel to the end of the strips
+#define FIRST_VISUAL_PIXEL Pixels::Pixel_3
+
 namespace
 {
 
+// Every pixel shows its base color unless an animation is running on top of it. Once a finite animation is done the
+// pixel falls back to its base color.
 struct PixelState
 {
-    uint32_t color = 0;
-    bool is_blinking = false;
-    bool blink_state = false;
-    int repeat = 0;
-    uint32_t period = 0;
+    uint32_t base = 0;
+    Animation animation = {};
+    bool animating = false;
+};
 
-    uint32_t _phase = 0;
+// Pixel state is owned by the LED task. Other tasks post commands to g_led_commands, which the LED task applies at the
+// start of every frame, so several updates of the same pixel within a frame coalesce into the last one.
+// Animations are stamped with the time they were posted, not the time the LED task picks them up.
+struct LedCommand
+{
+    Animation animation;
+    uint16_t pixel;
+    bool overlay;
 };
 
-PixelState g_pixels[NUM_PIXELS] = {0};
+constexpr size_t kLedCommandRingSize = 64;
+
+PixelState g_pixels[TOTAL_PIXELS] = {};
+uint32_t g_shown[TOTAL_PIXELS] = {0};
+uint32_t g_num_animating = 0;
+bool g_dirty = false;
+bool g_visualized = false;
 TaskHandle_t g_led_task_handle;
+MpscRing<LedCommand, kLedCommandRingSize> g_led_commands;
+std::atomic<uint32_t> g_dropped_commands{0};
+
+PIO g_pio = pio0;
+
+#if WS2812_STRIP_COUNT == 1
+// The strip is fed by DMA from one of two frame buffers so a frame can be composed while the previous one is sent.
+// After the DMA completes the PIO FIFO still holds up to 8 pixels and the strip needs a low period to latch, the
+// transfer is only considered done once kResetTimeUs has elapsed.
+constexpr uint32_t kResetTimeUs = 400;
+
+uint g_sm = 0;
+int g_dma_channel = -1;
+uint32_t g_frames[2][NUM_PIXELS] = {0};
+uint8_t g_back_frame = 0;
+std::atomic<bool> g_transfer_busy{false};
+
+// Set when no alarm was free to end the reset time, transfer_busy() then checks it against the DMA completion time
+std::atomic<bool> g_reset_unscheduled{false};
+uint32_t g_dma_complete_us = 0;
+#endif
 
 } // namespace
 
@@ -39,69 +99,162 @@ void pico_set_led(bool led_on)
     gpio_put(PICO_DEFAULT_LED_PIN, led_on);
 }
 
-static inline void put_pixel(uint32_t pixel_grb)
+#if WS2812_STRIP_COUNT == 1
+int64_t reset_complete(alarm_id_t id, void* user_data)
+{
+    (void)id;
+    (void)user_data;
+    trace::isr_enter(trace::Isr::LedResetAlarm);
+    g_transfer_busy.store(false, std::memory_order_release);
+    trace::isr_exit(trace::Isr::LedResetAlarm);
+    return 0;
+}
+
+void __isr dma_complete_handler()
+{
+    if (g_dma_channel < 0 || !dma_channel_get_irq0_status(g_dma_channel))
+    {
+        return;
+    }
+
+    trace::isr_enter(trace::Isr::LedDma);
+    dma_channel_acknowledge_irq0(g_dma_channel);
+    if (add_alarm_in_us(kResetTimeUs, reset_complete, nullptr, true) < 0)
+    {
+        g_dma_complete_us = time_us_32();
+        g_reset_unscheduled.store(true, std::memory_order_release);
+    }
+    trace::isr_exit(trace::Isr::LedDma);
+}
+
+void init_output()
+{
+    uint offset = pio_add_program(g_pio, &ws2812_program);
+    ws2812_program_init(g_pio, g_sm, offset, WS2812_PIN, 800000, IS_RGBW);
+
+    g_dma_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(g_dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, pio_get_dreq(g_pio, g_sm, true));
+    dma_channel_configure(g_dma_channel, &config, &g_pio->txf[g_sm], nullptr, NUM_PIXELS, false);
+
+    irq_add_shared_handler(DMA_IRQ_0, dma_complete_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq0_enabled(g_dma_channel, true);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+bool transfer_busy()
+{
+    if (!g_transfer_busy.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    if (g_reset_unscheduled.load(std::memory_order_acquire) && time_us_32() - g_dma_complete_us >= kResetTimeUs)
+    {
+        g_reset_unscheduled.store(false, std::memory_order_relaxed);
+        g_transfer_busy.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// Starts sending the back frame and swaps buffers. The caller must check transfer_busy() first.
+void show_frame()
+{
+    trace::ScopedSpan span(trace::Span::ShowFrame);
+    g_transfer_busy.store(true, std::memory_order_relaxed);
+    uint32_t* frame = g_frames[g_back_frame];
+    g_back_frame ^= 1;
+    dma_channel_transfer_from_buffer_now(g_dma_channel, frame, NUM_PIXELS);
+}
+
+static inline void put_pixel(uint index, uint32_t pixel_grb)
+{
+    g_frames[g_back_frame][index] = pixel_grb << 8u;
+}
+#else
+void init_output()
+{
+    ws2812_parallel::init(g_pio, WS2812_PARALLEL_BASE_PIN, WS2812_STRIP_COUNT, NUM_PIXELS);
+}
+
+bool transfer_busy()
 {
-    pio_sm_put_blocking(pio0, 0, pixel_grb << 8u);
+    return ws2812_parallel::busy();
 }
 
-static inline void put_pixels(PixelState* pixels, uint num_pixels)
+void show_frame()
 {
-    for (uint i = 0; i < num_pixels; ++i)
+    trace::ScopedSpan span(trace::Span::ShowFrame);
+    ws2812_parallel::show();
+}
+
+static inline void put_pixel(uint index, uint32_t pixel_grb)
+{
+    ws2812_parallel::set_pixel(index / NUM_PIXELS, index % NUM_PIXELS, pixel_grb);
+}
+#endif
+
+// Evaluates every pixel at now_us into colors. Returns true if any pixel differs from what the strip currently shows.
+bool render(uint32_t now_us, uint32_t* colors, bool visualize)
+{
+    for (uint i = 0; i < TOTAL_PIXELS; ++i)
     {
-        PixelState& pixel = pixels[i];
-        if (pixel.is_blinking)
+        PixelState& pixel = g_pixels[i];
+        colors[i] = pixel.base;
+        if (pixel.animating)
         {
-            if (pixel._phase == 0)
-            {
-                pixel.blink_state = !pixel.blink_state;
-            }
-            if (pixel.blink_state)
+            bool done = false;
+            uint32_t color = led_animation::evaluate(pixel.animation, now_us, &done);
+            if (done)
             {
-                put_pixel(pixel.color);
+                pixel.animating = false;
+                --g_num_animating;
             }
             else
             {
-                put_pixel(0);
-            }
-            pixel._phase = (pixel._phase + 1) % pixel.period;
-
-            if (pixel._phase == 0)
-            {
-                if (pixel.repeat > 0)
-                {
-                    --pixel.repeat;
-                }
-                else if (pixel.repeat == 0)
-                {
-                    pixel.color = 0;
-                    pixel.is_blinking = false;
-                    pixel.blink_state = false;
-                    pixel._phase = 0;
-                }
+                colors[i] = color;
             }
         }
-        else
-        {
-            put_pixel(pixel.color);
-        }
     }
-    sleep_ms(1);
+
+    if (visualize)
+    {
+        visualizer::render(now_us, colors + FIRST_VISUAL_PIXEL, TOTAL_PIXELS - FIRST_VISUAL_PIXEL);
+    }
+
+    bool changed = false;
+    for (uint i = 0; i < TOTAL_PIXELS; ++i)
+    {
+        changed |= colors[i] != g_shown[i];
+    }
+    return changed;
 }
 
 void pattern_snakes(uint len, uint t)
 {
+    if (transfer_busy())
+    {
+        return;
+    }
+
     for (uint i = 0; i < len; ++i)
     {
         uint x = (i + (t >> 1)) % 64;
         if (x < 10)
-            put_pixel(urgb_to_u32(0xff, 0, 0));
+            put_pixel(i, urgb_to_u32(0xff, 0, 0));
         else if (x >= 15 && x < 25)
-            put_pixel(urgb_to_u32(0, 0xff, 0));
+            put_pixel(i, urgb_to_u32(0, 0xff, 0));
         else if (x >= 30 && x < 40)
-            put_pixel(urgb_to_u32(0, 0, 0xff));
+            put_pixel(i, urgb_to_u32(0, 0, 0xff));
         else
-            put_pixel(0);
+            put_pixel(i, 0);
     }
+    show_frame();
 }
 
 uint32_t urgb_to_u32(uint8_t r, uint8_t g, uint8_t b)
@@ -109,46 +262,133 @@ uint32_t urgb_to_u32(uint8_t r, uint8_t g, uint8_t b)
     return ((uint32_t)(r) << 8) | ((uint32_t)(g) << 16) | (uint32_t)(b);
 }
 
+void post_command(const LedCommand& command)
+{
+    if (!g_led_commands.push(command))
+    {
+        g_dropped_commands.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::LedCommandDropped);
+    }
+}
+
+// Applies every pending command. LED task only.
+void apply_commands()
+{
+    LedCommand command;
+    while (g_led_commands.pop(&command))
+    {
+        if (command.pixel >= TOTAL_PIXELS)
+        {
+            continue;
+        }
+
+        PixelState& pixel = g_pixels[command.pixel];
+        if (command.overlay)
+        {
+            g_num_animating += pixel.animating ? 0 : 1;
+            pixel.animation = command.animation;
+            pixel.animating = true;
+        }
+        else
+        {
+            // A new base color cancels whatever was animating on the pixel
+            g_num_animating -= pixel.animating ? 1 : 0;
+            pixel.base = command.animation.color;
+            pixel.animating = false;
+        }
+        g_dirty = true;
+    }
+}
+
 void all_off()
 {
-    for (uint i = 0; i < NUM_PIXELS; ++i)
+    while (transfer_busy())
+    {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    for (uint i = 0; i < TOTAL_PIXELS; ++i)
     {
-        put_pixel(0);
+        put_pixel(i, 0);
+        g_shown[i] = 0;
     }
-    // sleep_ms(1);
-    vTaskDelay(pdMS_TO_TICKS(1));
+    show_frame();
 }
 
 void update_leds()
 {
-    put_pixels(g_pixels, NUM_PIXELS);
-    vTaskDelay(pdMS_TO_TICKS(1));
+    // Skip the update while the previous frame is still on the wire, commands stay queued for the next one
+    if (transfer_busy())
+    {
+        return;
+    }
+    apply_commands();
+
+    // Nothing changed and nothing animating: the strip already shows the right frame. One more frame is rendered after
+    // the visualizer is turned off to restore the pixels it covered.
+    bool visualize = visualizer::enabled();
+    if (!g_dirty && g_num_animating == 0 && !visualize && !g_visualized)
+    {
+        return;
+    }
+    g_dirty = false;
+    g_visualized = visualize;
+
+    uint32_t colors[TOTAL_PIXELS];
+    if (!render(time_us_32(), colors, visualize))
+    {
+        return;
+    }
+
+    for (uint i = 0; i < TOTAL_PIXELS; ++i)
+    {
+        put_pixel(i, colors[i]);
+        g_shown[i] = colors[i];
+    }
+    show_frame();
+}
+
+void post_animation(Pixels pixel, AnimationType type, uint32_t color, uint8_t level, uint32_t period_ms, int repeat)
+{
+    Animation animation = {type, level, static_cast<int16_t>(repeat), color, time_us_32(), period_ms * 1000};
+    post_command({animation, static_cast<uint16_t>(pixel), true});
 }
 
 void set_led(Pixels pixel, uint32_t color)
 {
-    g_pixels[static_cast<uint32_t>(pixel)].color = color;
-    g_pixels[static_cast<uint32_t>(pixel)].is_blinking = false;
-    g_pixels[static_cast<uint32_t>(pixel)].blink_state = false;
-    g_pixels[static_cast<uint32_t>(pixel)].period = 0;
-    g_pixels[static_cast<uint32_t>(pixel)].repeat = 0;
-    g_pixels[static_cast<uint32_t>(pixel)]._phase = 0;
-    xTaskNotifyGive(g_led_task_handle);
+    Animation animation = {AnimationType::Solid, led_animation::kMaxLevel, 0, color, 0, 0};
+    post_command({animation, static_cast<uint16_t>(pixel), false});
 }
 
-void set_led_blinking(Pixels pixel, uint32_t color, uint32_t period, int repeat)
+void fade_led(Pixels pixel, uint32_t color, uint32_t duration_ms)
 {
-    g_pixels[static_cast<uint32_t>(pixel)].color = color;
-    g_pixels[static_cast<uint32_t>(pixel)].is_blinking = true;
-    g_pixels[static_cast<uint32_t>(pixel)].blink_state = false;
-    g_pixels[static_cast<uint32_t>(pixel)].period = period;
-    g_pixels[static_cast<uint32_t>(pixel)].repeat = repeat;
-    g_pixels[static_cast<uint32_t>(pixel)]._phase = 0;
-    xTaskNotifyGive(g_led_task_handle);
+    post_animation(pixel, AnimationType::Fade, color, led_animation::kMaxLevel, duration_ms, 0);
+}
+
+void pulse_led(Pixels pixel, uint32_t color, uint32_t period_ms, int repeat)
+{
+    post_animation(pixel, AnimationType::Pulse, color, led_animation::kMaxLevel, period_ms, repeat);
+}
+
+void flash_led(Pixels pixel, uint32_t color, uint8_t velocity, uint32_t duration_ms)
+{
+    post_animation(pixel, AnimationType::Flash, color, led_animation::kVelocityLevel[velocity & 0x7F], duration_ms, 0);
+}
+
+Pixels strip_pixel(uint32_t strip, uint32_t index)
+{
+    return static_cast<Pixels>(strip * NUM_PIXELS + index);
+}
+
+uint32_t led_dropped_commands()
+{
+    return g_dropped_commands.load(std::memory_order_relaxed);
 }
 
 void start_led_task()
 {
+    visualizer::init();
+
     auto result = xTaskCreate(led_task, "LedTask", LED_TASK_STACK_SIZE, NULL, LED_TASK_PRIORITY, &g_led_task_handle);
     LOG_INFO("Led task created\n");
     vTaskCoreAffinitySet(g_led_task_handle, (1 << 1));
@@ -171,25 +411,22 @@ void led_task(void* params)
         LOG_INFO("led task is on core %d\n", last_core_id);
     }
 
-    PIO pio = pio0;
-    int sm = 0;
-    uint offset = pio_add_program(pio, &ws2812_program);
-
-    ws2812_program_init(pio, sm, offset, WS2812_PIN, 800000, IS_RGBW);
+    init_output();
 
     // Show led pattern to show that we are booted and ready
     for (auto t = 0; t < 81; ++t)
     {
-        pattern_snakes(NUM_PIXELS, t);
-        sleep_ms(10);
+        pattern_snakes(TOTAL_PIXELS, t);
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
 
     all_off();
 
     const TickType_t xFrequency = pdMS_TO_TICKS(5);
+    TickType_t last_wake = xTaskGetTickCount();
     while (true)
     {
-        ulTaskNotifyTake(pdTRUE, xFrequency);
+        vTaskDelayUntil(&last_wake, xFrequency);
         update_leds();
     }
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "logging.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+namespace
+{
+class ArgReader
+{
+  public:
+    explicit ArgReader(const logger::detail::ArgBuffer& args) : args_(args), position_(0)
+    {
+    }
+
+    // Fails past the recorded arguments, a format string asking for more than was recorded cannot crash
+    template <typename T>
+    bool read(T* value)
+    {
+        if (position_ + sizeof(T) > args_.size)
+        {
+            position_ = args_.size;
+            return false;
+        }
+        memcpy(value, args_.data + position_, sizeof(T));
+        position_ += sizeof(T);
+        return true;
+    }
+
+  private:
+    const logger::detail::ArgBuffer& args_;
+    size_t position_;
+};
+
+enum class LengthModifier
+{
+    None,
+    Long,
+    LongLong,
+    Size
+};
+
+constexpr const char* kMissingArg = "?";
+
+template <typename T>
+int format_arg(char* out, size_t size, const char* spec, ArgReader& reader)
+{
+    T value;
+    if (!reader.read(&value))
+    {
+        return snprintf(out, size, "%s", kMissingArg);
+    }
+    return snprintf(out, size, spec, value);
+}
+
+template <typename Signed, typename Unsigned>
+int format_integer(char* out, size_t size, const char* spec, char conversion, ArgReader& reader)
+{
+    if (conversion == 'd' || conversion == 'i')
+    {
+        return format_arg<Signed>(out, size, spec, reader);
+    }
+    return format_arg<Unsigned>(out, size, spec, reader);
+}
+
+} // namespace
+
+namespace logger
+{
+namespace detail
+{
+// Walks the format string and hands every conversion to snprintf on its own, with its argument read back at the size
+// it was recorded with
+void format(const char* fmt, const ArgBuffer& args, char* out, size_t size)
+{
+    ArgReader reader(args);
+    const char* p = fmt;
+    size_t length = 0;
+
+    while (*p != '\0' && length + 1 < size)
+    {
+        if (*p != '%')
+        {
+            out[length++] = *p++;
+            continue;
+        }
+
+        const char* start = p++;
+        if (*p == '%')
+        {
+            out[length++] = '%';
+            ++p;
+            continue;
+        }
+
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+        {
+            ++p;
+        }
+        while (isdigit(static_cast<unsigned char>(*p)))
+        {
+            ++p;
+        }
+        if (*p == '.')
+        {
+            ++p;
+            while (isdigit(static_cast<unsigned char>(*p)))
+            {
+                ++p;
+            }
+        }
+
+        LengthModifier modifier = LengthModifier::None;
+        while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'j' || *p == 't')
+        {
+            if (*p == 'l')
+            {
+                modifier = modifier == LengthModifier::Long ? LengthModifier::LongLong : LengthModifier::Long;
+            }
+            else if (*p != 'h')
+            {
+                modifier = LengthModifier::Size;
+            }
+            ++p;
+        }
+
+        char conversion = *p;
+        if (conversion == '\0')
+        {
+            break;
+        }
+        ++p;
+
+        char spec[16];
+        size_t spec_size = p - start;
+        if (spec_size >= sizeof(spec))
+        {
+            break;
+        }
+        memcpy(spec, start, spec_size);
+        spec[spec_size] = '\0';
+
+        char* dst = out + length;
+        size_t available = size - length;
+        int written = 0;
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            if (modifier == LengthModifier::LongLong)
+            {
+                written = format_integer<long long, unsigned long long>(dst, available, spec, conversion, reader);
+            }
+            else if (modifier == LengthModifier::Long)
+            {
+                written = format_integer<long, unsigned long>(dst, available, spec, conversion, reader);
+            }
+            else if (modifier == LengthModifier::Size)
+            {
+                written = format_integer<ptrdiff_t, size_t>(dst, available, spec, conversion, reader);
+            }
+            else
+            {
+                written = format_integer<int, unsigned>(dst, available, spec, conversion, reader);
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            written = format_arg<double>(dst, available, spec, reader);
+            break;
+        case 's':
+        {
+            const char* str = kMissingArg;
+            reader.read(&str);
+            written = snprintf(dst, available, spec, str != nullptr ? str : "(null)");
+            break;
+        }
+        case 'p':
+            written = format_arg<const void*>(dst, available, spec, reader);
+            break;
+        default:
+            break;
+        }
+
+        if (written > 0)
+        {
+            length += static_cast<size_t>(written) < available ? written : available - 1;
+        }
+    }
+
+    out[length] = '\0';
+}
+} // namespace detail
+} // namespace logger
@@ -1,47 +1,140 @@
 #include "logging.h"
 
-#include <stdarg.h>
 #include <stdio.h>
 
+#include <atomic>
+
 #include "FreeRTOS.h"
-#include "semphr.h"
+#include "task.h"
+
+#include "hal.h"
+#include "mpsc_ring.h"
+#include "telemetry.h"
+
+#define LOG_TASK_PRIORITY   (tskIDLE_PRIORITY + 1UL)
+#define LOG_TASK_STACK_SIZE 1024
 
 namespace
 {
-constexpr const char* log_fmt_string = "[%s][%s] ";
+constexpr const char* log_fmt_string = "[%lu.%06lu][%s][%s] %s";
 constexpr const char* log_level_strings[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
 
-SemaphoreHandle_t xSemaphore;
+constexpr size_t kRingSize = 64;
+constexpr TickType_t kIdleDelay = pdMS_TO_TICKS(10);
+
+struct LogRecord
+{
+    uint32_t timestamp_us;
+    const char* filename;
+    const char* fmt;
+    LogLevel level;
+    logger::detail::ArgBuffer args;
+};
+
+// One ring per core so both cores can log without contending on the same enqueue index
+MpscRing<LogRecord, kRingSize> g_rings[configNUMBER_OF_CORES];
+std::atomic<uint32_t> g_dropped{0};
+TaskHandle_t g_log_task_handle;
+
+void print_record(const LogRecord& record)
+{
+    char message[MAX_LOG_MESSAGE_SIZE];
+    logger::detail::format(record.fmt, record.args, message, sizeof(message));
+    printf(log_fmt_string, static_cast<unsigned long>(record.timestamp_us / 1000000),
+           static_cast<unsigned long>(record.timestamp_us % 1000000), log_level_strings[static_cast<int>(record.level)],
+           record.filename, message);
+}
+
+// Prints every pending record, oldest first across the cores. Returns false if there was nothing to print.
+bool drain()
+{
+    LogRecord pending[configNUMBER_OF_CORES];
+    bool has_pending[configNUMBER_OF_CORES] = {false};
+    bool printed = false;
+
+    while (true)
+    {
+        int oldest = -1;
+        for (int core = 0; core < configNUMBER_OF_CORES; ++core)
+        {
+            if (!has_pending[core])
+            {
+                has_pending[core] = g_rings[core].pop(&pending[core]);
+            }
+            if (has_pending[core] &&
+                (oldest < 0 ||
+                 static_cast<int32_t>(pending[core].timestamp_us - pending[oldest].timestamp_us) < 0))
+            {
+                oldest = core;
+            }
+        }
+
+        if (oldest < 0)
+        {
+            return printed;
+        }
+
+        print_record(pending[oldest]);
+        has_pending[oldest] = false;
+        printed = true;
+    }
+}
+
+void log_task(void* params)
+{
+    (void)params;
+    uint32_t reported_drops = 0;
+
+    while (true)
+    {
+        if (!drain())
+        {
+            vTaskDelay(kIdleDelay);
+        }
+
+        uint32_t dropped = g_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_drops)
+        {
+            printf("[WARNING][logging.cpp] %lu log records dropped\n",
+                   static_cast<unsigned long>(dropped - reported_drops));
+            reported_drops = dropped;
+        }
+    }
+}
 } // namespace
 
 namespace logger
 {
 void init_logging()
 {
-    xSemaphore = xSemaphoreCreateMutex();
     printf("%c%c%c%c", 0x1B, 0x5B, 0x32, 0x4A);
     printf("%c[0;0H", 0x1b);
-}
 
-void log(LogLevel level, const char* filename, const char* fmt, ...)
-{
-    char buffer[MAX_LOG_MESSAGE_SIZE] = {0};
-    int written =
-        snprintf(buffer, MAX_LOG_MESSAGE_SIZE, log_fmt_string, log_level_strings[static_cast<int>(level)], filename);
-
-    if (written < 0 || written >= MAX_LOG_MESSAGE_SIZE)
+    auto result =
+        xTaskCreate(log_task, "LogTask", LOG_TASK_STACK_SIZE, nullptr, LOG_TASK_PRIORITY, &g_log_task_handle);
+    if (result != pdPASS)
     {
-        printf("Failed to write log message\n");
-        return;
+        printf("Failed to create log task\n");
     }
+}
 
-    char* buffer_ptr = buffer + written;
+uint32_t dropped_records()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
 
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(buffer_ptr, MAX_LOG_MESSAGE_SIZE - written, fmt, args);
-    va_end(args);
+namespace detail
+{
+void push(LogLevel level, const char* filename, const char* fmt, const ArgBuffer& args)
+{
+    LogRecord record = {hal::time_us(), filename, fmt, level, args};
 
-    printf(buffer);
+    // The task may move to the other core before the push, which only costs a little contention on that core's ring
+    if (!g_rings[portGET_CORE_ID()].push(record))
+    {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::LogRecordDropped);
+    }
 }
-} // namespace logger
\ No newline at end of file
+} // namespace detail
+} // namespace logger
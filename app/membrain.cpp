@@ -18,6 +18,8 @@
 #include "leds.h"
 #include "logging.h"
 #include "midi_controller.h"
+#include "midi_scheduler.h"
+#include "trace.h"
 #include "vl6180.h"
 
 #define MAIN_TASK_PRIORITY   (tskIDLE_PRIORITY + 2UL)
@@ -57,6 +59,7 @@ void vLaunch(void)
 #endif
 
     tusb_init();
+    midi_scheduler::init();
 
     adc_init();
 
@@ -74,6 +77,7 @@ int main()
     // busy loop for 1ms
 
     // sleep_ms(1);
+    trace::init();
     stdio_init_all();
     logger::init_logging();
 
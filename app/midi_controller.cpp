@@ -1,228 +1,888 @@
 #include "midi_controller.h"
 
-#include "hardware/adc.h"
-#include "pico/stdlib.h"
-#include "pico/time.h"
-
 #include "FreeRTOS.h"
 #include "task.h"
-#include "tusb.h"
 
 #include <algorithm>
+#include <cassert>
 
 #include "cap_touch.h"
+#include "hal.h"
+#include "latency_probe.h"
 #include "leds.h"
 #include "logging.h"
+#include "midi_mapping.h"
+#include "midi_scheduler.h"
+#include "mpe.h"
+#include "noise_floor.h"
 #include "piezo_trigger.h"
+#include "profiler.h"
+#include "sensor_math.h"
+#include "sensor_pipeline.h"
+#include "sensor_snapshot.h"
+#include "sensor_stream.h"
+#include "sysex.h"
+#include "task_stats.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "usb_descriptors.h"
 #include "vl6180.h"
 
 namespace
 {
 TaskHandle_t g_midi_task_handle;
 
-struct NoteTrigger
+// What a momentary source actually sent when it was activated. The release uses this instead of the mapping table so
+// that swapping tables while a pad is held never leaves a hanging note.
+struct ActiveOutput
 {
-    CapPin pin;
-    uint8_t note;
-    uint8_t velocity;
-    bool state;
-    Pixels led;
+    MappingType type;
+    uint8_t channel;
+    uint8_t number;
+    bool mpe;
 };
 
 // Constants
 constexpr size_t kNumTouchPins = 4;
-constexpr uint8_t g_touchGpios[kNumTouchPins] = {16, 17, 18, 19};
+static_assert(kNumTouchPins == kCapTouchGpioCount, "One touch pin per pad");
 constexpr Pixels g_touchPixels[kNumTouchPins] = {Pixels::Pixel_3, Pixels::Pixel_4, Pixels::Pixel_5, Pixels::Pixel_6};
-constexpr uint8_t kStartNote = 37;
-
-constexpr float kHallA1 = 0.80;
-constexpr float kHallB0 = 1.f - std::abs(kHallA1);
-constexpr float kAdcNormalizationFactor = 1.f / 2048.f;
 
 constexpr uint8_t kPiezoGpio = 14;
 constexpr uint32_t kPiezoGateTime = 10;
+constexpr uint32_t kPiezoFlashTimeMs = 150;
 
-constexpr uint16_t kMaxPitchBend = 8191;
-constexpr float kPitchBendHysteresis = 0.01f;
+constexpr sensor_math::Value kStrikePositionMinWeight = sensor_math::constant(0.02f);
 
 constexpr float kVl6120MinRange = 5.0f;
 constexpr float kVl6120MaxRange = 17.0f;
-constexpr float kVl6120RangeScale = 1.f / (kVl6120MaxRange - kVl6120MinRange);
 constexpr uint32_t kVl6180FreqMs = 100;
+
+// MPE lower zone: master channel 1, member channels 2 to 16
+constexpr uint8_t kMpeMasterChannel = 0;
+constexpr uint8_t kMpeMemberChannels = 15;
+constexpr uint8_t kMpeSlideCC = 74;
+constexpr uint32_t kTouchPressureMin = 50000;
+constexpr uint32_t kTouchPressureMax = 250000;
 // ----------------
 
 // Variables
-NoteTrigger g_touch[kNumTouchPins];
+// Outputs of the momentary sources, shared because starting an MPE note may steal the channel of any of them
+ActiveOutput g_touch_output[kNumTouchPins] = {};
+ActiveOutput g_piezo_output = {MappingType::None, 0, 0, false};
 
-PiezoTrigger g_piezo;
-uint32_t g_piezo_last_trigger = 0;
-bool g_piezo_note_on = false;
+// Kept by the Hall pipeline, recorded by the piezo one on every hit
+sensor_math::Value g_strike_position = sensor_math::constant(0.5f);
 
-float g_prev_hall_output = 0.f;
-float g_last_hall_value_sent = 0.f;
+bool g_mpe_mode = false;
+MpeZone g_mpe_zone;
+uint8_t g_mpe_focus_channel = MpeZone::kNoChannel;
+bool g_usb_mounted = false;
 
-uint32_t g_vl6180_last_read = 0;
-uint8_t g_vl6180_last_cc = 0;
+// Published at the end of every control cycle for the LED visualizer on core 1
+SensorSnapshot g_snapshot = {};
+static_assert(kSnapshotPads == kNumTouchPins, "Snapshot must hold every touch pad");
+
+// Time at which the sensor currently being handled was read. Every message sent by the handler carries it.
+uint32_t g_capture_time_us = 0;
 // ----------------
 
-void handle_vl6180()
+// Notes go to their own virtual cable so hosts can route them away from the controller stream. In MPE mode every
+// message belongs to a note's expression and must stay on the same port as the notes.
+uint8_t cable_for(uint8_t status)
 {
-    auto now = to_ms_since_boot(get_absolute_time());
-    if (now - g_vl6180_last_read < kVl6180FreqMs)
+    uint8_t type = status & 0xF0;
+    if (g_mpe_mode || type == 0x80 || type == 0x90)
     {
-        return;
+        return MIDI_CABLE_NOTES;
     }
-    g_vl6180_last_read = now;
-    float raw_range = vl6180_read();
-    float range = std::clamp(raw_range, kVl6120MinRange, kVl6120MaxRange);
-    range = 1.f - (range - kVl6120MinRange) * kVl6120RangeScale;
-    // LOG_INFO("Range: %f, raw: %f\n", range, raw_range);
+    return MIDI_CABLE_CONTROLLERS;
+}
 
-    uint8_t msg[3];
-    uint8_t midi_val = range * 127;
-    if (midi_val != g_vl6180_last_cc)
+void send_midi(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    uint8_t msg[3] = {status, data1, data2};
+    uint8_t cable = cable_for(status);
+    if (midi_scheduler::push(g_capture_time_us, cable, msg, 3))
     {
-        msg[0] = 0xB1;     // CC message - Channel 1
-        msg[1] = 21;       // CC Number
-        msg[2] = midi_val; // cc value
-        tud_midi_n_stream_write(0, 0, msg, 3);
-        g_vl6180_last_cc = midi_val;
+        latency_probe::echo(g_capture_time_us, cable, msg, 3);
     }
 }
 
-void handle_pitch_bend()
+void send_midi(uint8_t status, uint8_t data1)
 {
-    uint8_t msg[3];
+    uint8_t msg[2] = {status, data1};
+    midi_scheduler::push(g_capture_time_us, cable_for(status), msg, 2);
+}
 
-    adc_select_input(0);
-    float hall1 = (adc_read() - 2048.f) * kAdcNormalizationFactor;
-    adc_select_input(1);
-    float hall2 = (adc_read() - 2048.f) * kAdcNormalizationFactor;
-    adc_select_input(2);
-    float hall3 = (adc_read() - 2048.f) * kAdcNormalizationFactor;
+void send_pitch_bend(uint8_t channel, uint16_t pitch_bend)
+{
+    send_midi(0xE0 | channel, pitch_bend & 0x7F, (pitch_bend >> 7) & 0x7F);
+}
 
-    float hall_value = hall3 + 2.f * hall2 + 3.f * hall1;
-    hall_value /= 6.f;
-    hall_value = kHallB0 * hall_value + g_prev_hall_output * kHallA1;
-    g_prev_hall_output = hall_value;
+// MPE Configuration Message (RPN 6) announcing the zone layout to the host
+void send_mpe_configuration()
+{
+    const uint8_t status = 0xB0 | g_mpe_zone.master_channel();
+    const uint8_t msgs[][3] = {
+        {status, 101, 0},
+        {status, 100, 6},
+        {status, 6, g_mpe_mode ? g_mpe_zone.member_count() : uint8_t(0)},
+        {status, 101, 127},
+        {status, 100, 127},
+    };
+
+    // The zone layout always describes the notes port, even when MPE is being turned off
+    for (const auto& msg : msgs)
+    {
+        midi_scheduler::push(g_capture_time_us, MIDI_CABLE_NOTES, msg, 3);
+    }
+}
 
-    bool send_cc = std::abs(g_prev_hall_output - g_last_hall_value_sent) > kPitchBendHysteresis;
+// Last range value sent as a slide controller, defined with the pipelines
+uint8_t current_slide();
 
-    if (g_prev_hall_output > 0.08f && send_cc)
+// Allocates a member channel and sends the per-note initial state followed by the note on, as required by MPE.
+uint8_t mpe_note_on(uint8_t note, uint8_t velocity, uint8_t pressure)
+{
+    uint8_t stolen_note;
+    uint8_t channel = g_mpe_zone.allocate(note, &stolen_note);
+    if (channel == MpeZone::kNoChannel)
     {
-        g_last_hall_value_sent = g_prev_hall_output;
+        return channel;
+    }
 
-        uint16_t pitch_bend = 8192 + kMaxPitchBend * g_prev_hall_output;
-        assert(pitch_bend <= 16383);
+    if (stolen_note != MpeZone::kNoNote)
+    {
+        send_midi(0x80 | channel, stolen_note, 0);
+        for (auto& output : g_touch_output)
+        {
+            if (output.mpe && output.channel == channel)
+            {
+                output.type = MappingType::None;
+            }
+        }
+        if (g_piezo_output.mpe && g_piezo_output.channel == channel)
+        {
+            g_piezo_output.type = MappingType::None;
+        }
+    }
+
+    send_pitch_bend(channel, sensor_math::kPitchBendCenter);
+    send_midi(0xB0 | channel, kMpeSlideCC, current_slide());
+    send_midi(0xD0 | channel, pressure);
+    send_midi(0x90 | channel, note, velocity);
+
+    g_mpe_focus_channel = channel;
+    return channel;
+}
 
-        // send pitchbend message
-        msg[0] = 0xE0; // Pitch Bend - Channel 1
-        msg[1] = pitch_bend & 0x7F;
-        msg[2] = (pitch_bend >> 7) & 0x7F;
-        tud_midi_n_stream_write(0, 0, msg, 3);
+void mpe_note_off(uint8_t channel)
+{
+    if (!g_mpe_zone.is_active(channel))
+    {
+        return;
+    }
+
+    send_midi(0x80 | channel, g_mpe_zone.note(channel), 0);
+    g_mpe_zone.release(channel);
+    if (g_mpe_focus_channel == channel)
+    {
+        g_mpe_focus_channel = MpeZone::kNoChannel;
     }
 }
 
-void handle_piezo_trigger()
+// Sends the activation message of a momentary source (pad or piezo) and returns what was sent.
+ActiveOutput activate(const Mapping& mapping, uint8_t pressure)
 {
-    auto now = to_ms_since_boot(get_absolute_time());
-    uint8_t msg[3];
+    ActiveOutput output = {mapping.type, mapping.channel, mapping.number, false};
 
-    if (g_piezo.triggered())
+    switch (mapping.type)
     {
-        if (g_piezo_note_on)
+    case MappingType::Note:
+        if (g_mpe_mode)
         {
-            msg[0] = 0x80; // Note Off - Channel 1
-            msg[1] = 36;   // Note Number
-            msg[2] = 0;    // Velocity
-            tud_midi_n_stream_write(0, 0, msg, 3);
-            g_piezo_note_on = false;
+            output.mpe = true;
+            output.channel = mpe_note_on(mapping.number, mapping.value, pressure);
+            if (output.channel == MpeZone::kNoChannel)
+            {
+                output.type = MappingType::None;
+            }
         }
-        set_led_blinking(Pixels::Midi, DIM_BLUE, 10, 1);
+        else
+        {
+            send_midi(0x90 | mapping.channel, mapping.number, mapping.value);
+        }
+        break;
+    case MappingType::ControlChange:
+        send_midi(0xB0 | mapping.channel, mapping.number, mapping.value);
+        break;
+    case MappingType::PitchBend:
+        send_pitch_bend(mapping.channel,
+                        sensor_math::kPitchBendCenter + (mapping.value * sensor_math::kMaxPitchBend) / 127);
+        break;
+    default:
+        output.type = MappingType::None;
+        break;
+    }
+
+    return output;
+}
 
-        msg[0] = 0x90; // Note On - Channel 1
-        msg[1] = 36;   // Note Number
-        msg[2] = 127;  // Velocity
-        tud_midi_n_stream_write(0, 0, msg, 3);
-        g_piezo_last_trigger = now;
-        g_piezo_note_on = true;
+void deactivate(ActiveOutput& output)
+{
+    switch (output.type)
+    {
+    case MappingType::Note:
+        if (output.mpe)
+        {
+            mpe_note_off(output.channel);
+        }
+        else
+        {
+            send_midi(0x80 | output.channel, output.number, 0);
+        }
+        break;
+    case MappingType::ControlChange:
+        send_midi(0xB0 | output.channel, output.number, 0);
+        break;
+    case MappingType::PitchBend:
+        send_pitch_bend(output.channel, sensor_math::kPitchBendCenter);
+        break;
+    default:
+        break;
     }
 
-    if (g_piezo_note_on && (now - g_piezo_last_trigger) > kPiezoGateTime)
+    output.type = MappingType::None;
+}
+
+// The most recently played note's channel, or the zone's master channel when no note is held so that the value still
+// reaches the host as a zone-wide one
+uint8_t mpe_channel()
+{
+    return g_mpe_focus_channel != MpeZone::kNoChannel ? g_mpe_focus_channel : g_mpe_zone.master_channel();
+}
+
+// Sends a continuous source value in [-1, 1]. In MPE mode the value goes to the most recently played note.
+void send_continuous(const Mapping& mapping, sensor_math::Value value, uint8_t mpe_cc)
+{
+    switch (mapping.type)
+    {
+    case MappingType::ControlChange:
+    {
+        uint8_t cc_value = sensor_math::to_cc(value);
+        if (g_mpe_mode)
+        {
+            send_midi(0xB0 | mpe_channel(), mpe_cc, cc_value);
+        }
+        else
+        {
+            send_midi(0xB0 | mapping.channel, mapping.number, cc_value);
+        }
+        break;
+    }
+    case MappingType::PitchBend:
+    {
+        uint16_t pitch_bend = sensor_math::to_pitch_bend(value);
+        assert(pitch_bend <= 16383);
+        if (g_mpe_mode)
+        {
+            send_pitch_bend(mpe_channel(), pitch_bend);
+        }
+        else
+        {
+            send_pitch_bend(mapping.channel, pitch_bend);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Sends a 0 to 1 value of a source that is no note's expression. Controllers 0 to 31 are followed by their LSB on 32
+// to 63, 14 bits in all. In MPE mode the value applies to the whole zone and goes to its master channel.
+void send_controller(const Mapping& mapping, sensor_math::Value value)
+{
+    uint8_t channel = g_mpe_mode ? g_mpe_zone.master_channel() : mapping.channel;
+    switch (mapping.type)
     {
-        msg[0] = 0x80; // Note Off - Channel 1
-        msg[1] = 36;   // Note Number
-        msg[2] = 0;    // Velocity
-        tud_midi_n_stream_write(0, 0, msg, 3);
-        g_piezo_note_on = false;
+    case MappingType::ControlChange:
+        if (mapping.number < 32)
+        {
+            uint16_t cc_value = sensor_math::to_cc14(value);
+            send_midi(0xB0 | channel, mapping.number, cc_value >> 7);
+            send_midi(0xB0 | channel, mapping.number + 32, cc_value & 0x7F);
+        }
+        else
+        {
+            send_midi(0xB0 | channel, mapping.number, sensor_math::to_cc(value));
+        }
+        break;
+    case MappingType::PitchBend:
+        send_pitch_bend(channel, sensor_math::to_cc14(value));
+        break;
+    default:
+        break;
     }
 }
 
-void handle_touch_pad()
+// Sensor pipeline stages. Every source stamps g_capture_time_us, so each message sent downstream carries the read time.
+
+template <SourceId kSource>
+struct ContinuousEmitter
+{
+    void emit(sensor_math::Value value)
+    {
+        const Mapping& mapping = mapping::active()[kSource];
+        send_continuous(mapping, response_curve::apply(mapping.curve, value), kMpeSlideCC);
+    }
+};
+
+struct HallConfig
+{
+    static constexpr sensor_math::Value kA1 = sensor_math::constant(0.80f);
+
+    // Below the dead zone the membrane is at rest and nothing is sent. The initial noise gives the former fixed 0.08
+    // dead zone and 0.01 hysteresis; a noisy membrane widens them, and with kMappingFlagSensitive a quiet one narrows
+    // them down to a quarter.
+    static constexpr int32_t kThresholdFactor = 32;
+    static constexpr int32_t kHysteresisFactor = 4;
+    static constexpr sensor_math::Value kInitialNoise = sensor_math::constant(0.0025f);
+    static constexpr sensor_math::Value kMinNoise = sensor_math::constant(0.000625f);
+    static constexpr sensor_math::Value kMaxNoise = sensor_math::constant(0.00625f);
+    static constexpr int kShift = 6;
+    static constexpr int kSlowShift = 10;
+};
+
+struct HallDeflections
+{
+    sensor_math::Value hall1;
+    sensor_math::Value hall2;
+    sensor_math::Value hall3;
+};
+
+struct HallSource : sensor_pipeline::EveryCycle
+{
+    void init()
+    {
+        hal::adc_gpio_init(hal::kAdcFirstPin);
+        hal::adc_gpio_init(hal::kAdcFirstPin + 1);
+        hal::adc_gpio_init(hal::kAdcFirstPin + 2);
+    }
+
+    HallDeflections read()
+    {
+        g_capture_time_us = hal::time_us();
+        uint16_t adc[3];
+        adc[0] = hal::adc_read(0);
+        adc[1] = hal::adc_read(1);
+        adc[2] = hal::adc_read(2);
+        sensor_stream::write_hall(g_capture_time_us, adc);
+
+        return {sensor_math::hall_deflection<sensor_math::Value>(adc[0]),
+                sensor_math::hall_deflection<sensor_math::Value>(adc[1]),
+                sensor_math::hall_deflection<sensor_math::Value>(adc[2])};
+    }
+};
+
+// Weighted displacement, low passed. Tracks the strike position on the way.
+class HallFilter
+{
+  public:
+    sensor_math::Value process(const HallDeflections& hall)
+    {
+        g_snapshot.hall = lowpass_.process(sensor_math::hall_weighted(hall.hall1, hall.hall2, hall.hall3));
+        g_strike_position = sensor_math::strike_position(hall.hall1, hall.hall2, hall.hall3, kStrikePositionMinWeight,
+                                                         g_strike_position);
+        return g_snapshot.hall;
+    }
+
+  private:
+    sensor_pipeline::OnePole<HallConfig> lowpass_;
+};
+
+struct PiezoSample
 {
-    uint8_t msg[3];
+    bool triggered;
+    uint32_t time_ms;
+};
 
-    for (size_t i = 0; i < kNumTouchPins; i++)
+class PiezoSource : public sensor_pipeline::EveryCycle
+{
+  public:
+    void init()
     {
-        auto& touch = g_touch[i];
+        piezo_.init(kPiezoGpio);
+    }
+
+    PiezoSample read()
+    {
+        uint32_t now = hal::time_ms();
+        g_capture_time_us = hal::time_us();
+        return {piezo_.triggered(), now};
+    }
 
-        if (touch.pin.triggered())
+  private:
+    PiezoTrigger piezo_;
+};
+
+struct GateEvent
+{
+    bool release;
+    bool strike;
+};
+
+// Opens the note on every trigger and closes it kPiezoGateTime after the last one. A retrigger closes it first.
+class PiezoGate
+{
+  public:
+    using Output = GateEvent;
+
+    bool map(const PiezoSample& sample, GateEvent* event)
+    {
+        *event = {false, false};
+        if (sample.triggered)
         {
-            touch.state = true;
-            set_led(touch.led, DIM_BLUE);
-            if (g_touchGpios[i] == 19)
-            {
-                msg[0] = 0xB1; // CC message - Channel 1
-                msg[1] = 20;   // CC Number
-                msg[2] = 127;  // cc value
-                tud_midi_n_stream_write(0, 0, msg, 3);
-            }
-            else
+            *event = {open_, true};
+            open_ = true;
+            last_trigger_ms_ = sample.time_ms;
+        }
+        else if (open_ && (sample.time_ms - last_trigger_ms_) > kPiezoGateTime)
+        {
+            event->release = true;
+            open_ = false;
+        }
+        return event->release || event->strike;
+    }
+
+  private:
+    bool open_ = false;
+    uint32_t last_trigger_ms_ = 0;
+};
+
+struct PiezoEmitter
+{
+    void emit(const GateEvent& event)
+    {
+        if (event.release)
+        {
+            deactivate(g_piezo_output);
+        }
+        if (!event.strike)
+        {
+            return;
+        }
+
+        const Mapping& piezo_mapping = mapping::active()[SourceId::Piezo];
+        flash_led(Pixels::Midi, BLUE, piezo_mapping.value, kPiezoFlashTimeMs);
+
+        g_piezo_output = activate(piezo_mapping, 127);
+
+        ++g_snapshot.hit_count;
+        g_snapshot.hit_time_us = g_capture_time_us;
+        g_snapshot.hit_velocity = piezo_mapping.value;
+        g_snapshot.strike_position = g_strike_position;
+    }
+};
+
+struct TouchSample
+{
+    bool triggered;
+    bool held;
+    uint32_t magnitude;
+};
+
+// This cycle's pad readings, which the slider reuses
+TouchSample g_pad_samples[kNumTouchPins] = {};
+
+template <size_t kPad>
+class TouchSource : public sensor_pipeline::EveryCycle
+{
+  public:
+    void init()
+    {
+        pin_.init(kCapTouchFirstGpio + kPad, 2000);
+        pin_.calibrate_pin();
+    }
+
+    TouchSample read()
+    {
+        bool triggered = pin_.triggered();
+        g_capture_time_us = hal::time_us();
+        sensor_stream::write_cap_touch(g_capture_time_us, kPad, pin_.get_total());
+
+        g_pad_samples[kPad] = {triggered, pin_.get_state(), pin_.get_magnitude()};
+        return g_pad_samples[kPad];
+    }
+
+  private:
+    CapPin pin_;
+};
+
+struct TouchEvent
+{
+    enum class Kind : uint8_t
+    {
+        None,
+        Press,
+        Release,
+        Pressure,
+    };
+
+    Kind kind;
+    bool held;
+    uint8_t pressure;
+};
+
+// Press and release edges of a pad and its pressure changes while held. Passes every cycle so that the snapshot
+// follows the pressure.
+class TouchMapper
+{
+  public:
+    using Output = TouchEvent;
+
+    bool map(const TouchSample& sample, TouchEvent* event)
+    {
+        uint8_t pressure = sensor_math::touch_pressure(sample.magnitude, kTouchPressureMin, kTouchPressureMax);
+        TouchEvent::Kind kind = TouchEvent::Kind::None;
+        if (sample.triggered)
+        {
+            kind = TouchEvent::Kind::Press;
+            held_ = true;
+        }
+        else if (held_ && !sample.held)
+        {
+            kind = TouchEvent::Kind::Release;
+            held_ = false;
+        }
+        else if (held_ && pressure != pressure_)
+        {
+            kind = TouchEvent::Kind::Pressure;
+        }
+
+        if (held_)
+        {
+            pressure_ = pressure;
+        }
+        *event = {kind, held_, pressure_};
+        return true;
+    }
+
+  private:
+    bool held_ = false;
+    uint8_t pressure_ = 0;
+};
+
+template <size_t kPad>
+struct TouchEmitter
+{
+    void emit(const TouchEvent& event)
+    {
+        ActiveOutput& output = g_touch_output[kPad];
+        switch (event.kind)
+        {
+        case TouchEvent::Kind::Press:
+            set_led(g_touchPixels[kPad], DIM_BLUE);
+            output = activate(mapping::active().sources[static_cast<size_t>(SourceId::Touch0) + kPad], event.pressure);
+            LOG_INFO("Touch detected on pad %u\n", static_cast<unsigned>(kPad));
+            break;
+        case TouchEvent::Kind::Release:
+            set_led(g_touchPixels[kPad], 0);
+            deactivate(output);
+            LOG_INFO("Touch released on pad %u\n", static_cast<unsigned>(kPad));
+            break;
+        case TouchEvent::Kind::Pressure:
+            // In MPE mode the cap-touch magnitude drives the note's own channel pressure
+            if (output.type == MappingType::Note && output.mpe)
             {
-                LOG_INFO("Touch detected for note %d\n", touch.note);
-                msg[0] = 0x90;       // Note On - Channel 1
-                msg[1] = touch.note; // Note Number
-                msg[2] = 127;        // Velocity
-                tud_midi_n_stream_write(0, 0, msg, 3);
+                send_midi(0xD0 | output.channel, event.pressure);
             }
+            break;
+        default:
+            break;
         }
-        if (touch.state && !touch.pin.get_state())
+        g_snapshot.touch_pressure[kPad] = event.held ? event.pressure : 0;
+    }
+};
+
+struct SliderConfig
+{
+    // Speed low pass
+    static constexpr sensor_math::Value kA1 = sensor_math::constant(0.80f);
+
+    // Position hysteresis, from the position's noise while the finger rests
+    static constexpr int32_t kHysteresisFactor = 4;
+    static constexpr sensor_math::Value kInitialNoise = sensor_math::constant(0.0005f);
+    static constexpr sensor_math::Value kMinNoise = sensor_math::constant(0.0001f);
+    static constexpr sensor_math::Value kMaxNoise = sensor_math::constant(0.005f);
+    static constexpr int kShift = 5;
+    static constexpr int kSlowShift = 9;
+};
+
+// A swipe across the whole strip this fast or faster is full speed. A power of two, so that the speed of a position
+// step in 1/32768 of the strip is 2^17 / 2^15 = 4 times the step over the elapsed time.
+constexpr uint32_t kSliderFullSwipeUs = 1 << 17;
+
+struct SliderState
+{
+    bool touching;
+    sensor_math::Value position; // 0 on the first pad, 1 on the last
+    sensor_math::Value speed;    // 1 for a full swipe in kSliderFullSwipeUs or faster
+};
+
+// Reads nothing itself, the touch pipelines before it have read the pads
+struct SliderSource : sensor_pipeline::EveryCycle
+{
+    void init()
+    {
+    }
+
+    const TouchSample* read()
+    {
+        return g_pad_samples;
+    }
+};
+
+// Centroid of the strongest pad and its neighbours, which interpolates between the pad centers, and its speed
+class SliderFilter
+{
+  public:
+    SliderState process(const TouchSample* pads)
+    {
+        size_t strongest = 0;
+        bool touching = false;
+        for (size_t i = 0; i < kNumTouchPins; ++i)
         {
-            set_led(touch.led, 0);
-            touch.state = false;
-            if (g_touchGpios[i] == 19)
+            touching |= pads[i].held;
+            if (pads[i].magnitude > pads[strongest].magnitude)
             {
-                msg[0] = 0xB1; // CC message - Channel 1
-                msg[1] = 20;   // CC Number
-                msg[2] = 0;    // cc value
-                tud_midi_n_stream_write(0, 0, msg, 3);
+                strongest = i;
             }
-            else
+        }
+        if (!touching)
+        {
+            landed_ = false;
+            speed_value_ = speed_.process({});
+            return {false, {}, speed_value_};
+        }
+
+        uint64_t weight = 0;
+        uint64_t moment = 0;
+        size_t last = std::min(strongest + 1, kNumTouchPins - 1);
+        for (size_t i = strongest > 0 ? strongest - 1 : 0; i <= last; ++i)
+        {
+            weight += pads[i].magnitude;
+            moment += i * static_cast<uint64_t>(pads[i].magnitude);
+        }
+        // In 1/32768 of the strip
+        uint32_t position = weight != 0 ? static_cast<uint32_t>((moment << 15) / ((kNumTouchPins - 1) * weight)) : 0;
+
+        sensor_math::Value fraction = sensor_math::fraction<sensor_math::Value>(position, 1 << 15);
+        uint32_t step = 0;
+        uint32_t elapsed_us = g_capture_time_us - previous_us_;
+        if (landed_)
+        {
+            // No time to measure a speed over, the step is counted with the next sample instead
+            if (elapsed_us == 0)
             {
-                msg[0] = 0x80;       // Note Off - Channel 1
-                msg[1] = touch.note; // Note Number
-                msg[2] = 0;          // Velocity
-                tud_midi_n_stream_write(0, 0, msg, 3);
-                LOG_INFO("Touch released for note %d\n", touch.note);
+                return {true, fraction, speed_value_};
             }
+            step = position > previous_ ? position - previous_ : previous_ - position;
         }
+        landed_ = true;
+        previous_ = position;
+        previous_us_ = g_capture_time_us;
+
+        speed_value_ =
+            speed_.process(sensor_math::fraction<sensor_math::Value>(step * (kSliderFullSwipeUs >> 15), elapsed_us));
+        return {true, fraction, speed_value_};
     }
+
+  private:
+    bool landed_ = false;
+    uint32_t previous_ = 0;
+    uint32_t previous_us_ = 0;
+    sensor_pipeline::OnePole<SliderConfig> speed_;
+    sensor_math::Value speed_value_ = {};
+};
+
+// Passes the position when it moves more than its noise and once when the finger lifts, to bring the speed to 0
+class SliderMapper
+{
+  public:
+    using Output = SliderState;
+
+    bool map(const SliderState& state, SliderState* output)
+    {
+        if (!state.touching)
+        {
+            bool lifted = touching_;
+            touching_ = false;
+            *output = {false, last_, {}};
+            return lifted;
+        }
+
+        noise_.update(state.position);
+        bool landed = !touching_;
+        touching_ = true;
+        if (!landed &&
+            !sensor_math::exceeds_hysteresis(state.position, last_, noise_.margin(SliderConfig::kHysteresisFactor)))
+        {
+            return false;
+        }
+        last_ = state.position;
+        *output = state;
+        return true;
+    }
+
+  private:
+    noise_floor::NoiseFloor<sensor_math::Value, SliderConfig> noise_;
+    sensor_math::Value last_ = {};
+    bool touching_ = false;
+};
+
+struct SliderEmitter
+{
+    void emit(const SliderState& state)
+    {
+        const MappingTable& table = mapping::active();
+        if (state.touching)
+        {
+            const Mapping& position = table[SourceId::Slider];
+            send_controller(position, response_curve::apply(position.curve, state.position));
+        }
+        const Mapping& speed = table[SourceId::SliderSpeed];
+        send_controller(speed, response_curve::apply(speed.curve, state.speed));
+    }
+};
+
+struct RangeConfig
+{
+    static constexpr sensor_math::Value kA1 = sensor_math::constant(0.50f);
+
+    // At the initial noise any change of the controller value is sent, as many as five steps are held back in a noisy
+    // room. The sensor is read at 10 Hz, hence the short time constants.
+    static constexpr int32_t kHysteresisFactor = 2;
+    static constexpr sensor_math::Value kInitialNoise = sensor_math::constant(0.001f);
+    static constexpr sensor_math::Value kMinNoise = sensor_math::constant(0.00025f);
+    static constexpr sensor_math::Value kMaxNoise = sensor_math::constant(0.02f);
+    static constexpr int kShift = 3;
+    static constexpr int kSlowShift = 6;
+};
+
+struct RangeSample
+{
+    bool valid;
+    sensor_math::Value range;
+};
+
+class RangeSource : public sensor_pipeline::EveryPeriod<kVl6180FreqMs>
+{
+  public:
+    // The sensor is set up by init_vl6180x() before the task starts
+    void init()
+    {
+    }
+
+    RangeSample read()
+    {
+        bool valid = vl6180_read();
+        g_capture_time_us = hal::time_us();
+
+        Vl6180Sample sample = vl6180_last_sample();
+        sensor_stream::write_range(g_capture_time_us, sample.range_mm, sample.status);
+        return {valid, sensor_math::range_fraction<sensor_math::Value>(sample.range_mm)};
+    }
+};
+
+// Low passed range to 1 at kVl6120MinRange and closer, 0 at kVl6120MaxRange and farther. A failed measurement reads
+// as 0 mm and leaves the filter alone.
+class RangeFilter
+{
+  public:
+    sensor_math::Value process(const RangeSample& sample)
+    {
+        sensor_math::Value range = sample.valid ? lowpass_.process(sample.range) : sensor_math::Value{};
+        return sensor_math::normalize_range(range, kMinRange, kMaxRange);
+    }
+
+  private:
+    static constexpr sensor_math::Value kMinRange =
+        sensor_math::constant(kVl6120MinRange / sensor_math::kRangeFullScaleMm);
+    static constexpr sensor_math::Value kMaxRange =
+        sensor_math::constant(kVl6120MaxRange / sensor_math::kRangeFullScaleMm);
+
+    sensor_pipeline::OnePole<RangeConfig> lowpass_;
+};
+
+template <size_t kPad>
+using TouchPad =
+    sensor_pipeline::Pipeline<TouchSource<kPad>, sensor_pipeline::Identity, TouchMapper, TouchEmitter<kPad>>;
+
+using TouchSlider = sensor_pipeline::Pipeline<SliderSource, SliderFilter, SliderMapper, SliderEmitter>;
+
+using HallSlide = sensor_pipeline::Pipeline<HallSource, HallFilter, sensor_pipeline::AdaptiveHysteresis<HallConfig>,
+                                            ContinuousEmitter<SourceId::Hall>>;
+using PiezoHit = sensor_pipeline::Pipeline<PiezoSource, sensor_pipeline::Identity, PiezoGate, PiezoEmitter>;
+using RangeSlide = sensor_pipeline::Timed<
+    profiler::Section::Vl6180, trace::Span::Vl6180,
+    sensor_pipeline::Pipeline<RangeSource, RangeFilter, sensor_pipeline::AdaptiveCcChange<RangeConfig>,
+                              ContinuousEmitter<SourceId::Range>>>;
+
+// Every sensor, handled in this order on each control cycle. Adding one is a line here plus any stage it needs.
+using Sensors = sensor_pipeline::Pipelines<
+    sensor_pipeline::Timed<profiler::Section::PitchBend, trace::Span::PitchBend, HallSlide>,
+    sensor_pipeline::Timed<profiler::Section::PiezoTrigger, trace::Span::PiezoTrigger, PiezoHit>,
+    sensor_pipeline::Timed<profiler::Section::TouchPad, trace::Span::TouchPad,
+                           sensor_pipeline::Pipelines<TouchPad<0>, TouchPad<1>, TouchPad<2>, TouchPad<3>, TouchSlider>>,
+    RangeSlide>;
+
+Sensors g_sensors;
+
+uint8_t current_slide()
+{
+    return g_sensors.get<RangeSlide>().stage().mapper().last();
+}
+
+// Applies a table staged over SysEx. Only called between control cycles so every handler sees one table per cycle.
+void commit_mapping()
+{
+    if (!mapping::commit())
+    {
+        return;
+    }
+
+    bool mpe_mode = (mapping::active().flags & kMappingFlagMpe) != 0;
+    if (mpe_mode != g_mpe_mode)
+    {
+        g_capture_time_us = hal::time_us();
+        g_mpe_mode = mpe_mode;
+        g_mpe_focus_channel = MpeZone::kNoChannel;
+        if (g_usb_mounted)
+        {
+            send_mpe_configuration();
+        }
+    }
+    noise_floor::set_sensitive((mapping::active().flags & kMappingFlagSensitive) != 0);
+    LOG_INFO("Mapping table updated\n");
 }
 
 void midi_task(void)
 {
-    // float range = vl6180_read();
-    // constexpr float kMinRange = 9.0f;
-    // constexpr float kMaxRange = 23.0f;
-    // range = std::clamp(range, kMinRange, kMaxRange);
+    commit_mapping();
+
+    g_sensors.run();
 
-    handle_pitch_bend();
+    g_snapshot.timestamp_us = hal::time_us();
+    sensor_snapshot::publish(g_snapshot);
 
-    handle_piezo_trigger();
+    sysex::poll();
 
-    handle_touch_pad();
+    telemetry::poll();
 
-    handle_vl6180();
+    task_stats::poll();
+
+    sensor_stream::flush();
 }
 } // namespace
 
@@ -230,68 +890,57 @@ void usb_midi_task(void* params)
 {
     LOG_INFO("Hello from USB MIDI task\n");
 
-    uint32_t max_time = 0;
-    uint32_t min_time = 0xffffffff;
-    uint32_t avg_time = 0;
-    uint32_t count = 0;
-
     while (true)
     {
-        auto now = to_ms_since_boot(get_absolute_time());
-        midi_task();
-        auto elapsed = to_ms_since_boot(get_absolute_time()) - now;
-
-        if (elapsed > max_time)
-        {
-            max_time = elapsed;
-        }
-        if (elapsed < min_time)
-        {
-            min_time = elapsed;
-        }
-        avg_time += elapsed;
-        count++;
-
-        if (count > 1000)
-        {
-            LOG_INFO("USB MIDI task max time: %d\n", max_time);
-            LOG_INFO("USB MIDI task min time: %d\n", min_time);
-            LOG_INFO("USB MIDI task avg time: %d\n", avg_time / count);
-            max_time = 0;
-            min_time = 0xffffffff;
-            avg_time = 0;
-            count = 0;
-        }
-
+        run_midi_cycle();
         taskYIELD();
     }
 }
 
-void start_midi_task()
+void init_midi_controller()
+{
+    g_sensors.init();
+
+    mapping::init();
+    sensor_stream::init();
+    telemetry::init();
+    profiler::init();
+    latency_probe::init();
+    task_stats::init();
+    g_mpe_mode = (mapping::active().flags & kMappingFlagMpe) != 0;
+    noise_floor::set_sensitive((mapping::active().flags & kMappingFlagSensitive) != 0);
+    g_mpe_zone.init(kMpeMasterChannel, kMpeMemberChannels);
+}
+
+void run_midi_cycle()
 {
-    for (size_t i = 0; i < kNumTouchPins; i++)
+    bool mounted = hal::usb_midi_mounted();
+    // A host that was never told of a zone has none, so only an active one is announced on mount
+    if (mounted && !g_usb_mounted && g_mpe_mode)
     {
-        g_touch[i].pin.init(g_touchGpios[i], 2000);
-        g_touch[i].pin.calibrate_pin();
-        g_touch[i].note = kStartNote + i;
-        g_touch[i].velocity = 127;
-        g_touch[i].state = false;
-        g_touch[i].led = g_touchPixels[i];
+        g_capture_time_us = hal::time_us();
+        send_mpe_configuration();
     }
+    g_usb_mounted = mounted;
 
-    g_piezo.init(kPiezoGpio);
+    profiler::ScopedTimer timer(profiler::Section::Loop);
+    trace::ScopedSpan span(trace::Span::MidiCycle);
+    midi_task();
+}
 
-    adc_gpio_init(26);
-    adc_gpio_init(27);
-    adc_gpio_init(28);
+void start_midi_task()
+{
+    init_midi_controller();
 
     auto result = xTaskCreate(usb_midi_task, "UsbMidiTask", USB_MIDI_TASK_STACK_SIZE, NULL, USB_MIDI_TASK_PRIORITY,
                               &g_midi_task_handle);
     LOG_INFO("USB MIDI task created\n");
+#if configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
     vTaskCoreAffinitySet(g_midi_task_handle, (1 << 0));
+#endif
 
     if (result != pdPASS)
     {
         LOG_ERROR("Failed to create USB MIDI task\n");
     }
-}
\ No newline at end of file
+}
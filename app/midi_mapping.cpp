@@ -0,0 +1,162 @@
+#include "midi_mapping.h"
+
+#include <atomic>
+
+#include "logging.h"
+#include "sysex.h"
+
+namespace
+{
+// Layout shipped with the firmware: three note pads, one CC pad, piezo kick, Hall pitch bend and range CC. MPE and the
+// slider are off, SetMapping turns them on.
+constexpr MappingTable kDefaultTable = {
+    0,
+    {
+        {MappingType::Note, 0, 37, 127},          // Touch0
+        {MappingType::Note, 0, 38, 127},          // Touch1
+        {MappingType::Note, 0, 39, 127},          // Touch2
+        {MappingType::ControlChange, 1, 20, 127}, // Touch3
+        {MappingType::Note, 0, 36, 127},          // Piezo
+        {MappingType::PitchBend, 0, 0, 0},        // Hall
+        {MappingType::ControlChange, 1, 21, 0},   // Range
+        {MappingType::None, 0, 0, 0},             // Slider
+        {MappingType::None, 0, 0, 0},             // SliderSpeed
+    },
+};
+
+// SysEx mapping entry: source, type, channel, number, value
+constexpr size_t kEntrySize = 5;
+
+MappingTable g_tables[2] = {kDefaultTable, kDefaultTable};
+std::atomic<uint8_t> g_front{0};
+std::atomic<bool> g_pending{false};
+
+// Payload: flags, then any number of entries. Sources that are not listed keep their current mapping.
+void handle_set_mapping(const uint8_t* payload, size_t size)
+{
+    if (size < 1 || (size - 1) % kEntrySize != 0)
+    {
+        LOG_WARNING("Invalid mapping message size %u\n", static_cast<unsigned>(size));
+        return;
+    }
+
+    MappingTable table = mapping::active();
+    table.flags = payload[0];
+
+    for (size_t i = 1; i < size; i += kEntrySize)
+    {
+        const uint8_t* entry = payload + i;
+        if (entry[0] >= kNumSources || entry[1] >= static_cast<uint8_t>(MappingType::Count))
+        {
+            LOG_WARNING("Invalid mapping entry for source %d\n", entry[0]);
+            return;
+        }
+
+        Mapping& mapping = table.sources[entry[0]];
+        mapping.type = static_cast<MappingType>(entry[1]);
+        mapping.channel = entry[2] & 0x0F;
+        mapping.number = entry[3];
+        mapping.value = entry[4];
+    }
+
+    if (!mapping::stage(table))
+    {
+        LOG_WARNING("Mapping update already pending, dropped\n");
+    }
+}
+
+// Payload: source, curve pairs. Staged like a mapping update, the curves change between two control cycles.
+void handle_set_curve(const uint8_t* payload, size_t size)
+{
+    if (size % 2 != 0)
+    {
+        LOG_WARNING("Invalid curve message size %u\n", static_cast<unsigned>(size));
+        return;
+    }
+
+    MappingTable table = mapping::active();
+    for (size_t i = 0; i < size; i += 2)
+    {
+        if (payload[i] >= kNumSources || payload[i + 1] >= static_cast<uint8_t>(Curve::Count))
+        {
+            LOG_WARNING("Invalid curve for source %d\n", payload[i]);
+            return;
+        }
+        table.sources[payload[i]].curve = static_cast<Curve>(payload[i + 1]);
+    }
+
+    if (!mapping::stage(table))
+    {
+        LOG_WARNING("Mapping update already pending, dropped\n");
+    }
+}
+
+void handle_reset_mapping(const uint8_t* payload, size_t size)
+{
+    (void)payload;
+    (void)size;
+    mapping::stage(kDefaultTable);
+}
+
+void handle_dump_mapping(const uint8_t* payload, size_t size)
+{
+    (void)payload;
+    (void)size;
+
+    // The entries are followed by the curve of every source, in source order
+    const MappingTable& table = mapping::active();
+    uint8_t reply[1 + kNumSources * kEntrySize + kNumSources];
+    reply[0] = table.flags;
+    for (size_t i = 0; i < kNumSources; ++i)
+    {
+        uint8_t* entry = reply + 1 + i * kEntrySize;
+        entry[0] = i;
+        entry[1] = static_cast<uint8_t>(table.sources[i].type);
+        entry[2] = table.sources[i].channel;
+        entry[3] = table.sources[i].number;
+        entry[4] = table.sources[i].value;
+        reply[1 + kNumSources * kEntrySize + i] = static_cast<uint8_t>(table.sources[i].curve);
+    }
+    sysex::send(sysex::DumpMapping, reply, sizeof(reply));
+}
+} // namespace
+
+namespace mapping
+{
+void init()
+{
+    sysex::register_handler(sysex::SetMapping, handle_set_mapping);
+    sysex::register_handler(sysex::ResetMapping, handle_reset_mapping);
+    sysex::register_handler(sysex::DumpMapping, handle_dump_mapping);
+    sysex::register_handler(sysex::SetCurve, handle_set_curve);
+}
+
+const MappingTable& active()
+{
+    return g_tables[g_front.load(std::memory_order_relaxed)];
+}
+
+bool stage(const MappingTable& table)
+{
+    if (g_pending.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    g_tables[g_front.load(std::memory_order_relaxed) ^ 1] = table;
+    g_pending.store(true, std::memory_order_release);
+    return true;
+}
+
+bool commit()
+{
+    if (!g_pending.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    g_front.store(g_front.load(std::memory_order_relaxed) ^ 1, std::memory_order_relaxed);
+    g_pending.store(false, std::memory_order_release);
+    return true;
+}
+} // namespace mapping
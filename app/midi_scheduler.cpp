@@ -0,0 +1,261 @@
+#include "midi_scheduler.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "hal.h"
+#include "sysex.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "usb_descriptors.h"
+#include "usb_midi_packet.h"
+
+namespace
+{
+static_assert((midi_scheduler::kQueueSize & (midi_scheduler::kQueueSize - 1)) == 0,
+              "Queue size must be a power of two");
+
+struct ScheduledPacket
+{
+    uint32_t timestamp_us;
+    uint8_t packet[usb_midi_packet::kSize];
+};
+
+// Single producer (MIDI task) / single consumer (SOF callback) ring
+struct Ring
+{
+    ScheduledPacket entries[midi_scheduler::kQueueSize];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+// One ring per virtual cable, drained in cable order so a burst of controller data never delays a note.
+Ring g_rings[MIDI_CABLE_COUNT];
+
+std::atomic<uint32_t> g_min_latency{0xFFFFFFFF};
+std::atomic<uint32_t> g_max_latency{0};
+std::atomic<uint32_t> g_latency_sum{0};
+std::atomic<uint32_t> g_released{0};
+std::atomic<uint32_t> g_dropped{0};
+std::atomic<uint32_t> g_min_latency_since_boot{0xFFFFFFFF};
+
+midi_scheduler::ReleaseHook g_release_hook = nullptr;
+
+// Producer side of the ring. Packets of one message are published together so the consumer never sends half a SysEx.
+class Writer
+{
+  public:
+    explicit Writer(Ring& ring) : ring_(ring), tail_(ring.tail.load(std::memory_order_relaxed)), count_(0)
+    {
+    }
+
+    bool reserve(size_t count)
+    {
+        uint32_t head = ring_.head.load(std::memory_order_acquire);
+        return (tail_ - head) + count <= midi_scheduler::kQueueSize;
+    }
+
+    // Next packet slot, stamped with the capture time
+    uint8_t* next(uint32_t timestamp_us)
+    {
+        ScheduledPacket& entry = ring_.entries[(tail_ + count_) & (midi_scheduler::kQueueSize - 1)];
+        entry.timestamp_us = timestamp_us;
+        ++count_;
+        return entry.packet;
+    }
+
+    void publish()
+    {
+        ring_.tail.store(tail_ + count_, std::memory_order_release);
+    }
+
+  private:
+    Ring& ring_;
+    uint32_t tail_;
+    uint32_t count_;
+};
+
+void record_latency(uint32_t latency_us)
+{
+    if (latency_us < g_min_latency.load(std::memory_order_relaxed))
+    {
+        g_min_latency.store(latency_us, std::memory_order_relaxed);
+    }
+    if (latency_us < g_min_latency_since_boot.load(std::memory_order_relaxed))
+    {
+        g_min_latency_since_boot.store(latency_us, std::memory_order_relaxed);
+    }
+    if (latency_us > g_max_latency.load(std::memory_order_relaxed))
+    {
+        g_max_latency.store(latency_us, std::memory_order_relaxed);
+    }
+    g_latency_sum.fetch_add(latency_us, std::memory_order_relaxed);
+    g_released.fetch_add(1, std::memory_order_relaxed);
+}
+
+void handle_stats_request(const uint8_t* payload, size_t size)
+{
+    (void)payload;
+    (void)size;
+
+    midi_scheduler::Stats stats = midi_scheduler::get_stats();
+    uint8_t reply[6 * sysex::kEncodedU32Size];
+    uint8_t* out = reply;
+    out = sysex::encode_u32(stats.min_latency_us, out);
+    out = sysex::encode_u32(stats.max_latency_us, out);
+    out = sysex::encode_u32(stats.avg_latency_us, out);
+    out = sysex::encode_u32(stats.jitter_us, out);
+    out = sysex::encode_u32(stats.released, out);
+    sysex::encode_u32(stats.dropped, out);
+    sysex::send(sysex::SchedulerStats, reply, sizeof(reply));
+
+    // Each request reports the window since the previous one
+    midi_scheduler::reset_stats();
+}
+
+// Releases the packets of one ring that are due. Returns false if the TinyUSB FIFO is full.
+bool release(Ring& ring, uint32_t now)
+{
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+    bool fifo_available = true;
+
+    while (head != tail)
+    {
+        const ScheduledPacket& entry = ring.entries[head & (midi_scheduler::kQueueSize - 1)];
+        const uint32_t age = now - entry.timestamp_us;
+        if (age < midi_scheduler::kReleaseLatencyUs)
+        {
+            // The ring is in capture order, everything behind this packet is due later
+            break;
+        }
+
+        if (!hal::usb_midi_write_packet(entry.packet))
+        {
+            // TinyUSB FIFO full, retry on the next frame
+            fifo_available = false;
+            break;
+        }
+
+        record_latency(age);
+        if (g_release_hook != nullptr)
+        {
+            g_release_hook(entry.timestamp_us, now, entry.packet);
+        }
+        ++head;
+    }
+
+    ring.head.store(head, std::memory_order_release);
+    return fifo_available;
+}
+} // namespace
+
+// Invoked by TinyUSB from tud_task() on every start of frame
+void tud_sof_cb(uint32_t frame_count)
+{
+    (void)frame_count;
+    trace::ScopedSpan span(trace::Span::MidiRelease);
+
+    const uint32_t now = hal::time_us();
+    for (auto& ring : g_rings)
+    {
+        if (!release(ring, now))
+        {
+            break;
+        }
+    }
+}
+
+namespace midi_scheduler
+{
+void init()
+{
+    sysex::register_handler(sysex::SchedulerStats, handle_stats_request);
+    hal::usb_enable_sof(true);
+}
+
+bool push(uint32_t timestamp_us, uint8_t cable, const uint8_t* msg, size_t size)
+{
+    if (!hal::usb_midi_mounted())
+    {
+        // Same as writing to TinyUSB directly: nothing is queued while no host is listening
+        return false;
+    }
+
+    if (cable >= MIDI_CABLE_COUNT)
+    {
+        return false;
+    }
+
+    Writer writer(g_rings[cable]);
+    if (size < 2 || size > 3 || !writer.reserve(1))
+    {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::MidiDropped);
+        return false;
+    }
+
+    usb_midi_packet::encode_channel(cable, msg, size, writer.next(timestamp_us));
+    writer.publish();
+    return true;
+}
+
+bool push_sysex(uint32_t timestamp_us, uint8_t cable, const uint8_t* msg, size_t size)
+{
+    if (!hal::usb_midi_mounted())
+    {
+        // Same as writing to TinyUSB directly: nothing is queued while no host is listening
+        return false;
+    }
+
+    if (cable >= MIDI_CABLE_COUNT)
+    {
+        return false;
+    }
+
+    Writer writer(g_rings[cable]);
+    if (size < 2 || !writer.reserve(usb_midi_packet::sysex_packet_count(size)))
+    {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::MidiDropped);
+        return false;
+    }
+
+    usb_midi_packet::encode_sysex(cable, msg, size, [&](const uint8_t* packet)
+                                  { memcpy(writer.next(timestamp_us), packet, usb_midi_packet::kSize); });
+    writer.publish();
+    return true;
+}
+
+void set_release_hook(ReleaseHook hook)
+{
+    g_release_hook = hook;
+}
+
+Stats get_stats()
+{
+    Stats stats;
+    stats.released = g_released.load(std::memory_order_relaxed);
+    stats.dropped = g_dropped.load(std::memory_order_relaxed);
+    stats.min_latency_us = stats.released ? g_min_latency.load(std::memory_order_relaxed) : 0;
+    stats.max_latency_us = g_max_latency.load(std::memory_order_relaxed);
+    stats.avg_latency_us = stats.released ? g_latency_sum.load(std::memory_order_relaxed) / stats.released : 0;
+    stats.jitter_us = stats.max_latency_us - stats.min_latency_us;
+    return stats;
+}
+
+void reset_stats()
+{
+    g_min_latency.store(0xFFFFFFFF, std::memory_order_relaxed);
+    g_max_latency.store(0, std::memory_order_relaxed);
+    g_latency_sum.store(0, std::memory_order_relaxed);
+    g_released.store(0, std::memory_order_relaxed);
+    g_dropped.store(0, std::memory_order_relaxed);
+}
+
+uint32_t min_release_latency_us()
+{
+    uint32_t latency = g_min_latency_since_boot.load(std::memory_order_relaxed);
+    return latency != 0xFFFFFFFF ? latency : kReleaseLatencyUs;
+}
+} // namespace midi_scheduler
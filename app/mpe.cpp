@@ -0,0 +1,94 @@
+#include "mpe.h"
+
+namespace
+{
+constexpr uint16_t rotate_right(uint16_t value, uint8_t shift)
+{
+    shift &= 0x0F;
+    return static_cast<uint16_t>((value >> shift) | (value << ((16 - shift) & 0x0F)));
+}
+} // namespace
+
+MpeZone::MpeZone() : member_mask_(0), free_mask_(0), master_channel_(0), member_count_(0), cursor_(0), notes_{0}
+{
+}
+
+void MpeZone::init(uint8_t master_channel, uint8_t num_member_channels)
+{
+    if (num_member_channels > kMaxMemberChannels)
+    {
+        num_member_channels = kMaxMemberChannels;
+    }
+
+    master_channel_ = master_channel & 0x0F;
+    member_count_ = num_member_channels;
+    member_mask_ = 0;
+    for (uint8_t i = 0; i < num_member_channels; ++i)
+    {
+        member_mask_ |= 1u << ((master_channel_ + 1 + i) & 0x0F);
+    }
+    member_mask_ &= ~(1u << master_channel_);
+    free_mask_ = member_mask_;
+    cursor_ = (master_channel_ + 1) & 0x0F;
+
+    for (auto& note : notes_)
+    {
+        note = kNoNote;
+    }
+}
+
+uint8_t MpeZone::allocate(uint8_t note, uint8_t* stolen_note)
+{
+    *stolen_note = kNoNote;
+    if (member_mask_ == 0)
+    {
+        return kNoChannel;
+    }
+
+    // Search from the round-robin cursor so that the channel that was released the longest time ago is reused first.
+    // This lets release tails ring out on the host before the channel gets a new note.
+    uint16_t candidates = free_mask_ != 0 ? free_mask_ : member_mask_;
+    uint8_t channel = (cursor_ + __builtin_ctz(rotate_right(candidates, cursor_))) & 0x0F;
+    cursor_ = (channel + 1) & 0x0F;
+
+    if ((free_mask_ & (1u << channel)) == 0)
+    {
+        *stolen_note = notes_[channel];
+    }
+
+    free_mask_ &= ~(1u << channel);
+    notes_[channel] = note;
+    return channel;
+}
+
+void MpeZone::release(uint8_t channel)
+{
+    channel &= 0x0F;
+    if ((member_mask_ & (1u << channel)) == 0)
+    {
+        return;
+    }
+
+    free_mask_ |= 1u << channel;
+    notes_[channel] = kNoNote;
+}
+
+uint8_t MpeZone::master_channel() const
+{
+    return master_channel_;
+}
+
+uint8_t MpeZone::member_count() const
+{
+    return member_count_;
+}
+
+bool MpeZone::is_active(uint8_t channel) const
+{
+    return (member_mask_ & ~free_mask_ & (1u << (channel & 0x0F))) != 0;
+}
+
+uint8_t MpeZone::note(uint8_t channel) const
+{
+    return notes_[channel & 0x0F];
+}
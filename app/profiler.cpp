@@ -0,0 +1,154 @@
+#include "profiler.h"
+
+#include "logging.h"
+#include "sysex.h"
+
+namespace
+{
+constexpr const char* kSectionNames[] = {"loop", "pitch bend", "piezo", "touch pads", "VL6180X"};
+static_assert(sizeof(kSectionNames) / sizeof(kSectionNames[0]) == profiler::kNumSections,
+              "Every section needs a name");
+
+// ProfileSummary request flags
+constexpr uint8_t kFlagReset = 0x01;
+constexpr uint8_t kFlagLog = 0x02;
+
+struct Histogram
+{
+    uint32_t buckets[profiler::kNumBuckets];
+    uint32_t count;
+    uint32_t max_us;
+};
+
+Histogram g_histograms[profiler::kNumSections] = {};
+
+size_t bucket_index(uint32_t elapsed_us)
+{
+    size_t index = elapsed_us == 0 ? 0 : 32 - __builtin_clz(elapsed_us);
+    return index < profiler::kNumBuckets ? index : profiler::kNumBuckets - 1;
+}
+
+uint32_t bucket_upper_bound(size_t index)
+{
+    return index == 0 ? 0 : (1u << index) - 1;
+}
+
+uint32_t percentile(const Histogram& histogram, uint32_t per_mille)
+{
+    if (histogram.count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the sample, rounded up so p99 of a handful of samples is the slowest one
+    uint64_t rank = (static_cast<uint64_t>(histogram.count) * per_mille + 999) / 1000;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < profiler::kNumBuckets; ++i)
+    {
+        seen += histogram.buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t bound = bucket_upper_bound(i);
+            return bound < histogram.max_us ? bound : histogram.max_us;
+        }
+    }
+    return histogram.max_us;
+}
+
+// Payload: optional flags byte. Reply: count, p50, p99 and max of every section, in Section order.
+void handle_summary_request(const uint8_t* payload, size_t size)
+{
+    uint8_t flags = size > 0 ? payload[0] : 0;
+
+    uint8_t reply[profiler::kNumSections * 4 * sysex::kEncodedU32Size];
+    uint8_t* out = reply;
+    for (size_t i = 0; i < profiler::kNumSections; ++i)
+    {
+        profiler::Summary summary = profiler::summary(static_cast<profiler::Section>(i));
+        out = sysex::encode_u32(summary.count, out);
+        out = sysex::encode_u32(summary.p50_us, out);
+        out = sysex::encode_u32(summary.p99_us, out);
+        out = sysex::encode_u32(summary.max_us, out);
+    }
+    sysex::send(sysex::ProfileSummary, reply, sizeof(reply));
+
+    if (flags & kFlagLog)
+    {
+        profiler::log_summary();
+    }
+    if (flags & kFlagReset)
+    {
+        profiler::reset();
+    }
+}
+
+// Payload: section. Reply: section followed by every bucket count.
+void handle_histogram_request(const uint8_t* payload, size_t size)
+{
+    if (size < 1 || payload[0] >= profiler::kNumSections)
+    {
+        return;
+    }
+
+    uint8_t reply[1 + profiler::kNumBuckets * sysex::kEncodedU32Size];
+    reply[0] = payload[0];
+    uint8_t* out = reply + 1;
+    for (uint32_t count : g_histograms[payload[0]].buckets)
+    {
+        out = sysex::encode_u32(count, out);
+    }
+    sysex::send(sysex::ProfileHistogram, reply, sizeof(reply));
+}
+} // namespace
+
+namespace profiler
+{
+
+void init()
+{
+    sysex::register_handler(sysex::ProfileSummary, handle_summary_request);
+    sysex::register_handler(sysex::ProfileHistogram, handle_histogram_request);
+}
+
+void record(Section section, uint32_t elapsed_us)
+{
+    Histogram& histogram = g_histograms[static_cast<size_t>(section)];
+    ++histogram.buckets[bucket_index(elapsed_us)];
+    ++histogram.count;
+    if (elapsed_us > histogram.max_us)
+    {
+        histogram.max_us = elapsed_us;
+    }
+}
+
+Summary summary(Section section)
+{
+    const Histogram& histogram = g_histograms[static_cast<size_t>(section)];
+    return {histogram.count, percentile(histogram, 500), percentile(histogram, 990), histogram.max_us};
+}
+
+const uint32_t* buckets(Section section)
+{
+    return g_histograms[static_cast<size_t>(section)].buckets;
+}
+
+void reset()
+{
+    for (auto& histogram : g_histograms)
+    {
+        histogram = {};
+    }
+}
+
+void log_summary()
+{
+    for (size_t i = 0; i < kNumSections; ++i)
+    {
+        Summary s = summary(static_cast<Section>(i));
+        LOG_INFO("%s: %lu samples, p50 %lu us, p99 %lu us, max %lu us\n", kSectionNames[i],
+                 static_cast<unsigned long>(s.count), static_cast<unsigned long>(s.p50_us),
+                 static_cast<unsigned long>(s.p99_us), static_cast<unsigned long>(s.max_us));
+    }
+}
+
+} // namespace profiler
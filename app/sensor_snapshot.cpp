@@ -0,0 +1,23 @@
+#include "sensor_snapshot.h"
+
+#include "seqlock.h"
+
+namespace
+{
+Seqlock<SensorSnapshot> g_snapshot;
+} // namespace
+
+namespace sensor_snapshot
+{
+
+void publish(const SensorSnapshot& snapshot)
+{
+    g_snapshot.write(snapshot);
+}
+
+bool read(SensorSnapshot* snapshot)
+{
+    return g_snapshot.read(snapshot);
+}
+
+} // namespace sensor_snapshot
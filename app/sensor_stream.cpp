@@ -0,0 +1,204 @@
+#include "sensor_stream.h"
+
+#include <atomic>
+
+#include "capture_codec.h"
+#include "hal.h"
+#include "logging.h"
+#include "telemetry.h"
+#include "trace.h"
+
+namespace
+{
+std::atomic<bool> g_streaming{false};
+std::atomic<uint32_t> g_dropped{0};
+
+// Compressed mode sends capture_codec records instead of raw frames
+bool g_compressed = false;
+capture_codec::Encoder g_encoder;
+
+// Bytes of the trace buffer sent so far while a dump is in progress
+bool g_dumping_trace = false;
+size_t g_trace_offset = 0;
+
+void write_record(uint8_t stream, uint32_t timestamp_us, const int32_t* values)
+{
+    if (!g_streaming.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    // Check for space before encoding: a record that is encoded but not sent would break the delta chain
+    if (hal::usb_vendor_write_available() < capture_codec::kMaxRecordSize)
+    {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::SensorStreamDropped);
+        return;
+    }
+
+    uint8_t record[capture_codec::kMaxRecordSize];
+    size_t size = g_encoder.encode(stream, timestamp_us, values, record);
+    hal::usb_vendor_write(record, size);
+}
+
+// Sends as much of the frozen trace buffer as the FIFO takes, recording resumes once all of it is queued
+void continue_trace_dump()
+{
+    size_t remaining = trace::size() - g_trace_offset;
+    size_t chunk = hal::usb_vendor_write_available();
+    chunk = chunk < remaining ? chunk : remaining;
+    g_trace_offset += hal::usb_vendor_write(trace::data() + g_trace_offset, chunk);
+    hal::usb_vendor_flush();
+
+    if (g_trace_offset == trace::size())
+    {
+        LOG_INFO("Trace dump sent, %u bytes\n", static_cast<unsigned>(g_trace_offset));
+        g_dumping_trace = false;
+        trace::set_enabled(true);
+    }
+}
+
+template <typename Payload>
+void write_frame(sensor_stream::Source source, uint32_t timestamp_us, const Payload& payload)
+{
+    if (!g_streaming.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    const sensor_stream::FrameHeader header = {sensor_stream::kFrameMagic, source, sizeof(Payload), timestamp_us};
+    if (hal::usb_vendor_write_available() < sizeof(header) + sizeof(Payload))
+    {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        telemetry::increment(telemetry::Counter::SensorStreamDropped);
+        return;
+    }
+
+    hal::usb_vendor_write(&header, sizeof(header));
+    hal::usb_vendor_write(&payload, sizeof(Payload));
+}
+} // namespace
+
+namespace sensor_stream
+{
+void init()
+{
+    g_streaming.store(false, std::memory_order_relaxed);
+    g_dropped.store(0, std::memory_order_relaxed);
+}
+
+bool is_streaming()
+{
+    return g_streaming.load(std::memory_order_relaxed);
+}
+
+void write_hall(uint32_t timestamp_us, const uint16_t adc[3])
+{
+    if (g_compressed)
+    {
+        const int32_t values[] = {adc[0], adc[1], adc[2]};
+        write_record(capture_codec::Hall, timestamp_us, values);
+        return;
+    }
+    write_frame(Source::Hall, timestamp_us, HallPayload{{adc[0], adc[1], adc[2]}});
+}
+
+void write_cap_touch(uint32_t timestamp_us, uint8_t pad, uint32_t total)
+{
+    if (g_compressed)
+    {
+        if (pad < capture_codec::kNumCapTouchStreams)
+        {
+            const int32_t values[] = {static_cast<int32_t>(total)};
+            write_record(capture_codec::CapTouch0 + pad, timestamp_us, values);
+        }
+        return;
+    }
+    write_frame(Source::CapTouch, timestamp_us, CapTouchPayload{pad, total});
+}
+
+void write_range(uint32_t timestamp_us, uint8_t range_mm, uint8_t status)
+{
+    if (g_compressed)
+    {
+        const int32_t values[] = {range_mm, status};
+        write_record(capture_codec::Range, timestamp_us, values);
+        return;
+    }
+    write_frame(Source::Range, timestamp_us, RangePayload{range_mm, status});
+}
+
+void flush()
+{
+    if (!hal::usb_vendor_mounted())
+    {
+        g_streaming.store(false, std::memory_order_relaxed);
+        if (g_dumping_trace)
+        {
+            g_dumping_trace = false;
+            trace::set_enabled(true);
+        }
+        return;
+    }
+
+    while (hal::usb_vendor_available())
+    {
+        uint8_t command;
+        if (hal::usb_vendor_read(&command, 1) != 1)
+        {
+            break;
+        }
+
+        if (command == kCommandStart || command == kCommandStartCompressed)
+        {
+            g_compressed = command == kCommandStartCompressed;
+            if (g_compressed)
+            {
+                uint8_t header[capture_codec::kHeaderSize];
+                capture_codec::write_header(header);
+                g_encoder.reset();
+                hal::usb_vendor_write(header, sizeof(header));
+            }
+
+            LOG_INFO("Sensor stream started%s\n", g_compressed ? " (compressed)" : "");
+            g_dropped.store(0, std::memory_order_relaxed);
+            g_streaming.store(true, std::memory_order_relaxed);
+        }
+        else if (command == kCommandStop)
+        {
+            LOG_INFO("Sensor stream stopped, %lu frames dropped\n",
+                     static_cast<unsigned long>(g_dropped.load(std::memory_order_relaxed)));
+            g_streaming.store(false, std::memory_order_relaxed);
+        }
+        else if (command == kCommandDumpTrace && !g_dumping_trace)
+        {
+            if (trace::size() == 0)
+            {
+                LOG_WARNING("Trace dump requested but the firmware was built without MEMBRAIN_TRACE\n");
+                continue;
+            }
+
+            g_streaming.store(false, std::memory_order_relaxed);
+            trace::set_enabled(false);
+            g_trace_offset = 0;
+            g_dumping_trace = true;
+        }
+    }
+
+    if (g_dumping_trace)
+    {
+        continue_trace_dump();
+        return;
+    }
+
+    if (g_streaming.load(std::memory_order_relaxed))
+    {
+        hal::usb_vendor_flush();
+    }
+}
+
+uint32_t dropped_frames()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
+} // namespace sensor_stream
@@ -0,0 +1,136 @@
+#include "sysex.h"
+
+#include <cstring>
+
+#include "hal.h"
+#include "logging.h"
+#include "midi_scheduler.h"
+#include "usb_descriptors.h"
+
+namespace
+{
+
+sysex::Handler g_handlers[sysex::kMaxCommands] = {nullptr};
+
+uint8_t g_rx_buffer[sysex::kMaxMessageSize];
+size_t g_rx_size = 0;
+bool g_rx_overflow = false;
+
+void dispatch()
+{
+    if (g_rx_size < sysex::kHeaderSize || g_rx_buffer[1] != sysex::kManufacturerId ||
+        g_rx_buffer[2] != sysex::kDeviceId)
+    {
+        return;
+    }
+
+    uint8_t command = g_rx_buffer[3];
+    if (command >= sysex::kMaxCommands || g_handlers[command] == nullptr)
+    {
+        LOG_WARNING("Unknown SysEx command 0x%02x\n", command);
+        return;
+    }
+
+    g_handlers[command](g_rx_buffer + sysex::kHeaderSize, g_rx_size - sysex::kHeaderSize);
+}
+
+void receive(uint8_t byte)
+{
+    if (byte == 0xF0)
+    {
+        g_rx_size = 0;
+        g_rx_overflow = false;
+    }
+    else if (g_rx_size == 0)
+    {
+        // Not inside a SysEx message, channel messages sent to the device are ignored.
+        return;
+    }
+
+    if (byte == 0xF7)
+    {
+        if (!g_rx_overflow)
+        {
+            dispatch();
+        }
+        else
+        {
+            LOG_WARNING("SysEx message too long, dropped\n");
+        }
+        g_rx_size = 0;
+        return;
+    }
+
+    if (g_rx_size < sysex::kMaxMessageSize)
+    {
+        g_rx_buffer[g_rx_size++] = byte;
+    }
+    else
+    {
+        g_rx_overflow = true;
+    }
+}
+} // namespace
+
+namespace sysex
+{
+void register_handler(uint8_t command, Handler handler)
+{
+    if (command < kMaxCommands)
+    {
+        g_handlers[command] = handler;
+    }
+}
+
+void poll()
+{
+    uint8_t buffer[16];
+    while (hal::usb_midi_available())
+    {
+        uint32_t count = hal::usb_midi_read(buffer, sizeof(buffer));
+        if (count == 0)
+        {
+            break;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            receive(buffer[i]);
+        }
+    }
+}
+
+void send(uint8_t command, const uint8_t* payload, size_t size)
+{
+    send(command, payload, size, MIDI_CABLE_DIAGNOSTICS, hal::time_us());
+}
+
+void send(uint8_t command, const uint8_t* payload, size_t size, uint8_t cable, uint32_t timestamp_us)
+{
+    uint8_t msg[kMaxMessageSize];
+    if (size + kHeaderSize + 1 > kMaxMessageSize)
+    {
+        LOG_ERROR("SysEx reply too long\n");
+        return;
+    }
+
+    msg[0] = 0xF0;
+    msg[1] = kManufacturerId;
+    msg[2] = kDeviceId;
+    msg[3] = command & 0x7F;
+    memcpy(msg + kHeaderSize, payload, size);
+    msg[kHeaderSize + size] = 0xF7;
+
+    midi_scheduler::push_sysex(timestamp_us, cable, msg, kHeaderSize + size + 1);
+}
+
+uint8_t* encode_u32(uint32_t value, uint8_t* out)
+{
+    for (size_t i = 0; i < kEncodedU32Size; ++i)
+    {
+        *out++ = value & 0x7F;
+        value >>= 7;
+    }
+    return out;
+}
+} // namespace sysex
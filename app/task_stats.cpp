@@ -0,0 +1,261 @@
+#include "task_stats.h"
+
+#include <cstring>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hal.h"
+#include "logging.h"
+#include "sysex.h"
+
+namespace
+{
+static_assert(configNUMBER_OF_CORES <= task_stats::kMaxCores, "Idle time is kept for at most kMaxCores cores");
+
+// MainThread, UsbMidiTask, LedTask and LogTask, an idle task per core and the timer service task. The rest of
+// kMaxTasks is room for tasks added later.
+constexpr size_t kExpectedTasks = 4 + configNUMBER_OF_CORES + (configUSE_TIMERS ? 1 : 0);
+static_assert(kExpectedTasks <= task_stats::kMaxTasks, "kMaxTasks must cover every task the firmware creates");
+
+// TaskStats request flags
+constexpr uint8_t kFlagLog = 0x01;
+
+// TaskStats reply records, one message each
+constexpr uint8_t kRecordSystem = 0;
+constexpr uint8_t kRecordTask = 1;
+
+// Run time counters at the previous sample, matched by task number since tasks can be created and deleted between
+// samples
+struct Baseline
+{
+    UBaseType_t task_number;
+    configRUN_TIME_COUNTER_TYPE run_time;
+    bool low_stack_reported;
+};
+
+task_stats::SystemSample g_latest = {};
+Baseline g_baselines[task_stats::kMaxTasks] = {};
+size_t g_baseline_count = 0;
+configRUN_TIME_COUNTER_TYPE g_last_total_run_time = 0;
+uint32_t g_last_sample_ms = 0;
+bool g_started = false;
+bool g_too_many_tasks_reported = false;
+
+// Scratch space of sample(), kept off the MIDI task's stack
+TaskStatus_t g_statuses[task_stats::kMaxTasks];
+Baseline g_next_baselines[task_stats::kMaxTasks];
+
+uint16_t permille(configRUN_TIME_COUNTER_TYPE part, configRUN_TIME_COUNTER_TYPE total)
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+    configRUN_TIME_COUNTER_TYPE value = part * 1000 / total;
+    return value > 1000 ? 1000 : static_cast<uint16_t>(value);
+}
+
+const Baseline* find_baseline(UBaseType_t task_number)
+{
+    for (size_t i = 0; i < g_baseline_count; ++i)
+    {
+        if (g_baselines[i].task_number == task_number)
+        {
+            return &g_baselines[i];
+        }
+    }
+    return nullptr;
+}
+
+int8_t pinned_core(const TaskStatus_t& status)
+{
+#if configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
+    UBaseType_t mask = status.uxCoreAffinityMask & ((1u << configNUMBER_OF_CORES) - 1);
+    if (mask != 0 && (mask & (mask - 1)) == 0)
+    {
+        return static_cast<int8_t>(__builtin_ctz(mask));
+    }
+    return -1;
+#else
+    (void)status;
+    return 0;
+#endif
+}
+
+TaskHandle_t idle_task(size_t core)
+{
+#if configNUMBER_OF_CORES > 1
+    return xTaskGetIdleTaskHandleForCore(static_cast<BaseType_t>(core));
+#else
+    (void)core;
+    return xTaskGetIdleTaskHandle();
+#endif
+}
+
+// The SMP kernel lets an idle task run on whichever core has nothing else to do. Pinning each one to its own core
+// makes its run time that core's idle time.
+void pin_idle_tasks()
+{
+#if configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
+    for (size_t core = 0; core < configNUMBER_OF_CORES; ++core)
+    {
+        vTaskCoreAffinitySet(idle_task(core), 1u << core);
+    }
+#endif
+}
+
+void sample()
+{
+    configRUN_TIME_COUNTER_TYPE total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(g_statuses, task_stats::kMaxTasks, &total_run_time);
+    if (count == 0)
+    {
+        if (!g_too_many_tasks_reported)
+        {
+            LOG_WARNING("More than %u tasks, run time stats disabled\n", static_cast<unsigned>(task_stats::kMaxTasks));
+            g_too_many_tasks_reported = true;
+        }
+        return;
+    }
+
+    configRUN_TIME_COUNTER_TYPE elapsed = total_run_time - g_last_total_run_time;
+    g_last_total_run_time = total_run_time;
+
+    g_latest.core_count = configNUMBER_OF_CORES;
+    g_latest.task_count = count;
+    for (UBaseType_t i = 0; i < count; ++i)
+    {
+        const TaskStatus_t& status = g_statuses[i];
+        const Baseline* previous = find_baseline(status.xTaskNumber);
+
+        // A task created during the interval is charged from zero
+        configRUN_TIME_COUNTER_TYPE run_time = status.ulRunTimeCounter - (previous ? previous->run_time : 0);
+
+        task_stats::TaskSample& task = g_latest.tasks[i];
+        strncpy(task.name, status.pcTaskName, task_stats::kMaxNameLength);
+        task.name[task_stats::kMaxNameLength] = '\0';
+        task.priority = static_cast<uint8_t>(status.uxCurrentPriority);
+        task.core = pinned_core(status);
+        task.cpu_permille = permille(run_time, elapsed);
+        task.stack_free_words = status.usStackHighWaterMark;
+
+        g_next_baselines[i] = {status.xTaskNumber, status.ulRunTimeCounter, previous && previous->low_stack_reported};
+        if (task.stack_free_words < task_stats::kLowStackWords && !g_next_baselines[i].low_stack_reported)
+        {
+            LOG_WARNING("Task %s has only %lu stack words left\n", task.name,
+                        static_cast<unsigned long>(task.stack_free_words));
+            g_next_baselines[i].low_stack_reported = true;
+        }
+
+        for (size_t core = 0; core < configNUMBER_OF_CORES; ++core)
+        {
+            if (status.xHandle == idle_task(core))
+            {
+                g_latest.idle_permille[core] = task.cpu_permille;
+            }
+        }
+    }
+    memcpy(g_baselines, g_next_baselines, sizeof(Baseline) * count);
+    g_baseline_count = count;
+
+    g_latest.heap_free_bytes = xPortGetFreeHeapSize();
+    g_latest.heap_min_free_bytes = xPortGetMinimumEverFreeHeapSize();
+}
+
+// Payload: optional flags byte. Reply: a system record followed by one record per task.
+//   system: 0 <core count> <idle permille u32 per core> <free heap u32> <lowest free heap u32> <task count>
+//   task:   1 <index> <cpu permille u32> <free stack words u32> <priority> <pinned core + 1, 0 = any> <name>
+void handle_request(const uint8_t* payload, size_t size)
+{
+    uint8_t flags = size > 0 ? payload[0] : 0;
+
+    uint8_t reply[3 + (task_stats::kMaxCores + 2) * sysex::kEncodedU32Size + task_stats::kMaxNameLength];
+    uint8_t* out = reply;
+    *out++ = kRecordSystem;
+    *out++ = static_cast<uint8_t>(g_latest.core_count);
+    for (size_t core = 0; core < g_latest.core_count; ++core)
+    {
+        out = sysex::encode_u32(g_latest.idle_permille[core], out);
+    }
+    out = sysex::encode_u32(g_latest.heap_free_bytes, out);
+    out = sysex::encode_u32(g_latest.heap_min_free_bytes, out);
+    *out++ = static_cast<uint8_t>(g_latest.task_count);
+    sysex::send(sysex::TaskStats, reply, out - reply);
+
+    for (size_t i = 0; i < g_latest.task_count; ++i)
+    {
+        const task_stats::TaskSample& task = g_latest.tasks[i];
+        out = reply;
+        *out++ = kRecordTask;
+        *out++ = static_cast<uint8_t>(i);
+        out = sysex::encode_u32(task.cpu_permille, out);
+        out = sysex::encode_u32(task.stack_free_words, out);
+        *out++ = task.priority & 0x7F;
+        *out++ = static_cast<uint8_t>(task.core + 1);
+        for (const char* c = task.name; *c != '\0'; ++c)
+        {
+            *out++ = *c & 0x7F;
+        }
+        sysex::send(sysex::TaskStats, reply, out - reply);
+    }
+
+    if (flags & kFlagLog)
+    {
+        task_stats::log_summary();
+    }
+}
+} // namespace
+
+namespace task_stats
+{
+
+void init()
+{
+    sysex::register_handler(sysex::TaskStats, handle_request);
+}
+
+void poll()
+{
+    uint32_t now = hal::time_ms();
+    if (!g_started)
+    {
+        // The idle tasks only exist once the scheduler runs, which is after init()
+        pin_idle_tasks();
+        sample();
+        g_last_sample_ms = now;
+        g_started = true;
+        return;
+    }
+
+    if (now - g_last_sample_ms < kSampleIntervalMs)
+    {
+        return;
+    }
+    g_last_sample_ms = now;
+    sample();
+}
+
+const SystemSample& latest()
+{
+    return g_latest;
+}
+
+void log_summary()
+{
+    for (size_t core = 0; core < g_latest.core_count; ++core)
+    {
+        LOG_INFO("Core %u idle %u.%u%%\n", static_cast<unsigned>(core), g_latest.idle_permille[core] / 10,
+                 g_latest.idle_permille[core] % 10);
+    }
+    LOG_INFO("Heap free %lu bytes, lowest %lu bytes\n", static_cast<unsigned long>(g_latest.heap_free_bytes),
+             static_cast<unsigned long>(g_latest.heap_min_free_bytes));
+    for (size_t i = 0; i < g_latest.task_count; ++i)
+    {
+        const TaskSample& task = g_latest.tasks[i];
+        LOG_INFO("%-12s cpu %3u.%u%%  stack free %4lu words  prio %u  core %d\n", task.name, task.cpu_permille / 10,
+                 task.cpu_permille % 10, static_cast<unsigned long>(task.stack_free_words), task.priority, task.core);
+    }
+}
+
+} // namespace task_stats
@@ -0,0 +1,109 @@
+#include "telemetry.h"
+
+#include <atomic>
+
+#include "hal.h"
+#include "logging.h"
+#include "sysex.h"
+
+namespace
+{
+constexpr const char* kCounterNames[] = {
+    "I2C write errors",    "I2C read errors",       "VL6180X not ready",    "VL6180X poll timeouts",
+    "Cap-touch timeouts",  "MIDI messages dropped", "Stream frames dropped", "LED commands dropped",
+    "Log records dropped",
+};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == telemetry::kNumCounters,
+              "Every counter needs a name");
+
+std::atomic<uint32_t> g_counters[telemetry::kNumCounters];
+std::atomic<uint32_t> g_range_statuses[telemetry::kNumRangeStatuses];
+
+// Values at the previous summary. MIDI task only.
+uint32_t g_reported_counters[telemetry::kNumCounters] = {0};
+uint32_t g_reported_range_statuses[telemetry::kNumRangeStatuses] = {0};
+uint32_t g_last_summary_ms = 0;
+
+// Reply: every counter then every range status count, in enum order
+void handle_snapshot_request(const uint8_t* payload, size_t size)
+{
+    (void)payload;
+    (void)size;
+
+    uint8_t reply[(telemetry::kNumCounters + telemetry::kNumRangeStatuses) * sysex::kEncodedU32Size];
+    uint8_t* out = reply;
+    for (const auto& counter : g_counters)
+    {
+        out = sysex::encode_u32(counter.load(std::memory_order_relaxed), out);
+    }
+    for (const auto& count : g_range_statuses)
+    {
+        out = sysex::encode_u32(count.load(std::memory_order_relaxed), out);
+    }
+    sysex::send(sysex::TelemetrySnapshot, reply, sizeof(reply));
+}
+} // namespace
+
+namespace telemetry
+{
+
+void init()
+{
+    sysex::register_handler(sysex::TelemetrySnapshot, handle_snapshot_request);
+}
+
+void increment(Counter counter)
+{
+    g_counters[static_cast<size_t>(counter)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void record_range_status(uint8_t status)
+{
+    g_range_statuses[status % kNumRangeStatuses].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t get(Counter counter)
+{
+    return g_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+uint32_t range_status_count(uint8_t status)
+{
+    return g_range_statuses[status % kNumRangeStatuses].load(std::memory_order_relaxed);
+}
+
+void poll()
+{
+    uint32_t now = hal::time_ms();
+    if (now - g_last_summary_ms < kSummaryIntervalMs)
+    {
+        return;
+    }
+    g_last_summary_ms = now;
+
+    for (size_t i = 0; i < kNumCounters; ++i)
+    {
+        uint32_t value = g_counters[i].load(std::memory_order_relaxed);
+        if (value != g_reported_counters[i])
+        {
+            LOG_WARNING("%s: +%lu (%lu total)\n", kCounterNames[i],
+                        static_cast<unsigned long>(value - g_reported_counters[i]), static_cast<unsigned long>(value));
+            g_reported_counters[i] = value;
+        }
+    }
+
+    // Status 0 is a valid measurement, only the error codes are worth a line
+    for (size_t status = 1; status < kNumRangeStatuses; ++status)
+    {
+        uint32_t value = g_range_statuses[status].load(std::memory_order_relaxed);
+        if (value != g_reported_range_statuses[status])
+        {
+            LOG_WARNING("VL6180X range status %u: +%lu (%lu total)\n", static_cast<unsigned>(status),
+                        static_cast<unsigned long>(value - g_reported_range_statuses[status]),
+                        static_cast<unsigned long>(value));
+            g_reported_range_statuses[status] = value;
+        }
+    }
+}
+
+} // namespace telemetry
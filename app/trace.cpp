@@ -0,0 +1,170 @@
+#include "trace.h"
+
+#if MEMBRAIN_TRACE
+
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+namespace
+{
+static_assert(configNUMBER_OF_CORES <= trace::kMaxCores, "The trace buffer has a ring for at most kMaxCores cores");
+
+// Zero-initialized so it stays in .bss, the header is filled in by init()
+trace::Buffer g_buffer;
+
+std::atomic<bool> g_enabled{true};
+
+// Numbers are assigned at creation, the kernel leaves them at 0. Task creation runs in a critical section.
+uint16_t g_next_task_number = 1;
+std::atomic<uint16_t> g_next_queue_number{1};
+
+uint16_t task_number(void* task)
+{
+    return static_cast<uint16_t>(uxTaskGetTaskNumber(static_cast<TaskHandle_t>(task)));
+}
+
+uint16_t queue_number(void* queue)
+{
+    return static_cast<uint16_t>(uxQueueGetQueueNumber(static_cast<QueueHandle_t>(queue)));
+}
+} // namespace
+
+namespace trace
+{
+
+void record(Event event, uint16_t arg)
+{
+    if (!g_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    // An interrupt on the same core can claim the next slot between the increment and the write, the host sorts
+    // records by time
+    uint32_t core = get_core_num();
+    uint32_t index = __atomic_fetch_add(&g_buffer.header.write_index[core], 1, __ATOMIC_RELAXED);
+    Record& slot = g_buffer.records[core][index & (kRecordsPerCore - 1)];
+    slot.timestamp_us = time_us_32();
+    slot.arg = arg;
+    slot.reserved = 0;
+    slot.event = event;
+}
+
+void init()
+{
+    Header& header = g_buffer.header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.core_count = configNUMBER_OF_CORES;
+    header.records_per_core = kRecordsPerCore;
+}
+
+void set_enabled(bool enabled)
+{
+    if (!enabled)
+    {
+        g_buffer.header.dump_time_us = time_us_32();
+    }
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+const uint8_t* data()
+{
+    return reinterpret_cast<const uint8_t*>(&g_buffer);
+}
+
+size_t size()
+{
+    return sizeof(g_buffer);
+}
+
+} // namespace trace
+
+extern "C" void trace_task_create(void* task)
+{
+    if (g_next_task_number >= trace::kMaxTasks)
+    {
+        return;
+    }
+
+    uint16_t number = g_next_task_number++;
+    vTaskSetTaskNumber(static_cast<TaskHandle_t>(task), number);
+    strncpy(g_buffer.header.task_names[number], pcTaskGetName(static_cast<TaskHandle_t>(task)), trace::kTaskNameSize);
+}
+
+extern "C" void trace_task_switched_in(void* task)
+{
+    trace::record(trace::Event::TaskSwitchedIn, task_number(task));
+}
+
+extern "C" void trace_task_switched_out(void* task)
+{
+    trace::record(trace::Event::TaskSwitchedOut, task_number(task));
+}
+
+extern "C" void trace_task_notify(void* task)
+{
+    trace::record(trace::Event::TaskNotify, task_number(task));
+}
+
+extern "C" void trace_task_notify_take(int blocked)
+{
+    trace::record(blocked ? trace::Event::NotifyBlock : trace::Event::NotifyTake, 0);
+}
+
+extern "C" void trace_queue_create(void* queue)
+{
+    vQueueSetQueueNumber(static_cast<QueueHandle_t>(queue),
+                         g_next_queue_number.fetch_add(1, std::memory_order_relaxed));
+}
+
+extern "C" void trace_queue_send(void* queue)
+{
+    trace::record(trace::Event::QueueSend, queue_number(queue));
+}
+
+extern "C" void trace_queue_receive(void* queue)
+{
+    trace::record(trace::Event::QueueReceive, queue_number(queue));
+}
+
+extern "C" void trace_queue_block(void* queue)
+{
+    trace::record(trace::Event::QueueBlock, queue_number(queue));
+}
+
+#else
+
+namespace trace
+{
+
+void init()
+{
+}
+
+void set_enabled(bool enabled)
+{
+    (void)enabled;
+}
+
+const uint8_t* data()
+{
+    return nullptr;
+}
+
+size_t size()
+{
+    return 0;
+}
+
+} // namespace trace
+
+#endif
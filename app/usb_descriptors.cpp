@@ -25,6 +25,8 @@
 
 #include "tusb.h"
 
+#include "usb_descriptors.h"
+
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
  *
@@ -48,7 +50,7 @@ tusb_desc_device_t const desc_device = {.bLength = sizeof(tusb_desc_device_t),
 
                                         .idVendor = 0xCafe,
                                         .idProduct = USB_PID,
-                                        .bcdDevice = 0x0100,
+                                        .bcdDevice = 0x0120, // 1.2: vendor sensor stream interface
 
                                         .iManufacturer = 0x01,
                                         .iProduct = 0x02,
@@ -71,33 +73,64 @@ enum
 {
     ITF_NUM_MIDI = 0,
     ITF_NUM_MIDI_STREAMING,
+    ITF_NUM_VENDOR,
     ITF_NUM_TOTAL
 };
 
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_MIDI_DESC_LEN)
+// MIDI interface with one embedded IN/OUT jack pair per virtual cable
+#define MIDI_DESC_LEN(_numcables)                                                                                      \
+    (TUD_MIDI_DESC_HEAD_LEN + (_numcables) * TUD_MIDI_DESC_JACK_LEN + 2 * TUD_MIDI_DESC_EP_LEN(_numcables))
+
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + MIDI_DESC_LEN(MIDI_CABLE_COUNT) + TUD_VENDOR_DESC_LEN)
+
+// String index of the first cable name, see string_desc_arr
+#define STRID_MIDI_CABLE 4
+
+// Jack IDs in the TinyUSB macros are 1-based
+#define MIDI_DESCRIPTOR(_itfnum, _epout, _epin, _epsize)                                                               \
+    TUD_MIDI_DESC_HEAD(_itfnum, 0, MIDI_CABLE_COUNT),                                                                  \
+        TUD_MIDI_DESC_JACK_DESC(1, STRID_MIDI_CABLE + MIDI_CABLE_NOTES),                                               \
+        TUD_MIDI_DESC_JACK_DESC(2, STRID_MIDI_CABLE + MIDI_CABLE_CONTROLLERS),                                         \
+        TUD_MIDI_DESC_JACK_DESC(3, STRID_MIDI_CABLE + MIDI_CABLE_DIAGNOSTICS),                                         \
+        TUD_MIDI_DESC_EP(_epout, _epsize, MIDI_CABLE_COUNT), TUD_MIDI_JACKID_IN_EMB(1), TUD_MIDI_JACKID_IN_EMB(2),      \
+        TUD_MIDI_JACKID_IN_EMB(3), TUD_MIDI_DESC_EP(_epin, _epsize, MIDI_CABLE_COUNT), TUD_MIDI_JACKID_OUT_EMB(1),     \
+        TUD_MIDI_JACKID_OUT_EMB(2), TUD_MIDI_JACKID_OUT_EMB(3)
+
+static_assert(MIDI_CABLE_COUNT == 3, "MIDI_DESCRIPTOR lists one jack pair per cable");
 
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X || CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
 // LPC 17xx and 40xx endpoint type (bulk/interrupt/iso) are fixed by its number
 // 0 control, 1 In, 2 Bulk, 3 Iso, 4 In etc ...
-#define EPNUM_MIDI 0x02
+#define EPNUM_MIDI   0x02
+#define EPNUM_VENDOR 0x05
 #else
-#define EPNUM_MIDI 0x01
+#define EPNUM_MIDI   0x01
+#define EPNUM_VENDOR 0x02
 #endif
 
+// String index of the raw sensor stream interface, see string_desc_arr
+#define STRID_VENDOR 7
+
 uint8_t const desc_fs_configuration[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
+    // Interface number, EP Out & EP In address, EP size
+    MIDI_DESCRIPTOR(ITF_NUM_MIDI, EPNUM_MIDI, 0x80 | EPNUM_MIDI, 64),
+
     // Interface number, string index, EP Out & EP In address, EP size
-    TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 0, EPNUM_MIDI, 0x80 | EPNUM_MIDI, 64)};
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, EPNUM_VENDOR, 0x80 | EPNUM_VENDOR, 64)};
 
 #if TUD_OPT_HIGH_SPEED
 uint8_t const desc_hs_configuration[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
+    // Interface number, EP Out & EP In address, EP size
+    MIDI_DESCRIPTOR(ITF_NUM_MIDI, EPNUM_MIDI, 0x80 | EPNUM_MIDI, 512),
+
     // Interface number, string index, EP Out & EP In address, EP size
-    TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 0, EPNUM_MIDI, 0x80 | EPNUM_MIDI, 512)};
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, EPNUM_VENDOR, 0x80 | EPNUM_VENDOR, 512)};
 #endif
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
@@ -125,6 +158,10 @@ char const* string_desc_arr[] = {
     "Alex St-Onge",             // 1: Manufacturer
     "Membrain",                 // 2: Product
     "123456",                   // 3: Serials, should use chip ID
+    "Membrain Notes",           // 4: MIDI cable 0
+    "Membrain Controllers",     // 5: MIDI cable 1
+    "Membrain Diagnostics",     // 6: MIDI cable 2
+    "Membrain Sensor Stream",   // 7: Vendor interface
 };
 
 static uint16_t _desc_str[32];
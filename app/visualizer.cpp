@@ -0,0 +1,163 @@
+#include "visualizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "led_animation.h"
+#include "logging.h"
+#include "sensor_snapshot.h"
+#include "sysex.h"
+
+namespace
+{
+constexpr size_t kMaxRipples = 4;
+constexpr float kRippleSpeed = 30.f;          // Pixels per second
+constexpr float kRippleWidth = 1.2f;          // Pixels
+constexpr uint32_t kRippleLifetimeUs = 400000;
+constexpr float kPadGlowWidth = 0.8f;         // Pixels
+
+// GRB
+constexpr uint32_t kRippleColor = 0x0000FF;
+constexpr uint32_t kHallColor = 0x20FF00;
+constexpr uint32_t kPressureColor = 0xFF0000;
+
+struct Ripple
+{
+    float origin;
+    uint32_t start_us;
+    uint8_t level;
+    bool active;
+};
+
+std::atomic<bool> g_enabled{false};
+Ripple g_ripples[kMaxRipples] = {};
+size_t g_next_ripple = 0;
+uint32_t g_last_hit_count = 0;
+SensorSnapshot g_snapshot = {};
+
+void handle_visualizer(const uint8_t* payload, size_t size)
+{
+    if (size < 1)
+    {
+        return;
+    }
+    visualizer::set_enabled(payload[0] != 0);
+}
+
+uint32_t add_saturate(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+    {
+        uint32_t channel = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF);
+        result |= std::min<uint32_t>(channel, 0xFF) << shift;
+    }
+    return result;
+}
+
+void add_level(uint32_t* color, uint32_t base, float level)
+{
+    if (level <= 0.f)
+    {
+        return;
+    }
+    uint8_t scaled = static_cast<uint8_t>(std::min(level, 1.f) * led_animation::kMaxLevel);
+    *color = add_saturate(*color, led_animation::scale_color(base, scaled));
+}
+
+// Starts a ripple for every hit published since the previous frame. Only the latest hit is known, so hits closer than
+// one LED frame apart spawn a single ripple.
+void spawn_ripples(size_t count)
+{
+    if (g_snapshot.hit_count == g_last_hit_count)
+    {
+        return;
+    }
+    g_last_hit_count = g_snapshot.hit_count;
+
+    Ripple& ripple = g_ripples[g_next_ripple];
+    g_next_ripple = (g_next_ripple + 1) % kMaxRipples;
+    float position = std::clamp(sensor_math::to_float(g_snapshot.strike_position), 0.f, 1.f);
+    ripple.origin = position * static_cast<float>(count - 1);
+    ripple.start_us = g_snapshot.hit_time_us;
+    ripple.level = led_animation::kVelocityLevel[g_snapshot.hit_velocity & 0x7F];
+    ripple.active = true;
+}
+
+float ripple_level(Ripple& ripple, uint32_t now_us, float position)
+{
+    uint32_t elapsed = now_us - ripple.start_us;
+    if (elapsed >= kRippleLifetimeUs)
+    {
+        ripple.active = false;
+        return 0.f;
+    }
+
+    float radius = kRippleSpeed * static_cast<float>(elapsed) * 1e-6f;
+    float distance = std::abs(std::abs(position - ripple.origin) - radius);
+    float shape = 1.f - distance / kRippleWidth;
+    float decay = 1.f - static_cast<float>(elapsed) / kRippleLifetimeUs;
+    return shape * decay * ripple.level / led_animation::kMaxLevel;
+}
+} // namespace
+
+namespace visualizer
+{
+
+void init()
+{
+    sysex::register_handler(sysex::Visualizer, handle_visualizer);
+}
+
+bool enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void set_enabled(bool enabled)
+{
+    if (g_enabled.exchange(enabled, std::memory_order_relaxed) != enabled)
+    {
+        LOG_INFO("Visualizer %s\n", enabled ? "enabled" : "disabled");
+    }
+}
+
+void render(uint32_t now_us, uint32_t* colors, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // On a failed read the previous snapshot is reused, effects simply lag by one frame
+    if (sensor_snapshot::read(&g_snapshot))
+    {
+        spawn_ripples(count);
+    }
+
+    float hall_level = std::abs(sensor_math::to_float(g_snapshot.hall)) * 0.5f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float position = static_cast<float>(i);
+        add_level(&colors[i], kHallColor, hall_level);
+
+        for (size_t pad = 0; pad < kSnapshotPads; ++pad)
+        {
+            // Pads are spread evenly along the visualized pixels
+            float center = (pad + 0.5f) * count / kSnapshotPads - 0.5f;
+            float shape = 1.f - std::abs(position - center) / kPadGlowWidth;
+            add_level(&colors[i], kPressureColor, shape * g_snapshot.touch_pressure[pad] / 127.f);
+        }
+
+        for (auto& ripple : g_ripples)
+        {
+            if (ripple.active)
+            {
+                add_level(&colors[i], kRippleColor, ripple_level(ripple, now_us, position));
+            }
+        }
+    }
+}
+
+} // namespace visualizer
@@ -1,13 +1,8 @@
 #include "vl6180.h"
 
-#include "hardware/i2c.h"
-#include "pico/binary_info.h"
-#include "pico/stdlib.h"
-#include "pico/time.h"
-
-#include <cmath>
-
+#include "hal.h"
 #include "logging.h"
+#include "telemetry.h"
 
 #define VL6180X_ADDR 0x29
 
@@ -17,10 +12,7 @@
 
 namespace
 {
-constexpr float kA1 = 0.50;
-constexpr float kB0 = 1.f - std::abs(kA1);
-
-float g_prev_output = 0.f;
+Vl6180Sample g_last_sample = {0, VL6180X_ERROR_NONE};
 } // namespace
 
 bool read_byte(uint16_t reg, uint8_t* data)
@@ -28,17 +20,17 @@ bool read_byte(uint16_t reg, uint8_t* data)
     uint8_t data_write[2];
     data_write[0] = (reg >> 8) & 0xFF; // MSB of register address
     data_write[1] = reg & 0xFF;        // LSB of register address
-    int ret = i2c_write_blocking(i2c_default, VL6180X_ADDR, data_write, 2, true);
+    int ret = hal::i2c_write(VL6180X_ADDR, data_write, 2, true);
     if (ret < 0)
     {
-        LOG_ERROR("Failed to write to VL6180X\n");
+        telemetry::increment(telemetry::Counter::I2cWriteError);
         return false;
     }
 
-    ret = i2c_read_blocking(i2c_default, VL6180X_ADDR, data, 1, false);
+    ret = hal::i2c_read(VL6180X_ADDR, data, 1, false);
     if (ret < 0)
     {
-        LOG_ERROR("Failed to read from VL6180X\n");
+        telemetry::increment(telemetry::Counter::I2cReadError);
         return false;
     }
 
@@ -51,10 +43,10 @@ bool write_byte(uint16_t reg, uint8_t data)
     txdata[0] = uint8_t(reg >> 8);
     txdata[1] = uint8_t(reg & 0xFF);
     txdata[2] = data;
-    int ret = i2c_write_blocking(i2c_default, VL6180X_ADDR, txdata, 3, true);
+    int ret = hal::i2c_write(VL6180X_ADDR, txdata, 3, true);
     if (ret < 0)
     {
-        LOG_ERROR("Failed to write to VL6180X\n");
+        telemetry::increment(telemetry::Counter::I2cWriteError);
         return false;
     }
 
@@ -140,14 +132,14 @@ bool poll_range()
     return (status & 0x04);
 }
 
-float read_range()
+bool read_range()
 {
     uint8_t status;
     read_byte(VL6180X_REG_RESULT_RANGE_STATUS, &status);
     if (!(status & 0x01))
     {
-        LOG_ERROR("Range status not ready\n");
-        return 0.f;
+        telemetry::increment(telemetry::Counter::RangeNotReady);
+        return false;
     }
 
     write_byte(VL6180X_REG_SYSRANGE_START, 0x01);
@@ -156,12 +148,12 @@ float read_range()
     uint8_t polls = 0;
     while (!poll_range())
     {
-        sleep_ms(1);
+        hal::sleep_ms(1);
         polls++;
         if (polls > kMaxPolls)
         {
-            LOG_ERROR("Range poll timeout\n");
-            return 0.f;
+            telemetry::increment(telemetry::Counter::RangePollTimeout);
+            return false;
         }
     }
 
@@ -173,24 +165,15 @@ float read_range()
     uint8_t range_status;
     read_byte(VL6180X_REG_RESULT_RANGE_STATUS, &range_status);
     range_status = range_status >> 4;
-    if (range_status != 0)
-    {
-        LOG_ERROR("Range status: %d\n", range_status);
-    }
-
-    g_prev_output = kB0 * static_cast<float>(range) + g_prev_output * kA1;
-    return g_prev_output;
+    g_last_sample.range_mm = range;
+    g_last_sample.status = range_status;
+    telemetry::record_range_status(range_status);
+    return true;
 }
 
 bool init_vl6180x()
 {
-    i2c_init(i2c_default, 100 * 1000);
-    gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
-    gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
-    // Make the I2C pins available to picotool
-    bi_decl(bi_2pins_with_func(PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C));
+    hal::i2c_init(100 * 1000);
 
     uint8_t rxdata;
     if (read_byte(VL6180X_REG_IDENTIFICATION_MODEL_ID, &rxdata) == false)
@@ -229,7 +212,12 @@ bool init_vl6180x()
     return true;
 }
 
-float vl6180_read()
+bool vl6180_read()
 {
     return read_range();
+}
+
+Vl6180Sample vl6180_last_sample()
+{
+    return g_last_sample;
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "ws2812_parallel.h"
+
+#include "pico/stdlib.h"
+#include "pico/time.h"
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "ws2812.pio.h"
+
+#include <atomic>
+
+#include "logging.h"
+#include "trace.h"
+
+namespace
+{
+constexpr uint32_t kBitsPerPixel = 24;
+constexpr uint32_t kPlanesPerFrame = ws2812_parallel::kMaxPixelsPerStrip * kBitsPerPixel;
+constexpr uint32_t kResetTimeUs = 400;
+constexpr float kBitRate = 800000;
+
+PIO g_pio = nullptr;
+uint g_sm = 0;
+int g_dma_channel = -1;
+uint32_t g_strip_count = 0;
+uint32_t g_pixels_per_strip = 0;
+
+// Colors as set by the caller, one row per strip. Unused strips stay black.
+uint32_t g_pixels[ws2812_parallel::kMaxStrips][ws2812_parallel::kMaxPixelsPerStrip] = {0};
+
+// One word per bit time, bit n of a word is the level of strip n. Only rewritten once the previous frame is sent.
+uint32_t g_planes[kPlanesPerFrame] = {0};
+std::atomic<bool> g_busy{false};
+
+// Set when no alarm was free to end the reset time, busy() then checks it against the DMA completion time
+std::atomic<bool> g_reset_unscheduled{false};
+uint32_t g_dma_complete_us = 0;
+
+// Transposes an 8x8 bit matrix stored one row per byte (Hacker's Delight, 7-3)
+inline uint64_t transpose8(uint64_t x)
+{
+    uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+// Writes the 24 planes of one pixel index, MSB first as the strips expect it
+void transpose_pixel(uint32_t index, uint32_t* planes)
+{
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+        uint64_t rows = 0;
+        for (uint32_t strip = 0; strip < ws2812_parallel::kMaxStrips; ++strip)
+        {
+            rows |= static_cast<uint64_t>((g_pixels[strip][index] >> shift) & 0xFF) << (8 * strip);
+        }
+
+        // After the transpose byte n holds bit n of every strip
+        uint64_t columns = transpose8(rows);
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            *planes++ = static_cast<uint32_t>((columns >> (8 * bit)) & 0xFF);
+        }
+    }
+}
+
+int64_t reset_complete(alarm_id_t id, void* user_data)
+{
+    (void)id;
+    (void)user_data;
+    trace::isr_enter(trace::Isr::LedResetAlarm);
+    g_busy.store(false, std::memory_order_release);
+    trace::isr_exit(trace::Isr::LedResetAlarm);
+    return 0;
+}
+
+void __isr dma_complete_handler()
+{
+    if (g_dma_channel < 0 || !dma_channel_get_irq0_status(g_dma_channel))
+    {
+        return;
+    }
+
+    trace::isr_enter(trace::Isr::LedDma);
+    dma_channel_acknowledge_irq0(g_dma_channel);
+    if (add_alarm_in_us(kResetTimeUs, reset_complete, nullptr, true) < 0)
+    {
+        g_dma_complete_us = time_us_32();
+        g_reset_unscheduled.store(true, std::memory_order_release);
+    }
+    trace::isr_exit(trace::Isr::LedDma);
+}
+} // namespace
+
+namespace ws2812_parallel
+{
+
+bool init(PIO pio, uint32_t pin_base, uint32_t strip_count, uint32_t pixels_per_strip)
+{
+    if (strip_count == 0 || strip_count > kMaxStrips || pixels_per_strip == 0 || pixels_per_strip > kMaxPixelsPerStrip)
+    {
+        LOG_ERROR("Invalid parallel strip layout: %u strips of %u pixels\n", static_cast<unsigned>(strip_count),
+                  static_cast<unsigned>(pixels_per_strip));
+        return false;
+    }
+
+    int sm = pio_can_add_program(pio, &ws2812_parallel_program) ? pio_claim_unused_sm(pio, false) : -1;
+    if (sm < 0)
+    {
+        LOG_ERROR("No PIO resources left for the parallel strips\n");
+        return false;
+    }
+
+    g_pio = pio;
+    g_sm = static_cast<uint>(sm);
+    g_strip_count = strip_count;
+    g_pixels_per_strip = pixels_per_strip;
+
+    uint offset = pio_add_program(g_pio, &ws2812_parallel_program);
+    ws2812_parallel_program_init(g_pio, g_sm, offset, pin_base, strip_count, kBitRate);
+
+    g_dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(g_dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, pio_get_dreq(g_pio, g_sm, true));
+    dma_channel_configure(g_dma_channel, &config, &g_pio->txf[g_sm], nullptr, 0, false);
+
+    irq_add_shared_handler(DMA_IRQ_0, dma_complete_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq0_enabled(g_dma_channel, true);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    LOG_INFO("Parallel WS2812 output: %u strips of %u pixels from pin %u\n", static_cast<unsigned>(strip_count),
+             static_cast<unsigned>(pixels_per_strip), static_cast<unsigned>(pin_base));
+    return true;
+}
+
+uint32_t strip_count()
+{
+    return g_strip_count;
+}
+
+uint32_t pixels_per_strip()
+{
+    return g_pixels_per_strip;
+}
+
+void set_pixel(uint32_t strip, uint32_t index, uint32_t grb)
+{
+    if (strip < g_strip_count && index < g_pixels_per_strip)
+    {
+        g_pixels[strip][index] = grb;
+    }
+}
+
+bool busy()
+{
+    if (!g_busy.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    if (g_reset_unscheduled.load(std::memory_order_acquire) && time_us_32() - g_dma_complete_us >= kResetTimeUs)
+    {
+        g_reset_unscheduled.store(false, std::memory_order_relaxed);
+        g_busy.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void show()
+{
+    if (g_dma_channel < 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < g_pixels_per_strip; ++i)
+    {
+        transpose_pixel(i, g_planes + i * kBitsPerPixel);
+    }
+
+    g_busy.store(true, std::memory_order_relaxed);
+    dma_channel_transfer_from_buffer_now(g_dma_channel, g_planes, g_pixels_per_strip * kBitsPerPixel);
+}
+
+} // namespace ws2812_parallel
@@ -0,0 +1,250 @@
+// Runs the kernel microbenchmarks of app/bench_cases.cpp on the host. The report follows Google Benchmark, console and
+// JSON, so its tools (compare.py) can diff two runs. The same benchmarks run on the board in the MembrainBench image,
+// which counts cycles instead.
+//
+// Usage: membrain_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]
+//                       [--benchmark_format=console|json] [--benchmark_out=<file>]
+//   --benchmark_filter    Only runs the benchmarks whose name matches
+//   --benchmark_min_time  Time each benchmark runs for at least, 0.5 s by default. A trailing 's' is accepted.
+//   --benchmark_format    Format of the report on stdout
+//   --benchmark_out       Also writes the JSON report to a file
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+
+namespace
+{
+constexpr uint64_t kMaxIterations = 1000000000;
+
+struct Result
+{
+    const char* name;
+    uint64_t iterations;
+    double real_ns; // Per iteration
+    double cpu_ns;
+};
+
+struct Options
+{
+    std::string filter = ".*";
+    double min_time_s = 0.5;
+    bool json = false;
+    std::string out_path;
+};
+
+double cpu_seconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Grows the iteration count until one run lasts min_time_s, like Google Benchmark: aim 40% past the target from the
+// last run, at most ten times more iterations at once
+Result measure(const bench::Benchmark& benchmark, double min_time_s)
+{
+    uint64_t iterations = 1;
+    while (true)
+    {
+        const double cpu_start = cpu_seconds();
+        const auto start = std::chrono::steady_clock::now();
+        benchmark.run(static_cast<uint32_t>(iterations));
+        const std::chrono::duration<double> real = std::chrono::steady_clock::now() - start;
+        const double cpu = cpu_seconds() - cpu_start;
+
+        if (real.count() >= min_time_s || iterations >= kMaxIterations)
+        {
+            return {benchmark.name, iterations, real.count() * 1e9 / iterations, cpu * 1e9 / iterations};
+        }
+
+        double multiplier = real.count() > 0 ? min_time_s * 1.4 / real.count() : 10.0;
+        multiplier = std::min(multiplier, 10.0);
+        uint64_t next = static_cast<uint64_t>(iterations * multiplier);
+        iterations = std::min(std::max(next, iterations + 1), kMaxIterations);
+    }
+}
+
+std::string date()
+{
+    char buffer[32];
+    time_t now = time(nullptr);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    return buffer;
+}
+
+bool optimized()
+{
+#ifdef __OPTIMIZE__
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Three significant digits for small values, like the Google Benchmark console
+void print_time(double ns)
+{
+    printf(ns < 10 ? "%10.2f ns" : ns < 100 ? "%10.1f ns" : "%10.0f ns", ns);
+}
+
+void print_console(const std::vector<Result>& results, const char* executable)
+{
+    size_t name_width = 10;
+    for (const Result& result : results)
+    {
+        name_width = std::max(name_width, strlen(result.name));
+    }
+
+    printf("%s\nRunning %s\n", date().c_str(), executable);
+    if (!optimized())
+    {
+        printf("***WARNING*** Library was built as DEBUG. Timings may be affected.\n");
+    }
+
+    const std::string rule(name_width + 43, '-');
+    printf("%s\n%-*s %13s %15s %12s\n%s\n", rule.c_str(), static_cast<int>(name_width), "Benchmark", "Time", "CPU",
+           "Iterations", rule.c_str());
+    for (const Result& result : results)
+    {
+        printf("%-*s ", static_cast<int>(name_width), result.name);
+        print_time(result.real_ns);
+        printf("  ");
+        print_time(result.cpu_ns);
+        printf(" %12llu\n", static_cast<unsigned long long>(result.iterations));
+    }
+}
+
+void write_json(FILE* file, const std::vector<Result>& results, const char* executable)
+{
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date().c_str());
+    fprintf(file, "    \"executable\": \"%s\",\n", executable);
+    fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(file, "    \"library_build_type\": \"%s\"\n", optimized() ? "release" : "debug");
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result.name);
+        fprintf(file, "      \"run_name\": \"%s\",\n", result.name);
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"repetitions\": 1,\n");
+        fprintf(file, "      \"repetition_index\": 0,\n");
+        fprintf(file, "      \"threads\": 1,\n");
+        fprintf(file, "      \"iterations\": %llu,\n", static_cast<unsigned long long>(result.iterations));
+        fprintf(file, "      \"real_time\": %.4e,\n", result.real_ns);
+        fprintf(file, "      \"cpu_time\": %.4e,\n", result.cpu_ns);
+        fprintf(file, "      \"time_unit\": \"ns\"\n");
+        fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+bool parse_option(const char* arg, const char* name, std::string* value)
+{
+    const size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+    {
+        return false;
+    }
+    *value = arg + length + 1;
+    return true;
+}
+
+bool parse_options(int argc, char** argv, Options* options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string value;
+        if (parse_option(argv[i], "--benchmark_filter", &value))
+        {
+            options->filter = value;
+        }
+        else if (parse_option(argv[i], "--benchmark_min_time", &value))
+        {
+            options->min_time_s = atof(value.c_str());
+        }
+        else if (parse_option(argv[i], "--benchmark_format", &value) && (value == "console" || value == "json"))
+        {
+            options->json = value == "json";
+        }
+        else if (parse_option(argv[i], "--benchmark_out", &value))
+        {
+            options->out_path = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, &options))
+    {
+        fprintf(stderr,
+                "Usage: %s [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]\n"
+                "       [--benchmark_format=console|json] [--benchmark_out=<file>]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::regex filter;
+    try
+    {
+        filter = std::regex(options.filter);
+    }
+    catch (const std::regex_error&)
+    {
+        fprintf(stderr, "Invalid filter %s\n", options.filter.c_str());
+        return 1;
+    }
+
+    size_t count;
+    const bench::Benchmark* benchmarks = bench::benchmarks(&count);
+    std::vector<Result> results;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (std::regex_search(benchmarks[i].name, filter))
+        {
+            results.push_back(measure(benchmarks[i], options.min_time_s));
+        }
+    }
+
+    if (options.json)
+    {
+        write_json(stdout, results, argv[0]);
+    }
+    else
+    {
+        print_console(results, argv[0]);
+    }
+
+    if (!options.out_path.empty())
+    {
+        FILE* file = fopen(options.out_path.c_str(), "w");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "Failed to write %s\n", options.out_path.c_str());
+            return 1;
+        }
+        write_json(file, results, argv[0]);
+        fclose(file);
+    }
+    return 0;
+}
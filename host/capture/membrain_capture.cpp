@@ -0,0 +1,236 @@
+// Captures the raw sensor stream from the Membrain vendor interface into a file.
+//
+// Usage: membrain_capture [-c] <output file> [seconds]
+//        membrain_capture -t <output file>
+// Without a duration the capture runs until Ctrl-C. The file contains the stream exactly as sent by the device: raw
+// frames (sensor_stream_format.h) or, with -c, the delta-encoded capture format (capture_codec.h). Use membrain_decode
+// to expand either one.
+// With -t the device's scheduler trace buffer (trace_format.h) is saved instead, for membrain_trace. The firmware must be
+// built with MEMBRAIN_TRACE.
+
+#include <libusb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "sensor_stream_format.h"
+#include "trace_format.h"
+
+namespace
+{
+constexpr uint16_t kVendorId = 0xCafe;
+constexpr uint16_t kProductId = 0x4018; // MIDI + vendor, see usb_descriptors.cpp
+constexpr uint8_t kInterface = 2;       // ITF_NUM_VENDOR
+constexpr unsigned char kEndpointOut = 0x02;
+constexpr unsigned char kEndpointIn = 0x82;
+constexpr int kTimeoutMs = 100;
+constexpr int kTransferSize = 16 * 1024;
+constexpr int kTraceIdleTimeoutMs = 2000;
+
+std::atomic<bool> g_running{true};
+
+void handle_signal(int)
+{
+    g_running = false;
+}
+
+bool send_command(libusb_device_handle* handle, uint8_t command)
+{
+    int transferred = 0;
+    int ret = libusb_bulk_transfer(handle, kEndpointOut, &command, 1, &transferred, kTimeoutMs);
+    if (ret != 0 || transferred != 1)
+    {
+        fprintf(stderr, "Failed to send command '%c': %s\n", command, libusb_error_name(ret));
+        return false;
+    }
+    return true;
+}
+
+// Reads the trace buffer, whose size is known once its header arrived
+bool dump_trace(libusb_device_handle* handle, FILE* output)
+{
+    // Stream frames still in flight from an earlier capture would precede the dump
+    static unsigned char buffer[kTransferSize];
+    int transferred = 0;
+    send_command(handle, sensor_stream::kCommandStop);
+    while (libusb_bulk_transfer(handle, kEndpointIn, buffer, sizeof(buffer), &transferred, kTimeoutMs) == 0)
+    {
+    }
+
+    if (!send_command(handle, sensor_stream::kCommandDumpTrace))
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> dump;
+    size_t expected = sizeof(trace::Header);
+    bool have_header = false;
+    int idle_ms = 0;
+    while (dump.size() < expected && g_running)
+    {
+        int ret = libusb_bulk_transfer(handle, kEndpointIn, buffer, sizeof(buffer), &transferred, kTimeoutMs);
+        if (ret != 0 && ret != LIBUSB_ERROR_TIMEOUT)
+        {
+            fprintf(stderr, "Bulk transfer failed: %s\n", libusb_error_name(ret));
+            return false;
+        }
+        if (transferred == 0)
+        {
+            idle_ms += kTimeoutMs;
+            if (idle_ms >= kTraceIdleTimeoutMs)
+            {
+                fprintf(stderr, dump.empty() ? "No trace received, is the firmware built with MEMBRAIN_TRACE?\n"
+                                             : "Trace dump stopped after %zu bytes\n",
+                        dump.size());
+                return false;
+            }
+            continue;
+        }
+        idle_ms = 0;
+        dump.insert(dump.end(), buffer, buffer + transferred);
+
+        if (!have_header && dump.size() >= sizeof(trace::Header))
+        {
+            trace::Header header;
+            memcpy(&header, dump.data(), sizeof(header));
+            if (header.magic != trace::kMagic || header.version != trace::kVersion)
+            {
+                fprintf(stderr, "Unexpected trace header, version %u expected\n", static_cast<unsigned>(trace::kVersion));
+                return false;
+            }
+            expected = sizeof(trace::Header) + trace::kMaxCores * header.records_per_core * sizeof(trace::Record);
+            have_header = true;
+        }
+    }
+
+    fwrite(dump.data(), 1, std::min(dump.size(), expected), output);
+    return dump.size() >= expected;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    bool compressed = false;
+    bool trace_dump = false;
+    if (arg < argc && strcmp(argv[arg], "-c") == 0)
+    {
+        compressed = true;
+        ++arg;
+    }
+    else if (arg < argc && strcmp(argv[arg], "-t") == 0)
+    {
+        trace_dump = true;
+        ++arg;
+    }
+
+    if (arg >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-c] <output file> [seconds]\n       %s -t <output file>\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[arg];
+    const double duration = arg + 1 < argc ? atof(argv[arg + 1]) : 0.0;
+
+    FILE* output = fopen(path, "wb");
+    if (output == nullptr)
+    {
+        perror("Failed to open output file");
+        return 1;
+    }
+
+    if (libusb_init(nullptr) != 0)
+    {
+        fprintf(stderr, "Failed to initialize libusb\n");
+        return 1;
+    }
+
+    libusb_device_handle* handle = libusb_open_device_with_vid_pid(nullptr, kVendorId, kProductId);
+    if (handle == nullptr)
+    {
+        fprintf(stderr, "Membrain not found (%04x:%04x)\n", kVendorId, kProductId);
+        libusb_exit(nullptr);
+        return 1;
+    }
+
+    libusb_set_auto_detach_kernel_driver(handle, 1);
+    int ret = libusb_claim_interface(handle, kInterface);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Failed to claim interface %d: %s\n", kInterface, libusb_error_name(ret));
+        libusb_close(handle);
+        libusb_exit(nullptr);
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+
+    if (trace_dump)
+    {
+        bool ok = dump_trace(handle, output);
+        if (ok)
+        {
+            fprintf(stderr, "Saved the trace to %s, convert it with membrain_trace\n", path);
+        }
+        fclose(output);
+        libusb_release_interface(handle, kInterface);
+        libusb_close(handle);
+        libusb_exit(nullptr);
+        return ok ? 0 : 1;
+    }
+
+    static unsigned char buffer[kTransferSize];
+    size_t total_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+
+    if (send_command(handle, compressed ? sensor_stream::kCommandStartCompressed : sensor_stream::kCommandStart))
+    {
+        while (g_running)
+        {
+            int transferred = 0;
+            ret = libusb_bulk_transfer(handle, kEndpointIn, buffer, sizeof(buffer), &transferred, kTimeoutMs);
+            if (ret != 0 && ret != LIBUSB_ERROR_TIMEOUT)
+            {
+                fprintf(stderr, "Bulk transfer failed: %s\n", libusb_error_name(ret));
+                break;
+            }
+
+            if (transferred > 0)
+            {
+                fwrite(buffer, 1, transferred, output);
+                total_bytes += transferred;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed = now - start;
+            if (duration > 0.0 && elapsed.count() >= duration)
+            {
+                break;
+            }
+
+            if (now - last_report >= std::chrono::seconds(1))
+            {
+                fprintf(stderr, "\r%zu bytes, %.1f kB/s   ", total_bytes, total_bytes / 1000.0 / elapsed.count());
+                last_report = now;
+            }
+        }
+
+        send_command(handle, sensor_stream::kCommandStop);
+    }
+
+    fprintf(stderr, "\nCaptured %zu bytes to %s\n", total_bytes, path);
+
+    fclose(output);
+    libusb_release_interface(handle, kInterface);
+    libusb_close(handle);
+    libusb_exit(nullptr);
+    return 0;
+}
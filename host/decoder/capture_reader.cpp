@@ -0,0 +1,189 @@
+#include "capture_reader.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "sensor_stream_format.h"
+
+bool CaptureReader::open(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    data_.clear();
+    uint8_t buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data_.insert(data_.end(), buffer, buffer + read);
+    }
+    fclose(file);
+
+    offset_ = 0;
+    skipped_ = 0;
+    raw_timestamp_ = 0;
+    raw_has_timestamp_ = false;
+    decoder_.reset();
+
+    if (capture_codec::check_header(data_.data(), data_.size()))
+    {
+        format_ = Format::Compressed;
+        offset_ = capture_codec::kHeaderSize;
+    }
+    else
+    {
+        format_ = Format::Raw;
+    }
+    return true;
+}
+
+CaptureReader::Format CaptureReader::format() const
+{
+    return format_;
+}
+
+bool CaptureReader::next(capture_codec::Record* record)
+{
+    return format_ == Format::Compressed ? next_compressed(record) : next_raw(record);
+}
+
+size_t CaptureReader::skipped_bytes() const
+{
+    return skipped_;
+}
+
+bool CaptureReader::next_raw(capture_codec::Record* record)
+{
+    using namespace sensor_stream;
+
+    while (offset_ + sizeof(FrameHeader) <= data_.size())
+    {
+        FrameHeader header;
+        memcpy(&header, data_.data() + offset_, sizeof(header));
+
+        const uint8_t* payload = data_.data() + offset_ + sizeof(header);
+        const bool complete = offset_ + sizeof(header) + header.size <= data_.size();
+        bool known = header.magic == kFrameMagic && complete;
+
+        if (known)
+        {
+            switch (header.source)
+            {
+            case Source::Hall:
+            {
+                HallPayload hall;
+                known = header.size == sizeof(hall);
+                if (known)
+                {
+                    memcpy(&hall, payload, sizeof(hall));
+                    record->stream = capture_codec::Hall;
+                    record->count = 3;
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        record->values[i] = hall.adc[i];
+                    }
+                }
+                break;
+            }
+            case Source::CapTouch:
+            {
+                CapTouchPayload touch;
+                known = header.size == sizeof(touch);
+                if (known)
+                {
+                    memcpy(&touch, payload, sizeof(touch));
+                    known = touch.pad < capture_codec::kNumCapTouchStreams;
+                    record->stream = capture_codec::CapTouch0 + touch.pad;
+                    record->count = 1;
+                    record->values[0] = static_cast<int32_t>(touch.total);
+                }
+                break;
+            }
+            case Source::Range:
+            {
+                RangePayload range;
+                known = header.size == sizeof(range);
+                if (known)
+                {
+                    memcpy(&range, payload, sizeof(range));
+                    record->stream = capture_codec::Range;
+                    record->count = 2;
+                    record->values[0] = range.range_mm;
+                    record->values[1] = range.status;
+                }
+                break;
+            }
+            default:
+                known = false;
+                break;
+            }
+        }
+
+        if (!known)
+        {
+            if (!complete && header.magic == kFrameMagic)
+            {
+                // Truncated last frame
+                skipped_ += data_.size() - offset_;
+                offset_ = data_.size();
+                return false;
+            }
+
+            // Resynchronize on the next magic byte
+            ++offset_;
+            ++skipped_;
+            continue;
+        }
+
+        // Extend the 32-bit device clock
+        raw_timestamp_ = raw_has_timestamp_
+                             ? raw_timestamp_ + (header.timestamp_us - static_cast<uint32_t>(raw_timestamp_))
+                             : header.timestamp_us;
+        raw_has_timestamp_ = true;
+
+        record->timestamp_us = raw_timestamp_;
+        record->keyframe = true;
+        record->valid = true;
+        offset_ += sizeof(header) + header.size;
+        return true;
+    }
+
+    skipped_ += data_.size() - offset_;
+    offset_ = data_.size();
+    return false;
+}
+
+bool CaptureReader::next_compressed(capture_codec::Record* record)
+{
+    while (offset_ < data_.size())
+    {
+        int read = decoder_.decode(data_.data() + offset_, data_.size() - offset_, record);
+        if (read == 0)
+        {
+            // Truncated last record
+            skipped_ += data_.size() - offset_;
+            offset_ = data_.size();
+            return false;
+        }
+
+        if (read < 0)
+        {
+            // Corrupted data: skip a byte and wait for the next keyframe of each stream
+            decoder_.resync();
+            ++offset_;
+            ++skipped_;
+            continue;
+        }
+
+        offset_ += read;
+        if (record->valid)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
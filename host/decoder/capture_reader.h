@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture_codec.h"
+
+// Reads a capture file written by membrain_capture, either raw sensor frames or the compressed capture_codec format,
+// and expands it into records. Raw frames are mapped onto the capture_codec stream IDs so both formats decode to the
+// same representation.
+class CaptureReader
+{
+  public:
+    enum class Format
+    {
+        Raw,
+        Compressed
+    };
+
+    bool open(const std::string& path);
+
+    Format format() const;
+
+    // Returns false at the end of the capture
+    bool next(capture_codec::Record* record);
+
+    // Number of bytes skipped because they could not be decoded
+    size_t skipped_bytes() const;
+
+  private:
+    bool next_raw(capture_codec::Record* record);
+    bool next_compressed(capture_codec::Record* record);
+
+    std::vector<uint8_t> data_;
+    size_t offset_ = 0;
+    size_t skipped_ = 0;
+    Format format_ = Format::Raw;
+    uint64_t raw_timestamp_ = 0;
+    bool raw_has_timestamp_ = false;
+    capture_codec::Decoder decoder_;
+};
@@ -0,0 +1,114 @@
+// Expands a Membrain capture (raw frames or compressed) into CSV or NumPy.
+//
+// Usage: membrain_decode <capture file> <output.csv|output.npy>
+// Both outputs have one row per sample with the columns timestamp_us, stream, v0, v1, v2. Stream IDs are the
+// capture_codec::StreamId values (0 = Hall, 1-7 = cap-touch pads, 8 = range). Unused value columns are 0.
+// The NumPy file holds a 2D little endian int64 array.
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "capture_reader.h"
+
+namespace
+{
+constexpr size_t kNumColumns = 2 + capture_codec::kMaxValues;
+
+bool ends_with(const std::string& value, const std::string& suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool write_csv(const std::string& path, const std::vector<int64_t>& rows)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "timestamp_us,stream,v0,v1,v2\n");
+    for (size_t i = 0; i < rows.size(); i += kNumColumns)
+    {
+        fprintf(file, "%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 "\n", rows[i], rows[i + 1],
+                rows[i + 2], rows[i + 3], rows[i + 4]);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// NPY format version 1.0: magic, version, header length, python dict header padded to 64 bytes, raw data
+bool write_npy(const std::string& path, const std::vector<int64_t>& rows)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    char dict[128];
+    int dict_size = snprintf(dict, sizeof(dict), "{'descr': '<i8', 'fortran_order': False, 'shape': (%zu, %zu), }",
+                             rows.size() / kNumColumns, kNumColumns);
+    std::string header(dict, dict_size);
+    const size_t preamble = 10;
+    while ((preamble + header.size() + 1) % 64 != 0)
+    {
+        header += ' ';
+    }
+    header += '\n';
+
+    const uint8_t magic[] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0};
+    const uint16_t header_size = static_cast<uint16_t>(header.size());
+    fwrite(magic, 1, sizeof(magic), file);
+    fwrite(&header_size, sizeof(header_size), 1, file);
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(rows.data(), sizeof(int64_t), rows.size(), file);
+
+    fclose(file);
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <capture file> <output.csv|output.npy>\n", argv[0]);
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<int64_t> rows;
+    capture_codec::Record record;
+    while (reader.next(&record))
+    {
+        rows.push_back(static_cast<int64_t>(record.timestamp_us));
+        rows.push_back(record.stream);
+        for (size_t i = 0; i < capture_codec::kMaxValues; ++i)
+        {
+            rows.push_back(i < record.count ? record.values[i] : 0);
+        }
+    }
+
+    const std::string output = argv[2];
+    const bool ok = ends_with(output, ".npy") ? write_npy(output, rows) : write_csv(output, rows);
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(stderr, "%s capture: %zu samples, %zu bytes skipped\n",
+            reader.format() == CaptureReader::Format::Compressed ? "Compressed" : "Raw", rows.size() / kNumColumns,
+            reader.skipped_bytes());
+    return 0;
+}
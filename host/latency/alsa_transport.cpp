@@ -0,0 +1,207 @@
+#include "alsa_transport.h"
+
+#include <alsa/asoundlib.h>
+#include <poll.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+
+namespace membrain
+{
+
+namespace
+{
+constexpr const char* kDeviceName = "Membrain";
+constexpr long kDecodeBufferSize = 256;
+} // namespace
+
+struct AlsaTransport::State
+{
+    snd_seq_t* seq = nullptr;
+    snd_midi_event_t* decoder = nullptr;
+    int port = -1;
+    int queue = -1;
+    snd_seq_addr_t output = {};
+
+    // SysEx can arrive split over several events, keyed by source port
+    std::map<std::pair<int, int>, std::vector<uint8_t>> partial_sysex;
+};
+
+AlsaTransport::AlsaTransport(std::unique_ptr<State> state) : state_(std::move(state))
+{
+}
+
+AlsaTransport::~AlsaTransport()
+{
+    if (state_->decoder != nullptr)
+    {
+        snd_midi_event_free(state_->decoder);
+    }
+    if (state_->seq != nullptr)
+    {
+        snd_seq_close(state_->seq);
+    }
+}
+
+std::unique_ptr<AlsaTransport> AlsaTransport::open()
+{
+    // Owns the sequencer from here on so every early return closes it
+    std::unique_ptr<AlsaTransport> transport(new AlsaTransport(std::make_unique<State>()));
+    State& s = *transport->state_;
+    if (snd_seq_open(&s.seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0)
+    {
+        fprintf(stderr, "Failed to open the ALSA sequencer\n");
+        return nullptr;
+    }
+
+    snd_seq_set_client_name(s.seq, "membrain_latency");
+    s.port = snd_seq_create_simple_port(s.seq, "latency",
+                                        SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                        SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    s.queue = snd_seq_alloc_queue(s.seq);
+    if (s.port < 0 || s.queue < 0 || snd_midi_event_new(kDecodeBufferSize, &s.decoder) < 0)
+    {
+        fprintf(stderr, "Failed to set up the ALSA sequencer port\n");
+        return nullptr;
+    }
+    snd_midi_event_no_status(s.decoder, 1);
+
+    snd_seq_client_info_t* client;
+    snd_seq_port_info_t* port;
+    snd_seq_client_info_alloca(&client);
+    snd_seq_port_info_alloca(&port);
+
+    // Every cable of the device is a port, all of them are subscribed with real-time stamps from our queue
+    bool found = false;
+    bool has_output = false;
+    snd_seq_client_info_set_client(client, -1);
+    while (!found && snd_seq_query_next_client(s.seq, client) >= 0)
+    {
+        if (strstr(snd_seq_client_info_get_name(client), kDeviceName) == nullptr)
+        {
+            continue;
+        }
+        found = true;
+
+        int client_id = snd_seq_client_info_get_client(client);
+        snd_seq_port_info_set_client(port, client_id);
+        snd_seq_port_info_set_port(port, -1);
+        while (snd_seq_query_next_port(s.seq, port) >= 0)
+        {
+            unsigned int caps = snd_seq_port_info_get_capability(port);
+            snd_seq_addr_t addr = *snd_seq_port_info_get_addr(port);
+            if ((caps & (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) ==
+                (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ))
+            {
+                snd_seq_port_subscribe_t* subscription;
+                snd_seq_port_subscribe_alloca(&subscription);
+                snd_seq_addr_t dest = {static_cast<unsigned char>(snd_seq_client_id(s.seq)),
+                                       static_cast<unsigned char>(s.port)};
+                snd_seq_port_subscribe_set_sender(subscription, &addr);
+                snd_seq_port_subscribe_set_dest(subscription, &dest);
+                snd_seq_port_subscribe_set_queue(subscription, s.queue);
+                snd_seq_port_subscribe_set_time_update(subscription, 1);
+                snd_seq_port_subscribe_set_time_real(subscription, 1);
+                if (snd_seq_subscribe_port(s.seq, subscription) < 0)
+                {
+                    fprintf(stderr, "Failed to subscribe to %d:%d\n", addr.client, addr.port);
+                }
+            }
+            if (!has_output && (caps & SND_SEQ_PORT_CAP_WRITE) != 0)
+            {
+                s.output = addr;
+                has_output = true;
+            }
+        }
+    }
+
+    if (!found || !has_output)
+    {
+        fprintf(stderr, "No %s MIDI device found\n", kDeviceName);
+        return nullptr;
+    }
+
+    snd_seq_start_queue(s.seq, s.queue, nullptr);
+    snd_seq_drain_output(s.seq);
+    return transport;
+}
+
+int64_t AlsaTransport::now_us()
+{
+    snd_seq_queue_status_t* status;
+    snd_seq_queue_status_alloca(&status);
+    if (snd_seq_get_queue_status(state_->seq, state_->queue, status) < 0)
+    {
+        return 0;
+    }
+    const snd_seq_real_time_t* time = snd_seq_queue_status_get_real_time(status);
+    return static_cast<int64_t>(time->tv_sec) * 1000000 + time->tv_nsec / 1000;
+}
+
+bool AlsaTransport::send(const std::vector<uint8_t>& msg)
+{
+    snd_seq_event_t ev;
+    snd_seq_ev_clear(&ev);
+    snd_seq_ev_set_source(&ev, state_->port);
+    snd_seq_ev_set_dest(&ev, state_->output.client, state_->output.port);
+    snd_seq_ev_set_direct(&ev);
+    snd_seq_ev_set_sysex(&ev, msg.size(), const_cast<uint8_t*>(msg.data()));
+    return snd_seq_event_output_direct(state_->seq, &ev) >= 0;
+}
+
+bool AlsaTransport::receive(MidiEvent* event, int64_t timeout_us)
+{
+    int64_t deadline = now_us() + timeout_us;
+    for (;;)
+    {
+        snd_seq_event_t* ev = nullptr;
+        int ret = snd_seq_event_input(state_->seq, &ev);
+        if (ret == -EAGAIN)
+        {
+            int64_t remaining = deadline - now_us();
+            if (remaining <= 0)
+            {
+                return false;
+            }
+
+            int count = snd_seq_poll_descriptors_count(state_->seq, POLLIN);
+            std::vector<pollfd> fds(count);
+            snd_seq_poll_descriptors(state_->seq, fds.data(), count, POLLIN);
+            poll(fds.data(), count, static_cast<int>((remaining + 999) / 1000));
+            continue;
+        }
+        if (ret < 0 || ev == nullptr)
+        {
+            // -ENOSPC means the input pool overflowed and events were lost, keep going
+            continue;
+        }
+
+        event->host_time_us = static_cast<int64_t>(ev->time.time.tv_sec) * 1000000 + ev->time.time.tv_nsec / 1000;
+        if (ev->type == SND_SEQ_EVENT_SYSEX)
+        {
+            auto& buffer = state_->partial_sysex[{ev->source.client, ev->source.port}];
+            const uint8_t* data = static_cast<const uint8_t*>(ev->data.ext.ptr);
+            buffer.insert(buffer.end(), data, data + ev->data.ext.len);
+            if (buffer.empty() || buffer.back() != 0xF7)
+            {
+                continue;
+            }
+            event->bytes = std::move(buffer);
+            buffer.clear();
+            return true;
+        }
+
+        uint8_t bytes[kDecodeBufferSize];
+        snd_midi_event_reset_decode(state_->decoder);
+        long size = snd_midi_event_decode(state_->decoder, bytes, sizeof(bytes), ev);
+        if (size > 0)
+        {
+            event->bytes.assign(bytes, bytes + size);
+            return true;
+        }
+    }
+}
+
+} // namespace membrain
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+#include "latency_analyzer.h"
+
+namespace membrain
+{
+
+// Talks to the Membrain through the ALSA sequencer. Received events are timestamped by a sequencer queue in real time,
+// which is closer to the USB transfer than a timestamp taken after poll() returns.
+class AlsaTransport : public Transport
+{
+  public:
+    ~AlsaTransport() override;
+
+    // Connects to the first client whose name contains "Membrain". Returns null if there is none.
+    static std::unique_ptr<AlsaTransport> open();
+
+    int64_t now_us() override;
+    bool send(const std::vector<uint8_t>& msg) override;
+    bool receive(MidiEvent* event, int64_t timeout_us) override;
+
+  private:
+    struct State;
+
+    explicit AlsaTransport(std::unique_ptr<State> state);
+
+    std::unique_ptr<State> state_;
+};
+
+} // namespace membrain
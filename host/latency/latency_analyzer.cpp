@@ -0,0 +1,359 @@
+#include "latency_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "latency_probe.h"
+#include "sysex.h"
+
+namespace membrain
+{
+
+namespace
+{
+// Samples slower than the fastest round trip by more than this are not used for the fit
+constexpr int64_t kRoundTripSlackUs = 500;
+
+// Only the most recent samples are kept, the drift of a crystal is not constant over hours
+constexpr size_t kMaxClockSamples = 600;
+
+// Pings without a reply after this many newer pings are considered lost
+constexpr size_t kMaxPendingPings = 16;
+
+std::vector<uint8_t> make_sysex(uint8_t command, const uint8_t* payload, size_t size)
+{
+    std::vector<uint8_t> msg = {0xF0, sysex::kManufacturerId, sysex::kDeviceId, command};
+    msg.insert(msg.end(), payload, payload + size);
+    msg.push_back(0xF7);
+    return msg;
+}
+
+// Same encoding as sysex::encode_u32, which lives with the firmware's SysEx transport
+uint8_t* encode_u32(uint32_t value, uint8_t* out)
+{
+    for (size_t i = 0; i < sysex::kEncodedU32Size; ++i)
+    {
+        *out++ = value & 0x7F;
+        value >>= 7;
+    }
+    return out;
+}
+
+uint32_t decode_u32(const uint8_t* in)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < sysex::kEncodedU32Size; ++i)
+    {
+        value |= static_cast<uint32_t>(in[i] & 0x7F) << (7 * i);
+    }
+    return value;
+}
+} // namespace
+
+std::vector<uint8_t> make_latency_mode(bool enabled)
+{
+    uint8_t payload = enabled ? 1 : 0;
+    return make_sysex(sysex::LatencyMode, &payload, 1);
+}
+
+std::vector<uint8_t> make_ping(uint32_t token)
+{
+    uint8_t payload[latency_probe::kPingRequestSize];
+    encode_u32(token, payload);
+    return make_sysex(sysex::Ping, payload, sizeof(payload));
+}
+
+void Distribution::add(double value)
+{
+    values_.push_back(value);
+    sorted_ = false;
+}
+
+size_t Distribution::size() const
+{
+    return values_.size();
+}
+
+double Distribution::min() const
+{
+    return percentile(0.0);
+}
+
+double Distribution::max() const
+{
+    return percentile(1.0);
+}
+
+double Distribution::mean() const
+{
+    if (values_.empty())
+    {
+        return 0.0;
+    }
+
+    double sum = 0.0;
+    for (double value : values_)
+    {
+        sum += value;
+    }
+    return sum / values_.size();
+}
+
+double Distribution::stddev() const
+{
+    if (values_.size() < 2)
+    {
+        return 0.0;
+    }
+
+    double mean = this->mean();
+    double sum = 0.0;
+    for (double value : values_)
+    {
+        sum += (value - mean) * (value - mean);
+    }
+    return std::sqrt(sum / (values_.size() - 1));
+}
+
+double Distribution::percentile(double p) const
+{
+    if (values_.empty())
+    {
+        return 0.0;
+    }
+
+    if (!sorted_)
+    {
+        std::sort(values_.begin(), values_.end());
+        sorted_ = true;
+    }
+
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 1.0) * values_.size()));
+    return values_[rank == 0 ? 0 : rank - 1];
+}
+
+void ClockEstimator::add(int64_t host_send_us, int64_t host_receive_us, uint32_t device_us, uint32_t hold_us)
+{
+    // The reply waits at least hold_us on the device after the clock was read, the rest of the round trip is split
+    // evenly between the two directions
+    int64_t round_trip = host_receive_us - host_send_us - hold_us;
+    if (round_trip < 0)
+    {
+        round_trip = 0;
+    }
+
+    int64_t device = unwrap(device_us);
+    last_device_us_ = device;
+    has_wrap_reference_ = true;
+
+    samples_.push_back({host_send_us + round_trip / 2, device, round_trip});
+    if (samples_.size() > kMaxClockSamples)
+    {
+        samples_.erase(samples_.begin());
+    }
+
+    best_round_trip_us_ = samples_.front().round_trip_us;
+    for (const auto& sample : samples_)
+    {
+        best_round_trip_us_ = std::min(best_round_trip_us_, sample.round_trip_us);
+    }
+
+    fit();
+}
+
+bool ClockEstimator::valid() const
+{
+    return !samples_.empty();
+}
+
+size_t ClockEstimator::samples() const
+{
+    return samples_.size();
+}
+
+int64_t ClockEstimator::best_round_trip_us() const
+{
+    return best_round_trip_us_;
+}
+
+double ClockEstimator::drift_ppm() const
+{
+    return slope_ * 1e6;
+}
+
+int64_t ClockEstimator::to_host(uint32_t device_us) const
+{
+    int64_t device = unwrap(device_us);
+    return device - static_cast<int64_t>(std::llround(offset_ + slope_ * (device - origin_)));
+}
+
+int64_t ClockEstimator::unwrap(uint32_t device_us) const
+{
+    if (!has_wrap_reference_)
+    {
+        return device_us;
+    }
+    int32_t delta = static_cast<int32_t>(device_us - static_cast<uint32_t>(last_device_us_));
+    return last_device_us_ + delta;
+}
+
+void ClockEstimator::fit()
+{
+    // Least squares of (device - host) against device time over the fast samples
+    std::vector<const Sample*> good;
+    for (const auto& sample : samples_)
+    {
+        if (sample.round_trip_us <= best_round_trip_us_ + kRoundTripSlackUs)
+        {
+            good.push_back(&sample);
+        }
+    }
+
+    origin_ = good.back()->device_us;
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    for (const Sample* sample : good)
+    {
+        sum_x += static_cast<double>(sample->device_us - origin_);
+        sum_y += static_cast<double>(sample->device_us - sample->host_us);
+    }
+    double mean_x = sum_x / good.size();
+    double mean_y = sum_y / good.size();
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (const Sample* sample : good)
+    {
+        double dx = static_cast<double>(sample->device_us - origin_) - mean_x;
+        sxx += dx * dx;
+        sxy += dx * (static_cast<double>(sample->device_us - sample->host_us) - mean_y);
+    }
+
+    // A slope needs samples spread over time, with less than a second the offset alone is more reliable
+    slope_ = sxx > 1e12 ? sxy / sxx : 0.0;
+    offset_ = mean_y - slope_ * mean_x;
+}
+
+LatencyAnalyzer::LatencyAnalyzer()
+{
+    std::fill(&note_arrivals_[0][0][0], &note_arrivals_[0][0][0] + sizeof(note_arrivals_) / sizeof(int64_t), -1);
+}
+
+void LatencyAnalyzer::on_ping_sent(uint32_t token, int64_t host_time_us)
+{
+    pending_pings_.push_back({token, host_time_us});
+    if (pending_pings_.size() > kMaxPendingPings)
+    {
+        pending_pings_.erase(pending_pings_.begin());
+        ++lost_pings_;
+    }
+}
+
+void LatencyAnalyzer::on_event(const MidiEvent& event)
+{
+    const std::vector<uint8_t>& bytes = event.bytes;
+    if (bytes.empty())
+    {
+        return;
+    }
+
+    uint8_t type = bytes[0] & 0xF0;
+    if ((type == 0x80 || type == 0x90) && bytes.size() >= 3)
+    {
+        note_arrivals_[type == 0x90 ? 1 : 0][bytes[0] & 0x0F][bytes[1] & 0x7F] = event.host_time_us;
+        ++notes_;
+        return;
+    }
+
+    if (bytes[0] != 0xF0 || bytes.size() < sysex::kHeaderSize + 1 || bytes[1] != sysex::kManufacturerId ||
+        bytes[2] != sysex::kDeviceId)
+    {
+        return;
+    }
+
+    const uint8_t* payload = bytes.data() + sysex::kHeaderSize;
+    size_t size = bytes.size() - sysex::kHeaderSize - 1;
+    switch (bytes[3])
+    {
+    case sysex::Ping:
+        on_ping_reply(event, payload, size);
+        break;
+    case sysex::TimestampEcho:
+        on_echo(payload, size);
+        break;
+    default:
+        break;
+    }
+}
+
+const ClockEstimator& LatencyAnalyzer::clock() const
+{
+    return clock_;
+}
+
+const Distribution& LatencyAnalyzer::latency() const
+{
+    return latency_;
+}
+
+size_t LatencyAnalyzer::notes() const
+{
+    return notes_;
+}
+
+size_t LatencyAnalyzer::unmatched_echoes() const
+{
+    return unmatched_echoes_;
+}
+
+size_t LatencyAnalyzer::lost_pings() const
+{
+    return lost_pings_;
+}
+
+void LatencyAnalyzer::on_ping_reply(const MidiEvent& event, const uint8_t* payload, size_t size)
+{
+    if (size < latency_probe::kPingReplySize)
+    {
+        return;
+    }
+
+    uint32_t token = decode_u32(payload);
+    auto it = std::find_if(pending_pings_.begin(), pending_pings_.end(),
+                           [token](const PendingPing& ping) { return ping.token == token; });
+    if (it == pending_pings_.end())
+    {
+        return;
+    }
+
+    uint32_t device_us = decode_u32(payload + sysex::kEncodedU32Size);
+    uint32_t hold_us = decode_u32(payload + 2 * sysex::kEncodedU32Size);
+    clock_.add(it->host_time_us, event.host_time_us, device_us, hold_us);
+
+    // Older pings would have been answered first
+    lost_pings_ += it - pending_pings_.begin();
+    pending_pings_.erase(pending_pings_.begin(), it + 1);
+}
+
+void LatencyAnalyzer::on_echo(const uint8_t* payload, size_t size)
+{
+    if (size < latency_probe::kEchoPayloadSize || !clock_.valid())
+    {
+        ++unmatched_echoes_;
+        return;
+    }
+
+    uint8_t type = payload[0] == ((0x90 >> 4) & 0x07) ? 1 : 0;
+    int64_t& arrival = note_arrivals_[type][payload[1] & 0x0F][payload[2] & 0x7F];
+    if (arrival < 0)
+    {
+        ++unmatched_echoes_;
+        return;
+    }
+
+    uint32_t capture_us = decode_u32(payload + 3);
+    latency_.add(static_cast<double>(arrival - clock_.to_host(capture_us)));
+    arrival = -1;
+}
+
+} // namespace membrain
@@ -0,0 +1,132 @@
+#pragma once
+
+// Host side of the latency measurement protocol described in app/includes/latency_probe.h.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace membrain
+{
+
+// A complete MIDI message as received by the host. SysEx messages include F0 and F7.
+struct MidiEvent
+{
+    int64_t host_time_us;
+    std::vector<uint8_t> bytes;
+};
+
+// Connection to a device, real or simulated
+class Transport
+{
+  public:
+    virtual ~Transport() = default;
+
+    // Host clock received events are stamped with
+    virtual int64_t now_us() = 0;
+
+    virtual bool send(const std::vector<uint8_t>& msg) = 0;
+
+    // Waits up to timeout_us for the next event. Returns false on timeout.
+    virtual bool receive(MidiEvent* event, int64_t timeout_us) = 0;
+};
+
+std::vector<uint8_t> make_latency_mode(bool enabled);
+std::vector<uint8_t> make_ping(uint32_t token);
+
+class Distribution
+{
+  public:
+    void add(double value);
+
+    size_t size() const;
+    double min() const;
+    double max() const;
+    double mean() const;
+    double stddev() const;
+
+    // p in [0, 1], nearest rank
+    double percentile(double p) const;
+
+  private:
+    mutable std::vector<double> values_;
+    mutable bool sorted_ = true;
+};
+
+// Maps device time to host time from ping round trips. The offset is fitted as a line over the samples whose round trip
+// is close to the fastest one, which follows the drift between the two clocks while ignoring delayed replies.
+class ClockEstimator
+{
+  public:
+    // hold_us is the time the device is known to hold the reply before sending it
+    void add(int64_t host_send_us, int64_t host_receive_us, uint32_t device_us, uint32_t hold_us);
+
+    bool valid() const;
+    size_t samples() const;
+    int64_t best_round_trip_us() const;
+
+    // Drift of the device clock relative to the host clock, in parts per million
+    double drift_ppm() const;
+
+    // Device timestamps are 32-bit and wrap every 71 minutes, they are unwrapped around the latest ping
+    int64_t to_host(uint32_t device_us) const;
+
+  private:
+    struct Sample
+    {
+        int64_t host_us;   // Estimated host time at which the device read its clock
+        int64_t device_us; // Unwrapped
+        int64_t round_trip_us;
+    };
+
+    int64_t unwrap(uint32_t device_us) const;
+    void fit();
+
+    std::vector<Sample> samples_;
+    int64_t best_round_trip_us_ = 0;
+    int64_t last_device_us_ = 0;
+    bool has_wrap_reference_ = false;
+
+    // host = device - offset_ - slope_ * (device - origin_)
+    int64_t origin_ = 0;
+    double offset_ = 0.0;
+    double slope_ = 0.0;
+};
+
+class LatencyAnalyzer
+{
+  public:
+    LatencyAnalyzer();
+
+    void on_ping_sent(uint32_t token, int64_t host_time_us);
+    void on_event(const MidiEvent& event);
+
+    const ClockEstimator& clock() const;
+    const Distribution& latency() const;
+
+    size_t notes() const;
+    size_t unmatched_echoes() const;
+    size_t lost_pings() const;
+
+  private:
+    struct PendingPing
+    {
+        uint32_t token;
+        int64_t host_time_us;
+    };
+
+    void on_ping_reply(const MidiEvent& event, const uint8_t* payload, size_t size);
+    void on_echo(const uint8_t* payload, size_t size);
+
+    ClockEstimator clock_;
+    Distribution latency_;
+    std::vector<PendingPing> pending_pings_;
+    size_t lost_pings_ = 0;
+    size_t notes_ = 0;
+    size_t unmatched_echoes_ = 0;
+
+    // Arrival time of the last note off/on per channel and note, waiting for its echo. -1 when none.
+    int64_t note_arrivals_[2][16][128];
+};
+
+} // namespace membrain
@@ -0,0 +1,148 @@
+// Measures the latency from sensor capture on the Membrain to arrival at the host.
+//
+// Usage: membrain_latency [-s] [-d seconds]
+// Enables the device's timestamp echoes (latency_probe.h), pings it every 100 ms to map the device clock onto the host
+// clock and reports the distribution of (arrival - capture) over the notes played during the run. With -s the device is
+// simulated, which also prints the true latency of the simulated notes to check the estimate against.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "latency_analyzer.h"
+#include "simulated_device.h"
+#ifdef MEMBRAIN_HAVE_ALSA
+#include "alsa_transport.h"
+#endif
+
+namespace
+{
+constexpr int64_t kPingIntervalUs = 100000;
+constexpr int64_t kDrainTimeUs = 200000; // Late replies and echoes after the last ping
+constexpr int kDefaultSeconds = 30;
+constexpr int kDefaultSimulatedSeconds = 120;
+
+volatile sig_atomic_t g_running = 1;
+
+void handle_signal(int)
+{
+    g_running = 0;
+}
+
+void print_distribution(const char* name, const membrain::Distribution& d)
+{
+    printf("%-10s n=%zu min=%.0f p50=%.0f p90=%.0f p99=%.0f max=%.0f mean=%.1f stddev=%.1f us\n", name, d.size(),
+           d.min(), d.percentile(0.5), d.percentile(0.9), d.percentile(0.99), d.max(), d.mean(), d.stddev());
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool simulate = false;
+    int seconds = -1;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "-s") == 0)
+        {
+            simulate = true;
+        }
+        else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc)
+        {
+            seconds = atoi(argv[++arg]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-s] [-d seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (seconds <= 0)
+    {
+        seconds = simulate ? kDefaultSimulatedSeconds : kDefaultSeconds;
+    }
+
+    std::unique_ptr<membrain::Transport> transport;
+    membrain::SimulatedDevice* simulation = nullptr;
+    if (simulate)
+    {
+        auto device = std::make_unique<membrain::SimulatedDevice>(membrain::SimulatedDevice::Config{});
+        simulation = device.get();
+        transport = std::move(device);
+    }
+    else
+    {
+#ifdef MEMBRAIN_HAVE_ALSA
+        transport = membrain::AlsaTransport::open();
+#else
+        fprintf(stderr, "Built without ALSA, only -s is available\n");
+#endif
+        if (!transport)
+        {
+            return 1;
+        }
+        signal(SIGINT, handle_signal);
+        printf("Measuring for %d s, play some notes. Ctrl-C to stop early.\n", seconds);
+    }
+
+    membrain::LatencyAnalyzer analyzer;
+    transport->send(membrain::make_latency_mode(true));
+
+    int64_t start = transport->now_us();
+    int64_t end = start + static_cast<int64_t>(seconds) * 1000000;
+    int64_t next_ping = start;
+    uint32_t token = 0;
+    membrain::MidiEvent event;
+    while (g_running)
+    {
+        int64_t now = transport->now_us();
+        if (now >= end)
+        {
+            break;
+        }
+        if (now >= next_ping)
+        {
+            // Token wraps after 2^35 pings, well beyond any run
+            analyzer.on_ping_sent(token, now);
+            transport->send(membrain::make_ping(token++));
+            next_ping += kPingIntervalUs;
+            continue;
+        }
+        if (transport->receive(&event, next_ping - now))
+        {
+            analyzer.on_event(event);
+        }
+    }
+
+    transport->send(membrain::make_latency_mode(false));
+    int64_t drain_end = transport->now_us() + kDrainTimeUs;
+    for (int64_t now = transport->now_us(); now < drain_end; now = transport->now_us())
+    {
+        if (transport->receive(&event, drain_end - now))
+        {
+            analyzer.on_event(event);
+        }
+    }
+
+    const membrain::ClockEstimator& clock = analyzer.clock();
+    if (!clock.valid())
+    {
+        fprintf(stderr, "No ping replies, is the firmware too old?\n");
+        return 1;
+    }
+
+    printf("clock      %zu samples, best round trip %lld us, drift %.1f ppm, %zu pings lost\n", clock.samples(),
+           static_cast<long long>(clock.best_round_trip_us()), clock.drift_ppm(), analyzer.lost_pings());
+    printf("notes      %zu received, %zu echoes unmatched\n", analyzer.notes(), analyzer.unmatched_echoes());
+    print_distribution("latency", analyzer.latency());
+
+    if (simulation != nullptr)
+    {
+        const membrain::Distribution& truth = simulation->true_latency();
+        print_distribution("true", truth);
+        printf("error      mean %+.1f us, p99 %+.1f us\n", analyzer.latency().mean() - truth.mean(),
+               analyzer.latency().percentile(0.99) - truth.percentile(0.99));
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "simulated_device.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "latency_probe.h"
+#include "sysex.h"
+
+namespace membrain
+{
+
+namespace
+{
+constexpr int64_t kFramePeriodUs = 1000; // Full-speed USB start of frame
+constexpr uint8_t kFirstNote = 36;
+constexpr uint8_t kNoteCount = 16;
+
+void put_u32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (size_t i = 0; i < sysex::kEncodedU32Size; ++i)
+    {
+        out.push_back(value & 0x7F);
+        value >>= 7;
+    }
+}
+
+std::vector<uint8_t> sysex_message(uint8_t command)
+{
+    return {0xF0, sysex::kManufacturerId, sysex::kDeviceId, command};
+}
+} // namespace
+
+SimulatedDevice::SimulatedDevice(const Config& config) : config_(config), rng_(config.seed)
+{
+    device_events_.push({uniform(config_.min_note_interval_us, config_.max_note_interval_us), Action::NoteOn, {}});
+}
+
+int64_t SimulatedDevice::now_us()
+{
+    return now_;
+}
+
+bool SimulatedDevice::send(const std::vector<uint8_t>& msg)
+{
+    device_events_.push({now_ + uniform(config_.min_request_us, config_.max_request_us), Action::Request, msg});
+    return true;
+}
+
+bool SimulatedDevice::receive(MidiEvent* event, int64_t timeout_us)
+{
+    int64_t deadline = now_ + timeout_us;
+    for (;;)
+    {
+        bool has_output = !outbox_.empty() && outbox_.top().host_time_us <= deadline;
+        bool has_device_event = !device_events_.empty() && device_events_.top().host_time_us <= deadline;
+        if (has_output && (!has_device_event || outbox_.top().host_time_us <= device_events_.top().host_time_us))
+        {
+            Pending pending = outbox_.top();
+            outbox_.pop();
+            now_ = std::max(now_, pending.host_time_us);
+            if (pending.echoed)
+            {
+                true_latency_.add(static_cast<double>(pending.host_time_us - pending.capture_host_us));
+            }
+            event->host_time_us = pending.host_time_us;
+            event->bytes = std::move(pending.bytes);
+            return true;
+        }
+
+        if (!has_device_event)
+        {
+            now_ = std::max(now_, deadline);
+            return false;
+        }
+
+        run_until(device_events_.top().host_time_us);
+    }
+}
+
+const Distribution& SimulatedDevice::true_latency() const
+{
+    return true_latency_;
+}
+
+uint32_t SimulatedDevice::device_time(int64_t host_us) const
+{
+    double drift = static_cast<double>(host_us) * config_.drift_ppm * 1e-6;
+    return static_cast<uint32_t>(host_us + config_.clock_offset_us + std::llround(drift));
+}
+
+int64_t SimulatedDevice::release_time(int64_t capture_host_us)
+{
+    // The scheduler releases on the first frame after the hold time has passed
+    int64_t due = capture_host_us + config_.release_latency_us;
+    return (due + kFramePeriodUs - 1) / kFramePeriodUs * kFramePeriodUs;
+}
+
+void SimulatedDevice::run_until(int64_t host_us)
+{
+    while (!device_events_.empty() && device_events_.top().host_time_us <= host_us)
+    {
+        Scheduled scheduled = device_events_.top();
+        device_events_.pop();
+        now_ = std::max(now_, scheduled.host_time_us);
+
+        switch (scheduled.action)
+        {
+        case Action::NoteOn:
+            capture_note(scheduled.host_time_us, 0x90);
+            device_events_.push({scheduled.host_time_us + config_.note_length_us, Action::NoteOff, {}});
+            device_events_.push({scheduled.host_time_us +
+                                     uniform(config_.min_note_interval_us, config_.max_note_interval_us),
+                                 Action::NoteOn,
+                                 {}});
+            break;
+        case Action::NoteOff:
+            capture_note(scheduled.host_time_us, 0x80);
+            next_note_ = kFirstNote + (next_note_ - kFirstNote + 1) % kNoteCount;
+            break;
+        case Action::Request:
+            handle_request(scheduled.host_time_us, scheduled.request);
+            break;
+        }
+    }
+}
+
+void SimulatedDevice::capture_note(int64_t host_us, uint8_t status)
+{
+    uint8_t velocity = status == 0x90 ? static_cast<uint8_t>(uniform(1, 127)) : 0;
+    int64_t release = release_time(host_us);
+    deliver(release, {status, next_note_, velocity}, echo_enabled_, host_us);
+
+    if (echo_enabled_)
+    {
+        std::vector<uint8_t> echo = sysex_message(sysex::TimestampEcho);
+        echo.push_back((status >> 4) & 0x07);
+        echo.push_back(status & 0x0F);
+        echo.push_back(next_note_);
+        put_u32(echo, device_time(host_us));
+        echo.push_back(0xF7);
+        deliver(release, std::move(echo), false, host_us);
+    }
+}
+
+void SimulatedDevice::handle_request(int64_t host_us, const std::vector<uint8_t>& msg)
+{
+    if (msg.size() < sysex::kHeaderSize + 1 || msg[0] != 0xF0 || msg[1] != sysex::kManufacturerId ||
+        msg[2] != sysex::kDeviceId)
+    {
+        return;
+    }
+
+    const uint8_t* payload = msg.data() + sysex::kHeaderSize;
+    size_t size = msg.size() - sysex::kHeaderSize - 1;
+    if (msg[3] == sysex::LatencyMode && size >= 1)
+    {
+        echo_enabled_ = payload[0] != 0;
+    }
+    else if (msg[3] == sysex::Ping && size >= latency_probe::kPingRequestSize)
+    {
+        std::vector<uint8_t> reply = sysex_message(sysex::Ping);
+        reply.insert(reply.end(), payload, payload + latency_probe::kPingRequestSize);
+        put_u32(reply, device_time(host_us));
+        put_u32(reply, config_.release_latency_us);
+        reply.push_back(0xF7);
+        deliver(release_time(host_us), std::move(reply), false, host_us);
+    }
+}
+
+void SimulatedDevice::deliver(int64_t release_host_us, std::vector<uint8_t> bytes, bool echoed,
+                              int64_t capture_host_us)
+{
+    // Messages released in the same frame travel in the same transfer and arrive together, in order
+    if (release_host_us != last_release_us_)
+    {
+        last_release_us_ = release_host_us;
+        last_arrival_us_ = release_host_us + uniform(config_.min_delivery_us, config_.max_delivery_us);
+    }
+    outbox_.push({last_arrival_us_, order_++, std::move(bytes), echoed, capture_host_us});
+}
+
+int64_t SimulatedDevice::uniform(int64_t min, int64_t max)
+{
+    return std::uniform_int_distribution<int64_t>(min, max)(rng_);
+}
+
+} // namespace membrain
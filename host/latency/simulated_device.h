@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "latency_analyzer.h"
+
+namespace membrain
+{
+
+// In-process model of the firmware's latency protocol running on virtual time, so the analyzer can be checked against
+// known latencies without hardware. The device clock runs at an offset and a drift from the host clock. Notes are
+// held for the scheduler's release latency, released on the next 1 ms USB frame and delivered with a random host
+// delay. Ping replies take the same path.
+class SimulatedDevice : public Transport
+{
+  public:
+    struct Config
+    {
+        uint32_t seed = 1;
+        int64_t clock_offset_us = 123456789;
+        double drift_ppm = 40.0;
+        uint32_t release_latency_us = 1000;
+        int64_t min_delivery_us = 80;  // USB IN and host stack
+        int64_t max_delivery_us = 400;
+        int64_t min_request_us = 250;  // USB OUT and the MIDI task polling SysEx
+        int64_t max_request_us = 1250;
+        int64_t min_note_interval_us = 20000;
+        int64_t max_note_interval_us = 120000;
+        int64_t note_length_us = 30000;
+    };
+
+    explicit SimulatedDevice(const Config& config);
+
+    int64_t now_us() override;
+    bool send(const std::vector<uint8_t>& msg) override;
+    bool receive(MidiEvent* event, int64_t timeout_us) override;
+
+    // Latencies of the echoed notes as the simulation produced them
+    const Distribution& true_latency() const;
+
+  private:
+    struct Pending
+    {
+        int64_t host_time_us;
+        uint64_t order;
+        std::vector<uint8_t> bytes;
+        bool echoed; // A note whose latency is reported by its echo
+        int64_t capture_host_us;
+
+        bool operator>(const Pending& other) const
+        {
+            return host_time_us != other.host_time_us ? host_time_us > other.host_time_us : order > other.order;
+        }
+    };
+
+    enum class Action
+    {
+        NoteOn,
+        NoteOff,
+        Request
+    };
+
+    struct Scheduled
+    {
+        int64_t host_time_us;
+        Action action;
+        std::vector<uint8_t> request;
+
+        bool operator>(const Scheduled& other) const
+        {
+            return host_time_us > other.host_time_us;
+        }
+    };
+
+    uint32_t device_time(int64_t host_us) const;
+    int64_t release_time(int64_t capture_host_us);
+    void run_until(int64_t host_us);
+    void capture_note(int64_t host_us, uint8_t status);
+    void handle_request(int64_t host_us, const std::vector<uint8_t>& msg);
+    void deliver(int64_t release_host_us, std::vector<uint8_t> bytes, bool echoed, int64_t capture_host_us);
+    int64_t uniform(int64_t min, int64_t max);
+
+    Config config_;
+    std::mt19937 rng_;
+    int64_t now_ = 0;
+    uint64_t order_ = 0;
+    int64_t last_release_us_ = -1;
+    int64_t last_arrival_us_ = 0;
+    bool echo_enabled_ = false;
+    uint8_t next_note_ = 36;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> outbox_;
+    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> device_events_;
+    Distribution true_latency_;
+};
+
+} // namespace membrain
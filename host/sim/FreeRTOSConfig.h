@@ -0,0 +1,80 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+// Kernel configuration of the firmware simulation on the FreeRTOS POSIX port. It follows
+// FreeRTOSConfig_examples_common.h where the firmware depends on it (tick rate, priorities, run time stats), with a
+// single core since the port has no SMP support. Tasks are pthreads and only one of them runs at a time.
+
+#include <stdint.h>
+#include <time.h>
+
+#define configUSE_PREEMPTION    1
+#define configUSE_TICKLESS_IDLE 0
+#define configUSE_IDLE_HOOK     0
+#define configUSE_TICK_HOOK     0
+#define configTICK_RATE_HZ      ((TickType_t)1000)
+#define configMAX_PRIORITIES    32
+#define configMINIMAL_STACK_SIZE (configSTACK_DEPTH_TYPE)512
+#define configUSE_16_BIT_TICKS  0
+#define configIDLE_SHOULD_YIELD 1
+#define configNUMBER_OF_CORES   1
+
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configQUEUE_REGISTRY_SIZE               8
+#define configUSE_TIME_SLICING                  1
+#define configENABLE_BACKWARD_COMPATIBILITY     1
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 5
+#define configSTACK_DEPTH_TYPE                  uint32_t
+#define configMESSAGE_BUFFER_LENGTH_TYPE        size_t
+
+#define configSUPPORT_STATIC_ALLOCATION  0
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define configTOTAL_HEAP_SIZE            (1024 * 1024)
+
+// The port cannot watch pthread stacks
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define configUSE_MALLOC_FAILED_HOOK   0
+
+// Run time stats for task_stats, in microseconds like on the board
+static inline uint64_t membrain_sim_run_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+#define configGENERATE_RUN_TIME_STATS        1
+#define configUSE_TRACE_FACILITY             1
+#define configUSE_STATS_FORMATTING_FUNCTIONS 0
+#define configRUN_TIME_COUNTER_TYPE          uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() membrain_sim_run_time_us()
+
+#define configUSE_CO_ROUTINES 0
+
+#define configUSE_TIMERS             1
+#define configTIMER_TASK_PRIORITY    (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH     10
+#define configTIMER_TASK_STACK_DEPTH 1024
+
+#include <assert.h>
+#define configASSERT(x) assert(x)
+
+#define INCLUDE_vTaskPrioritySet            1
+#define INCLUDE_uxTaskPriorityGet           1
+#define INCLUDE_vTaskDelete                 1
+#define INCLUDE_vTaskSuspend                1
+#define INCLUDE_vTaskDelayUntil             1
+#define INCLUDE_vTaskDelay                  1
+#define INCLUDE_xTaskGetSchedulerState      1
+#define INCLUDE_xTaskGetCurrentTaskHandle   1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetIdleTaskHandle      1
+#define INCLUDE_eTaskGetState               1
+#define INCLUDE_xTimerPendFunctionCall      1
+#define INCLUDE_xTaskAbortDelay             1
+#define INCLUDE_xTaskGetHandle              1
+
+#endif
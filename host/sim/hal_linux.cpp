@@ -0,0 +1,556 @@
+#include "hal.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "simulated_board.h"
+#include "vl6180.h"
+
+namespace
+{
+constexpr uint32_t kNumPins = 48;
+constexpr uint32_t kNumAdcChannels = 4;
+constexpr uint8_t kVl6180Address = 0x29;
+constexpr size_t kVl6180Registers = 0x220;
+constexpr uint32_t kVendorFifoSize = 4096;
+constexpr uint64_t kFrameNs = 1000000;
+
+const std::chrono::steady_clock::time_point g_boot = std::chrono::steady_clock::now();
+
+struct Pin
+{
+    std::atomic<bool> output{false};
+    std::atomic<bool> level{false}; // Output register
+    std::atomic<bool> pull_up{false};
+    std::atomic<bool> pull_down{false};
+    std::atomic<int8_t> driven{-1}; // Level forced from outside, -1 when floating
+
+    // Charge of a cap-touch pad: total polls over cap_samples discharges, spread as evenly as integers allow
+    std::atomic<uint32_t> cap_total{0};
+    std::atomic<uint32_t> cap_samples{0};
+    uint32_t discharges = 0;
+    uint32_t polls = 0; // Polls since the pin was released from output low
+};
+
+// Polls that read low after the given discharge. Any cap_samples consecutive discharges add up to cap_total, so the
+// firmware reads the exact total whatever discharge it starts counting from.
+uint32_t charge_polls(const Pin& pin)
+{
+    const uint64_t total = pin.cap_total;
+    const uint64_t samples = pin.cap_samples;
+    const uint64_t k = pin.discharges % samples;
+    return static_cast<uint32_t>((k + 1) * total / samples - k * total / samples);
+}
+
+Pin g_pins[kNumPins];
+std::atomic<uint16_t> g_adc[kNumAdcChannels];
+
+// Register file of the VL6180X. A range measurement completes as soon as it is started.
+class Vl6180
+{
+  public:
+    void reset()
+    {
+        memset(registers_, 0, sizeof(registers_));
+        registers_[VL6180X_REG_IDENTIFICATION_MODEL_ID] = sim::kVl6180ModelId;
+        registers_[VL6180X_REG_SYSTEM_FRESH_OUT_OF_RESET] = 1;
+        registers_[VL6180X_REG_RESULT_RANGE_STATUS] = 0x01; // Device ready
+        index_ = 0;
+        range_mm_ = 255;
+        status_ = VL6180X_ERROR_NOCONVERGE;
+    }
+
+    void set_range(uint8_t range_mm, uint8_t status)
+    {
+        range_mm_ = range_mm;
+        status_ = status;
+    }
+
+    // The first two bytes select the register, the rest is written from there on
+    int write(const uint8_t* data, size_t size)
+    {
+        if (size < 2)
+        {
+            return -1;
+        }
+        index_ = (static_cast<uint16_t>(data[0]) << 8) | data[1];
+        for (size_t i = 2; i < size; ++i)
+        {
+            store(index_++, data[i]);
+        }
+        return static_cast<int>(size);
+    }
+
+    int read(uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = index_ < kVl6180Registers ? registers_[index_] : 0;
+            ++index_;
+        }
+        return static_cast<int>(size);
+    }
+
+  private:
+    void store(uint16_t reg, uint8_t value)
+    {
+        if (reg >= kVl6180Registers)
+        {
+            return;
+        }
+
+        switch (reg)
+        {
+        case VL6180X_REG_SYSRANGE_START:
+            if (value & 0x01)
+            {
+                registers_[VL6180X_REG_RESULT_RANGE_VAL] = range_mm_;
+                registers_[VL6180X_REG_RESULT_RANGE_STATUS] = static_cast<uint8_t>((status_ << 4) | 0x01);
+                registers_[VL6180X_REG_RESULT_INTERRUPT_STATUS_GPIO] |= 0x04; // New sample ready
+            }
+            break;
+        case VL6180X_REG_SYSTEM_INTERRUPT_CLEAR:
+            // Bit 0 clears the range interrupt, bit 1 the ALS one and bit 2 the error flags
+            registers_[VL6180X_REG_RESULT_INTERRUPT_STATUS_GPIO] &=
+                ~(((value & 0x01) ? 0x07 : 0) | ((value & 0x02) ? 0x38 : 0) | ((value & 0x04) ? 0xC0 : 0));
+            break;
+        default:
+            registers_[reg] = value;
+            break;
+        }
+    }
+
+    uint8_t registers_[kVl6180Registers];
+    uint16_t index_;
+    uint8_t range_mm_;
+    uint8_t status_;
+};
+
+Vl6180 g_vl6180;
+std::atomic<bool> g_i2c_connected{true};
+
+std::atomic<bool> g_usb_mounted{true};
+std::atomic<bool> g_sof_enabled{false};
+uint32_t g_frame_count = 0;
+sim::PacketSink g_sink;
+
+// Device to host packets waiting for the next frame and host to device bytes waiting to be read. Tasks are switched
+// from the tick signal, so the queues are only touched in kernel critical sections.
+std::deque<std::array<uint8_t, 4>> g_tx_fifo;
+std::deque<uint8_t> g_rx_fifo;
+
+// Virtual clock, see sim::use_virtual_clock(). Only the task running the firmware moves it, so nothing is locked.
+bool g_virtual = false;
+sim::HalCosts g_costs;
+uint64_t g_virtual_ns = 0;
+uint64_t g_next_frame_ns = kFrameNs;
+uint32_t g_critical_depth = 0;
+bool g_in_frame = false;
+uint32_t g_i2c_baudrate = 100 * 1000;
+
+// Runs the USB frames whose start has passed. Like the SOF interrupt, a frame waits for the end of a critical section
+// and never interrupts itself.
+void run_due_frames()
+{
+    if (g_in_frame || g_critical_depth > 0)
+    {
+        return;
+    }
+    g_in_frame = true;
+    while (g_virtual_ns >= g_next_frame_ns)
+    {
+        g_next_frame_ns += kFrameNs;
+        sim::start_of_frame();
+    }
+    g_in_frame = false;
+}
+
+// Charges the firmware for time spent in the HAL
+void spend(uint64_t ns)
+{
+    if (!g_virtual)
+    {
+        return;
+    }
+    g_virtual_ns += ns;
+    run_due_frames();
+}
+
+// Start and stop conditions plus nine clocks per byte, the address included
+void spend_i2c(size_t size)
+{
+    spend(((size + 1) * 9 + 2) * 1000000000ull / g_i2c_baudrate);
+}
+
+Pin* pin(uint32_t number)
+{
+    return number < kNumPins ? &g_pins[number] : nullptr;
+}
+} // namespace
+
+namespace hal
+{
+uint32_t time_us()
+{
+    return static_cast<uint32_t>(time_us_64());
+}
+
+uint64_t time_us_64()
+{
+    if (g_virtual)
+    {
+        return g_virtual_ns / 1000;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_boot).count();
+}
+
+uint32_t time_ms()
+{
+    return static_cast<uint32_t>(time_us_64() / 1000);
+}
+
+// The tick signal cuts sleeps short, so wait for the deadline rather than for one sleep
+void sleep_ms(uint32_t ms)
+{
+    if (g_virtual)
+    {
+        spend(ms * 1000000ull);
+        return;
+    }
+
+    const uint64_t deadline = time_us_64() + ms * 1000ull;
+    while (time_us_64() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(deadline - time_us_64()));
+    }
+}
+
+void gpio_init(uint32_t number)
+{
+    spend(g_costs.gpio_ns);
+    if (Pin* p = pin(number))
+    {
+        p->output = false;
+        p->level = false;
+        p->pull_up = false;
+        p->pull_down = false;
+    }
+}
+
+void gpio_set_output(uint32_t number, bool output)
+{
+    spend(g_costs.gpio_ns);
+    if (Pin* p = pin(number))
+    {
+        // Driving the pad discharges it, the charge time counts from the release
+        if (!output && p->output)
+        {
+            ++p->discharges;
+            p->polls = 0;
+        }
+        p->output = output;
+    }
+}
+
+void gpio_set_pulls(uint32_t number, bool up, bool down)
+{
+    spend(g_costs.gpio_ns);
+    if (Pin* p = pin(number))
+    {
+        p->pull_up = up;
+        p->pull_down = down;
+    }
+}
+
+void gpio_put(uint32_t number, bool value)
+{
+    spend(g_costs.gpio_ns);
+    if (Pin* p = pin(number))
+    {
+        p->level = value;
+    }
+}
+
+bool gpio_get(uint32_t number)
+{
+    spend(g_costs.gpio_ns);
+    Pin* p = pin(number);
+    if (p == nullptr)
+    {
+        return false;
+    }
+    if (p->output)
+    {
+        return p->level;
+    }
+
+    int8_t driven = p->driven;
+    if (driven >= 0)
+    {
+        return driven != 0;
+    }
+
+    if (p->cap_samples > 0 && p->pull_up)
+    {
+        return ++p->polls > charge_polls(*p);
+    }
+    return p->pull_up && !p->pull_down;
+}
+
+void adc_init()
+{
+}
+
+void adc_gpio_init(uint32_t pin)
+{
+    (void)pin;
+}
+
+uint16_t adc_read(uint32_t channel)
+{
+    spend(g_costs.adc_ns);
+    return channel < kNumAdcChannels ? g_adc[channel].load() : 0;
+}
+
+void i2c_init(uint32_t baudrate)
+{
+    g_i2c_baudrate = baudrate;
+}
+
+int i2c_write(uint8_t address, const uint8_t* data, size_t size, bool nostop)
+{
+    (void)nostop;
+    spend_i2c(size);
+    if (address != kVl6180Address || !g_i2c_connected)
+    {
+        return -1;
+    }
+    taskENTER_CRITICAL();
+    int result = g_vl6180.write(data, size);
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+int i2c_read(uint8_t address, uint8_t* data, size_t size, bool nostop)
+{
+    (void)nostop;
+    spend_i2c(size);
+    if (address != kVl6180Address || !g_i2c_connected)
+    {
+        return -1;
+    }
+    taskENTER_CRITICAL();
+    int result = g_vl6180.read(data, size);
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+bool usb_midi_mounted()
+{
+    return g_usb_mounted;
+}
+
+void usb_enable_sof(bool enabled)
+{
+    g_sof_enabled = enabled;
+}
+
+bool usb_midi_write_packet(const uint8_t packet[4])
+{
+    taskENTER_CRITICAL();
+    bool written = g_tx_fifo.size() < sim::kMidiTxFifoPackets;
+    if (written)
+    {
+        g_tx_fifo.push_back({packet[0], packet[1], packet[2], packet[3]});
+    }
+    taskEXIT_CRITICAL();
+    return written;
+}
+
+uint32_t usb_midi_available()
+{
+    taskENTER_CRITICAL();
+    uint32_t available = static_cast<uint32_t>(g_rx_fifo.size());
+    taskEXIT_CRITICAL();
+    return available;
+}
+
+uint32_t usb_midi_read(uint8_t* buffer, uint32_t size)
+{
+    taskENTER_CRITICAL();
+    uint32_t count = 0;
+    for (; count < size && !g_rx_fifo.empty(); ++count)
+    {
+        buffer[count] = g_rx_fifo.front();
+        g_rx_fifo.pop_front();
+    }
+    taskEXIT_CRITICAL();
+    return count;
+}
+
+// The simulation has no sensor capture client, the stream stays stopped
+bool usb_vendor_mounted()
+{
+    return false;
+}
+
+uint32_t usb_vendor_available()
+{
+    return 0;
+}
+
+uint32_t usb_vendor_read(void* buffer, uint32_t size)
+{
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+uint32_t usb_vendor_write_available()
+{
+    return kVendorFifoSize;
+}
+
+uint32_t usb_vendor_write(const void* data, uint32_t size)
+{
+    (void)data;
+    return size;
+}
+
+void usb_vendor_flush()
+{
+}
+
+void CriticalSection::init()
+{
+}
+
+void CriticalSection::enter()
+{
+    taskENTER_CRITICAL();
+    ++g_critical_depth;
+}
+
+void CriticalSection::exit()
+{
+    --g_critical_depth;
+    taskEXIT_CRITICAL();
+    if (g_virtual)
+    {
+        run_due_frames();
+    }
+}
+} // namespace hal
+
+namespace sim
+{
+void reset()
+{
+    for (Pin& p : g_pins)
+    {
+        p.driven = -1;
+        p.cap_total = sim::kCapIdlePolls;
+        p.cap_samples = 1;
+    }
+    for (auto& channel : g_adc)
+    {
+        channel = 2048;
+    }
+    g_vl6180.reset();
+    g_i2c_connected = true;
+}
+
+void set_adc(uint32_t channel, uint16_t value)
+{
+    if (channel < kNumAdcChannels)
+    {
+        g_adc[channel] = value & 0xFFF;
+    }
+}
+
+void set_gpio_input(uint32_t number, bool level)
+{
+    if (Pin* p = pin(number))
+    {
+        p->driven = level ? 1 : 0;
+    }
+}
+
+void set_cap_total(uint32_t number, uint32_t total, uint32_t samples)
+{
+    if (Pin* p = pin(number))
+    {
+        p->cap_total = total;
+        p->cap_samples = samples > 0 ? samples : 1;
+    }
+}
+
+void set_range(uint8_t range_mm, uint8_t status)
+{
+    taskENTER_CRITICAL();
+    g_vl6180.set_range(range_mm, status);
+    taskEXIT_CRITICAL();
+}
+
+void set_i2c_connected(bool connected)
+{
+    g_i2c_connected = connected;
+}
+
+void set_usb_mounted(bool mounted)
+{
+    g_usb_mounted = mounted;
+}
+
+void set_packet_sink(PacketSink sink)
+{
+    g_sink = std::move(sink);
+}
+
+void start_of_frame()
+{
+    if (g_sof_enabled)
+    {
+        tud_sof_cb(g_frame_count);
+    }
+    g_frame_count = (g_frame_count + 1) & 0x7FF;
+
+    std::vector<std::array<uint8_t, 4>> packets;
+    taskENTER_CRITICAL();
+    packets.assign(g_tx_fifo.begin(), g_tx_fifo.end());
+    g_tx_fifo.clear();
+    taskEXIT_CRITICAL();
+
+    const uint64_t now = hal::time_us_64();
+    for (const auto& packet : packets)
+    {
+        if (g_sink)
+        {
+            g_sink(now, packet.data());
+        }
+    }
+}
+
+void use_virtual_clock(const HalCosts& costs)
+{
+    g_costs = costs;
+    g_virtual_ns = 0;
+    g_next_frame_ns = kFrameNs;
+    g_virtual = true;
+}
+
+void send_to_device(const uint8_t* data, size_t size)
+{
+    taskENTER_CRITICAL();
+    g_rx_fifo.insert(g_rx_fifo.end(), data, data + size);
+    taskEXIT_CRITICAL();
+}
+} // namespace sim
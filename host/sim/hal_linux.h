@@ -0,0 +1,54 @@
+#pragma once
+
+// Linux backend of hal.h for the firmware simulation. Include hal.h instead of this file. The peripherals behind these
+// functions are simulated in hal_linux.cpp and driven through simulated_board.h.
+
+#include <cstddef>
+#include <cstdint>
+
+// Start of frame hook, defined by midi_scheduler as for TinyUSB and called by sim::start_of_frame()
+extern "C" void tud_sof_cb(uint32_t frame_count);
+
+namespace hal
+{
+uint32_t time_us();
+uint64_t time_us_64();
+uint32_t time_ms();
+void sleep_ms(uint32_t ms);
+
+void gpio_init(uint32_t pin);
+void gpio_set_output(uint32_t pin, bool output);
+void gpio_set_pulls(uint32_t pin, bool up, bool down);
+void gpio_put(uint32_t pin, bool value);
+bool gpio_get(uint32_t pin);
+
+void adc_init();
+void adc_gpio_init(uint32_t pin);
+uint16_t adc_read(uint32_t channel);
+
+void i2c_init(uint32_t baudrate);
+int i2c_write(uint8_t address, const uint8_t* data, size_t size, bool nostop);
+int i2c_read(uint8_t address, uint8_t* data, size_t size, bool nostop);
+
+bool usb_midi_mounted();
+void usb_enable_sof(bool enabled);
+bool usb_midi_write_packet(const uint8_t packet[4]);
+uint32_t usb_midi_available();
+uint32_t usb_midi_read(uint8_t* buffer, uint32_t size);
+
+bool usb_vendor_mounted();
+uint32_t usb_vendor_available();
+uint32_t usb_vendor_read(void* buffer, uint32_t size);
+uint32_t usb_vendor_write_available();
+uint32_t usb_vendor_write(const void* data, uint32_t size);
+void usb_vendor_flush();
+
+// Simulated tasks only run one at a time, a kernel critical section keeps the tick from switching them
+class CriticalSection
+{
+  public:
+    void init();
+    void enter();
+    void exit();
+};
+} // namespace hal
@@ -0,0 +1,78 @@
+// leds.h for the simulation. The LED strips are driven by PIO and DMA on the board, here the status pixels only keep
+// their base color for the scenario to check.
+
+#include <cstdint>
+
+#include <atomic>
+
+#include "leds.h"
+#include "simulated_board.h"
+
+namespace
+{
+constexpr uint32_t kNumPixels = 8;
+
+std::atomic<uint32_t> g_colors[kNumPixels];
+} // namespace
+
+uint32_t urgb_to_u32(uint8_t r, uint8_t g, uint8_t b)
+{
+    return ((uint32_t)(r) << 8) | ((uint32_t)(g) << 16) | (uint32_t)(b);
+}
+
+void start_led_task()
+{
+}
+
+void led_task(void* params)
+{
+    (void)params;
+}
+
+void set_led(Pixels pixel, uint32_t color)
+{
+    if (pixel < kNumPixels)
+    {
+        g_colors[pixel].store(color, std::memory_order_relaxed);
+    }
+}
+
+void fade_led(Pixels pixel, uint32_t color, uint32_t duration_ms)
+{
+    (void)duration_ms;
+    set_led(pixel, color);
+}
+
+void pulse_led(Pixels pixel, uint32_t color, uint32_t period_ms, int repeat)
+{
+    (void)pixel;
+    (void)color;
+    (void)period_ms;
+    (void)repeat;
+}
+
+void flash_led(Pixels pixel, uint32_t color, uint8_t velocity, uint32_t duration_ms)
+{
+    (void)pixel;
+    (void)color;
+    (void)velocity;
+    (void)duration_ms;
+}
+
+Pixels strip_pixel(uint32_t strip, uint32_t index)
+{
+    return static_cast<Pixels>(strip * kNumPixels + index);
+}
+
+uint32_t led_dropped_commands()
+{
+    return 0;
+}
+
+namespace sim
+{
+uint32_t led_color(uint32_t pixel)
+{
+    return pixel < kNumPixels ? g_colors[pixel].load(std::memory_order_relaxed) : 0;
+}
+} // namespace sim
@@ -0,0 +1,409 @@
+// Replays sensor streams through the firmware's sensor-to-MIDI path on a virtual clock. The control loop runs back to
+// back as on the board while the simulated sensors hold the values of the latest input record, and time only moves by
+// what the HAL calls cost (sim::HalCosts). The same input and firmware always give the same MIDI output at the same
+// times, so a run can be compared with a golden event log and timed to catch regressions.
+//
+// Usage: membrain_replay [-o events.csv] [-g golden.csv] [-t microseconds] <input>
+//   input  A capture written by membrain_capture, a .csv file with the columns of membrain_decode (timestamp_us,
+//          stream, v0, v1, v2; stream 9 holds the piezo comparator level in v0, which captures do not record) or
+//          script:<seconds> for the scripted performance of membrain_sim
+//   -o  Writes the MIDI event log, one row per USB-MIDI packet: release time and latency since the sensor reading
+//       that produced it, both in microseconds on the input's clock, then the cable and the three MIDI bytes
+//   -g  Compares the event log with one written by -o. Exits with 1 if a packet differs or if a release time moved
+//       by more than the tolerance.
+//   -t  Tolerance of the comparison in microseconds, 0 by default
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cap_touch.h"
+#include "capture_reader.h"
+#include "hal.h"
+#include "midi_controller.h"
+#include "midi_scheduler.h"
+#include "performance.h"
+#include "profiler.h"
+#include "simulated_board.h"
+#include "trace.h"
+#include "usb_descriptors.h"
+#include "vl6180.h"
+
+#define REPLAY_TASK_PRIORITY   USB_MIDI_TASK_PRIORITY
+#define REPLAY_TASK_STACK_SIZE 8192
+
+namespace
+{
+// Time given to the scheduler after the last input record, so that everything it triggered gets released
+constexpr uint64_t kDrainUs = 20000;
+
+constexpr const char* kScriptPrefix = "script:";
+
+struct Event
+{
+    int64_t release_us;
+    uint32_t latency_us;
+    uint8_t cable;
+    uint8_t bytes[3];
+};
+
+std::string g_input;
+std::string g_output_path;
+std::string g_golden_path;
+uint32_t g_tolerance_us = 0;
+
+std::vector<capture_codec::Record> g_records;
+std::vector<Event> g_events;
+int64_t g_offset_us = 0; // Virtual time minus input time
+
+bool ends_with(const std::string& value, const std::string& suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool read_csv(const std::string& path, std::vector<capture_codec::Record>* records)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        int64_t timestamp;
+        int stream;
+        int32_t values[capture_codec::kMaxValues];
+        if (sscanf(line, "%" SCNd64 ",%d,%" SCNd32 ",%" SCNd32 ",%" SCNd32, &timestamp, &stream, &values[0],
+                   &values[1], &values[2]) != 5)
+        {
+            continue; // Header
+        }
+
+        capture_codec::Record record = {};
+        record.stream = static_cast<uint8_t>(stream);
+        record.keyframe = true;
+        record.valid = true;
+        record.count = capture_codec::kMaxValues;
+        record.timestamp_us = static_cast<uint64_t>(timestamp);
+        std::copy(values, values + capture_codec::kMaxValues, record.values);
+        records->push_back(record);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool read_capture(const std::string& path, std::vector<capture_codec::Record>* records)
+{
+    CaptureReader reader;
+    if (!reader.open(path))
+    {
+        return false;
+    }
+
+    capture_codec::Record record;
+    while (reader.next(&record))
+    {
+        records->push_back(record);
+    }
+    if (reader.skipped_bytes() > 0)
+    {
+        fprintf(stderr, "%zu bytes of the capture could not be decoded\n", reader.skipped_bytes());
+    }
+    return true;
+}
+
+bool read_input(const std::string& input, std::vector<capture_codec::Record>* records)
+{
+    if (input.compare(0, strlen(kScriptPrefix), kScriptPrefix) == 0)
+    {
+        *records = sim::scripted_performance(static_cast<uint32_t>(atof(input.c_str() + strlen(kScriptPrefix)) * 1000));
+        return true;
+    }
+
+    bool ok = ends_with(input, ".csv") ? read_csv(input, records) : read_capture(input, records);
+    std::stable_sort(records->begin(), records->end(),
+                     [](const capture_codec::Record& a, const capture_codec::Record& b)
+                     { return a.timestamp_us < b.timestamp_us; });
+    return ok;
+}
+
+bool write_events(const std::string& path, const std::vector<Event>& events)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "release_us,latency_us,cable,b0,b1,b2\n");
+    for (const Event& event : events)
+    {
+        fprintf(file, "%" PRId64 ",%" PRIu32 ",%u,%u,%u,%u\n", event.release_us, event.latency_us, event.cable,
+                event.bytes[0], event.bytes[1], event.bytes[2]);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool read_events(const std::string& path, std::vector<Event>* events)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        Event event;
+        unsigned cable, b0, b1, b2;
+        if (sscanf(line, "%" SCNd64 ",%" SCNu32 ",%u,%u,%u,%u", &event.release_us, &event.latency_us, &cable, &b0, &b1,
+                   &b2) != 6)
+        {
+            continue; // Header
+        }
+        event.cable = static_cast<uint8_t>(cable);
+        event.bytes[0] = static_cast<uint8_t>(b0);
+        event.bytes[1] = static_cast<uint8_t>(b1);
+        event.bytes[2] = static_cast<uint8_t>(b2);
+        events->push_back(event);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool same_packet(const Event& a, const Event& b)
+{
+    return a.cable == b.cable && std::equal(a.bytes, a.bytes + 3, b.bytes);
+}
+
+void print_event(const char* label, const Event& event)
+{
+    printf("  %-8s %10.3f ms  cable %u  %02X %02X %02X\n", label, event.release_us / 1000.0, event.cable,
+           event.bytes[0], event.bytes[1], event.bytes[2]);
+}
+
+// Packets must match one for one, release times within the tolerance
+bool compare_with_golden(const std::vector<Event>& golden)
+{
+    const size_t common = std::min(g_events.size(), golden.size());
+    size_t moved = 0;
+    int64_t max_shift_us = 0;
+    for (size_t i = 0; i < common; ++i)
+    {
+        if (!same_packet(g_events[i], golden[i]))
+        {
+            printf("Golden: packet %zu differs\n", i);
+            print_event("expected", golden[i]);
+            print_event("got", g_events[i]);
+            return false;
+        }
+
+        const int64_t shift = std::abs(g_events[i].release_us - golden[i].release_us);
+        max_shift_us = std::max(max_shift_us, shift);
+        if (shift > g_tolerance_us)
+        {
+            ++moved;
+        }
+    }
+
+    if (g_events.size() != golden.size())
+    {
+        printf("Golden: %zu packets expected, got %zu\n", golden.size(), g_events.size());
+        print_event(g_events.size() > golden.size() ? "extra" : "missing",
+                    g_events.size() > golden.size() ? g_events[common] : golden[common]);
+        return false;
+    }
+
+    printf("Golden: %zu packets match, %zu moved by more than %" PRIu32 " us, largest shift %" PRId64 " us\n",
+           common, moved, g_tolerance_us, max_shift_us);
+    return moved == 0;
+}
+
+void record_release(uint32_t timestamp_us, uint32_t release_time_us, const uint8_t packet[4])
+{
+    // Releases happen in the frame callback, so the virtual clock still reads the release time
+    Event event;
+    event.release_us = static_cast<int64_t>(hal::time_us_64()) - g_offset_us;
+    event.latency_us = release_time_us - timestamp_us;
+    event.cable = packet[0] >> 4;
+    std::copy(packet + 1, packet + 4, event.bytes);
+    g_events.push_back(event);
+}
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, uint32_t percent)
+{
+    return sorted.empty() ? 0 : sorted[(sorted.size() - 1) * percent / 100];
+}
+
+void print_report(uint32_t cycles, uint64_t replayed_us, double host_s)
+{
+    uint32_t packets[MIDI_CABLE_COUNT] = {};
+    std::vector<uint32_t> latencies;
+    latencies.reserve(g_events.size());
+    for (const Event& event : g_events)
+    {
+        if (event.cable < MIDI_CABLE_COUNT)
+        {
+            ++packets[event.cable];
+        }
+        latencies.push_back(event.latency_us);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("Replayed %zu records over %.3f s in %u control cycles\n", g_records.size(), replayed_us / 1e6, cycles);
+    printf("Packets: %u notes, %u controllers, %u diagnostics, %u dropped\n", packets[MIDI_CABLE_NOTES],
+           packets[MIDI_CABLE_CONTROLLERS], packets[MIDI_CABLE_DIAGNOSTICS], midi_scheduler::get_stats().dropped);
+    printf("Latency: min %u us, p50 %u us, p99 %u us, max %u us\n", percentile(latencies, 0),
+           percentile(latencies, 50), percentile(latencies, 99), latencies.empty() ? 0 : latencies.back());
+
+    // On the virtual clock, so these move only when the firmware's HAL usage changes
+    static const char* const kSectionNames[profiler::kNumSections] = {"loop", "pitch bend", "piezo", "touch pads",
+                                                                      "range"};
+    for (size_t i = 0; i < profiler::kNumSections; ++i)
+    {
+        profiler::Summary summary = profiler::summary(static_cast<profiler::Section>(i));
+        printf("  %-10s  %8u runs  p50 %6u us  p99 %6u us  max %6u us\n", kSectionNames[i], summary.count,
+               summary.p50_us, summary.p99_us, summary.max_us);
+    }
+
+    printf("Host: %.3f s, %.0f cycles/s, %.1fx real time\n", host_s, cycles / host_s, replayed_us / 1e6 / host_s);
+}
+
+int usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [-o events.csv] [-g golden.csv] [-t microseconds] <capture|file.csv|script:seconds>\n",
+            program);
+    return 1;
+}
+
+void replay_task(void* params)
+{
+    (void)params;
+
+    // The sensors start from the first values of the input, which is what the pads calibrate against
+    const uint64_t first_us = g_records.front().timestamp_us;
+    size_t next = 0;
+    for (; next < g_records.size() && g_records[next].timestamp_us == first_us; ++next)
+    {
+        sim::apply(g_records[next]);
+    }
+
+    // Same start up as vLaunch() in membrain.cpp, without the logger and the LED task
+    trace::init();
+    midi_scheduler::init();
+    hal::adc_init();
+    init_vl6180x();
+    init_cap_touch();
+    init_midi_controller();
+    midi_scheduler::set_release_hook(record_release);
+    g_offset_us = static_cast<int64_t>(hal::time_us_64()) - static_cast<int64_t>(first_us);
+
+    const uint64_t end_us = g_records.back().timestamp_us + kDrainUs;
+    uint32_t cycles = 0;
+    const auto host_start = std::chrono::steady_clock::now();
+    while (true)
+    {
+        const uint64_t now_us = static_cast<uint64_t>(static_cast<int64_t>(hal::time_us_64()) - g_offset_us);
+        for (; next < g_records.size() && g_records[next].timestamp_us <= now_us; ++next)
+        {
+            sim::apply(g_records[next]);
+        }
+        if (now_us >= end_us)
+        {
+            break;
+        }
+
+        run_midi_cycle();
+        ++cycles;
+    }
+    const std::chrono::duration<double> host_time = std::chrono::steady_clock::now() - host_start;
+
+    print_report(cycles, end_us - first_us, host_time.count());
+
+    int result = 0;
+    if (!g_output_path.empty() && !write_events(g_output_path, g_events))
+    {
+        fprintf(stderr, "Failed to write %s\n", g_output_path.c_str());
+        result = 1;
+    }
+    if (!g_golden_path.empty())
+    {
+        std::vector<Event> golden;
+        if (!read_events(g_golden_path, &golden))
+        {
+            fprintf(stderr, "Failed to read %s\n", g_golden_path.c_str());
+            result = 1;
+        }
+        else if (!compare_with_golden(golden))
+        {
+            result = 1;
+        }
+    }
+
+    fflush(stdout);
+    exit(result);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "o:g:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            g_output_path = optarg;
+            break;
+        case 'g':
+            g_golden_path = optarg;
+            break;
+        case 't':
+            g_tolerance_us = static_cast<uint32_t>(atoi(optarg));
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+    {
+        return usage(argv[0]);
+    }
+
+    g_input = argv[optind];
+    if (!read_input(g_input, &g_records))
+    {
+        fprintf(stderr, "Failed to read %s\n", g_input.c_str());
+        return 1;
+    }
+    if (g_records.empty())
+    {
+        fprintf(stderr, "%s holds no sensor records\n", g_input.c_str());
+        return 1;
+    }
+
+    sim::reset();
+    sim::use_virtual_clock(sim::HalCosts());
+
+    // The control loop runs in a task because the firmware calls the kernel, and it is the only task that runs: nothing
+    // else may touch the virtual clock
+    xTaskCreate(replay_task, "ReplayTask", REPLAY_TASK_STACK_SIZE, nullptr, REPLAY_TASK_PRIORITY, nullptr);
+    vTaskStartScheduler();
+    return 1;
+}
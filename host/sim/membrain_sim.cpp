@@ -0,0 +1,128 @@
+// Runs the firmware's sensor-to-MIDI path on Linux: midi_controller and the sensor drivers on the simulated board of
+// hal_linux.cpp, scheduled by the FreeRTOS POSIX port. A scripted performance plays the sensors and every MIDI packet
+// the host would receive is printed with its arrival time. membrain_replay runs the same path on a virtual clock.
+//
+// Usage: membrain_sim [-d seconds] [-q]
+//   -d  Length of the performance, 10 seconds by default
+//   -q  Only print the summary: packet counts, scheduler latency and the control loop profile
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cap_touch.h"
+#include "hal.h"
+#include "logging.h"
+#include "midi_controller.h"
+#include "midi_scheduler.h"
+#include "performance.h"
+#include "profiler.h"
+#include "simulated_board.h"
+#include "task_stats.h"
+#include "trace.h"
+#include "usb_descriptors.h"
+#include "vl6180.h"
+
+// Above the MIDI task, so frames preempt the control loop like the USB interrupt does on the board
+#define SIM_TASK_PRIORITY   (tskIDLE_PRIORITY + 3UL)
+#define SIM_TASK_STACK_SIZE 4096
+
+namespace
+{
+uint32_t g_duration_ms = 10000;
+bool g_quiet = false;
+uint32_t g_packets[MIDI_CABLE_COUNT] = {};
+std::vector<capture_codec::Record> g_performance;
+
+void print_packet(uint64_t time_us, const uint8_t packet[4])
+{
+    uint8_t cable = packet[0] >> 4;
+    if (cable < MIDI_CABLE_COUNT)
+    {
+        ++g_packets[cable];
+    }
+    if (!g_quiet)
+    {
+        printf("%10.3f ms  cable %u  %02X %02X %02X\n", time_us / 1000.0, cable, packet[1], packet[2], packet[3]);
+    }
+}
+
+void finish()
+{
+    // The MIDI task never blocks, which starves the log task on a single core. Stop it so the logs get printed.
+    vTaskSuspend(xTaskGetHandle("UsbMidiTask"));
+
+    midi_scheduler::Stats stats = midi_scheduler::get_stats();
+    printf("Packets: %u notes, %u controllers, %u diagnostics\n", g_packets[MIDI_CABLE_NOTES],
+           g_packets[MIDI_CABLE_CONTROLLERS], g_packets[MIDI_CABLE_DIAGNOSTICS]);
+    printf("Scheduler latency: min %u us, avg %u us, max %u us, %u dropped\n", stats.min_latency_us,
+           stats.avg_latency_us, stats.max_latency_us, stats.dropped);
+    profiler::log_summary();
+    task_stats::log_summary();
+
+    vTaskDelay(pdMS_TO_TICKS(100));
+    fflush(stdout);
+    exit(0);
+}
+
+// Plays the performance and acts as the USB host, one frame per tick
+void sim_task(void* params)
+{
+    (void)params;
+    const uint64_t start = hal::time_us_64();
+    TickType_t wake = xTaskGetTickCount();
+    size_t next = 0;
+    while (next < g_performance.size())
+    {
+        const uint64_t t_us = hal::time_us_64() - start;
+        for (; next < g_performance.size() && g_performance[next].timestamp_us <= t_us; ++next)
+        {
+            sim::apply(g_performance[next]);
+        }
+        sim::start_of_frame();
+        vTaskDelayUntil(&wake, 1);
+    }
+    finish();
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "d:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            g_duration_ms = static_cast<uint32_t>(atof(optarg) * 1000);
+            break;
+        case 'q':
+            g_quiet = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d seconds] [-q]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    g_performance = sim::scripted_performance(g_duration_ms);
+    sim::reset();
+    sim::set_packet_sink(print_packet);
+
+    // Same start up as vLaunch() in membrain.cpp, without the LED task
+    trace::init();
+    logger::init_logging();
+    midi_scheduler::init();
+    hal::adc_init();
+    init_vl6180x();
+    init_cap_touch();
+    start_midi_task();
+
+    xTaskCreate(sim_task, "SimTask", SIM_TASK_STACK_SIZE, nullptr, SIM_TASK_PRIORITY, nullptr);
+    vTaskStartScheduler();
+    return 0;
+}
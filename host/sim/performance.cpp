@@ -0,0 +1,114 @@
+#include "performance.h"
+
+#include <iterator>
+
+#include "simulated_board.h"
+#include "vl6180.h"
+
+namespace
+{
+constexpr uint32_t kNumHallChannels = 3;
+
+// Charge count of an untouched pad, what a touch adds, just over cap_touch's threshold, and what pressing harder adds
+constexpr uint32_t kIdleTotal = sim::kCapIdlePolls * sim::kTouchSamples;
+constexpr uint32_t kTouchTotal = 60000;
+constexpr uint32_t kPressureTotal = 200000;
+
+constexpr uint32_t kPiezoPeriodMs = 500;
+constexpr uint32_t kPiezoPulseMs = 20;
+constexpr uint32_t kPadPeriodMs = 400;
+constexpr uint32_t kPadHoldMs = 300;
+constexpr uint32_t kHallPeriodMs = 2000;
+constexpr float kHallMaxDeflection = 0.5f;
+constexpr uint32_t kRangePeriodMs = 3000;
+constexpr uint8_t kRangeMinMm = 5;
+constexpr uint8_t kRangeSpanMm = 15;
+
+// 0 to 1 and back over one period
+float triangle(uint32_t t_ms, uint32_t period_ms)
+{
+    float phase = static_cast<float>(t_ms % period_ms) / period_ms;
+    return phase < 0.5f ? 2.f * phase : 2.f * (1.f - phase);
+}
+
+capture_codec::Record record(uint8_t stream, uint32_t t_ms, int32_t v0, int32_t v1 = 0, int32_t v2 = 0)
+{
+    capture_codec::Record record = {};
+    record.stream = stream;
+    record.keyframe = true;
+    record.valid = true;
+    record.count = stream == sim::kPiezoStream ? 1 : capture_codec::value_count(stream);
+    record.timestamp_us = t_ms * 1000ull;
+    record.values[0] = v0;
+    record.values[1] = v1;
+    record.values[2] = v2;
+    return record;
+}
+} // namespace
+
+namespace sim
+{
+void apply(const capture_codec::Record& record)
+{
+    if (!record.valid)
+    {
+        return;
+    }
+
+    if (record.stream == capture_codec::Hall)
+    {
+        for (uint32_t channel = 0; channel < kNumHallChannels; ++channel)
+        {
+            set_adc(channel, static_cast<uint16_t>(record.values[channel]));
+        }
+    }
+    else if (record.stream >= capture_codec::CapTouch0 && record.stream < capture_codec::Range)
+    {
+        const uint32_t pad = record.stream - capture_codec::CapTouch0;
+        if (pad < std::size(kTouchGpios))
+        {
+            set_cap_total(kTouchGpios[pad], static_cast<uint32_t>(record.values[0]), kTouchSamples);
+        }
+    }
+    else if (record.stream == capture_codec::Range)
+    {
+        set_range(static_cast<uint8_t>(record.values[0]), static_cast<uint8_t>(record.values[1]));
+    }
+    else if (record.stream == kPiezoStream)
+    {
+        set_gpio_input(kPiezoGpio, record.values[0] != 0);
+    }
+}
+
+std::vector<capture_codec::Record> scripted_performance(uint32_t duration_ms)
+{
+    std::vector<capture_codec::Record> records;
+    records.reserve(duration_ms * (std::size(kTouchGpios) + 3));
+
+    for (uint32_t t_ms = 0; t_ms < duration_ms; ++t_ms)
+    {
+        // The comparator output stays high for kPiezoPulseMs after a strike
+        records.push_back(record(kPiezoStream, t_ms, t_ms % kPiezoPeriodMs < kPiezoPulseMs));
+
+        const uint32_t pad = (t_ms / kPadPeriodMs) % std::size(kTouchGpios);
+        const uint32_t held_ms = t_ms % kPadPeriodMs;
+        for (uint32_t i = 0; i < std::size(kTouchGpios); ++i)
+        {
+            uint32_t total = kIdleTotal;
+            if (i == pad && held_ms < kPadHoldMs)
+            {
+                total += kTouchTotal + kPressureTotal * held_ms / kPadHoldMs;
+            }
+            records.push_back(record(capture_codec::CapTouch0 + i, t_ms, total));
+        }
+
+        const float deflection = kHallMaxDeflection * triangle(t_ms, kHallPeriodMs);
+        const int32_t hall = static_cast<int32_t>(2048 + deflection * 2047);
+        records.push_back(record(capture_codec::Hall, t_ms, hall, hall, hall));
+
+        const float range = kRangeMinMm + kRangeSpanMm * triangle(t_ms, kRangePeriodMs);
+        records.push_back(record(capture_codec::Range, t_ms, static_cast<int32_t>(range), VL6180X_ERROR_NONE));
+    }
+    return records;
+}
+} // namespace sim
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "capture_codec.h"
+
+// Sensor input of the simulations as capture records, so that recorded captures, CSV files and the scripted
+// performance all drive the simulated board the same way
+namespace sim
+{
+// Level of the piezo comparator in v0. Captures do not record it, only CSV input and the script use this stream.
+constexpr uint8_t kPiezoStream = capture_codec::NumStreams;
+
+// Wiring and cap-touch sample count of midi_controller.cpp
+constexpr uint32_t kPiezoGpio = 14;
+constexpr uint32_t kTouchGpios[] = {16, 17, 18, 19};
+constexpr uint32_t kTouchSamples = 2000;
+
+// Sets the simulated sensors to the values of a record. Streams without a sensor on the board are ignored.
+void apply(const capture_codec::Record& record);
+
+// Every stream once per millisecond for duration_ms, in time order: a piezo strike every 500 ms, the pads held in
+// turn and pressed harder the longer they are held, the membrane pushed in and released evenly over the Hall sensors
+// and a hand moving over the range sensor.
+std::vector<capture_codec::Record> scripted_performance(uint32_t duration_ms);
+} // namespace sim
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Controls of the simulated peripherals behind the Linux HAL (hal_linux.h). The scenario of membrain_sim sets the
+// sensor inputs, runs the USB frames and receives what the firmware sends, as the board's analog front end and the USB
+// host would. Sensor values can be changed from any task at any time.
+namespace sim
+{
+// Untouched cap-touch pads charge through the pull-up in this many gpio_get() polls (cap_touch.cpp counts them)
+constexpr uint32_t kCapIdlePolls = 10;
+constexpr size_t kMidiTxFifoPackets = 16; // CFG_TUD_MIDI_TX_BUFSIZE of a full speed device
+constexpr uint8_t kVl6180ModelId = 0xB4;
+
+// Called with every USB-MIDI event packet the host receives, at the time of the frame that carried it
+using PacketSink = std::function<void(uint64_t time_us, const uint8_t packet[4])>;
+
+// Resets every peripheral to its idle state: Hall sensors centred, pads untouched, piezo low, nothing in range
+void reset();
+
+// 12-bit ADC conversion result of a channel
+void set_adc(uint32_t channel, uint16_t value);
+
+// Level of an input pin driven from outside, like the piezo comparator
+void set_gpio_input(uint32_t pin, bool level);
+
+// Charge time of a cap-touch pad as the total of polls cap_touch.cpp counts over samples discharges, samples times
+// kCapIdlePolls untouched and more the more the pad is covered. Polls are spread so that every read of that many
+// samples gets the exact total.
+void set_cap_total(uint32_t pin, uint32_t total, uint32_t samples);
+
+// Target seen by the VL6180X: the range in mm and the error code of the next measurements (VL6180X_ERROR_*)
+void set_range(uint8_t range_mm, uint8_t status);
+
+// Makes the VL6180X stop acknowledging its address, as with a loose cable
+void set_i2c_connected(bool connected);
+
+void set_usb_mounted(bool mounted);
+void set_packet_sink(PacketSink sink);
+
+// Runs one USB frame: calls tud_sof_cb() if the firmware enabled it, then delivers the transmit FIFO to the sink.
+// The scenario calls it every millisecond, unless the clock is virtual.
+void start_of_frame();
+
+// Time the firmware spends in the HAL on the virtual clock. The defaults are for the RP2350 at 150 MHz: a few cycles
+// per SIO access and poll loop iteration, and a 96 clock conversion at 48 MHz for the ADC. I2C transfers take nine bit
+// times per byte at the rate given to i2c_init(). Code outside the HAL runs in no time.
+struct HalCosts
+{
+    uint32_t gpio_ns = 30;
+    uint32_t adc_ns = 2000;
+};
+
+// Switches the HAL from the system clock to a virtual one starting at 0, for deterministic runs. Time then only moves
+// when the firmware calls the HAL or sleeps, and start_of_frame() runs by itself on every millisecond boundary the
+// firmware crosses, deferred to the end of a hal::CriticalSection like the SOF interrupt. Only one task may call the
+// HAL once it is enabled. Call before anything else.
+void use_virtual_clock(const HalCosts& costs);
+
+// Queues MIDI bytes from the host for the firmware to read, SysEx commands in practice
+void send_to_device(const uint8_t* data, size_t size);
+
+// Base color (GRB) of a status pixel as last set through leds.h, animations are not rendered
+uint32_t led_color(uint32_t pixel);
+} // namespace sim
@@ -0,0 +1,206 @@
+// Checks the Q15 kernels of app/includes/sensor_math.h against the float ones, which are the reference, over their
+// whole input range. Every Q15 input is given to the float kernel as the same value, except that the largest Q15
+// stands for 1 in the conversions to MIDI values (see sensor_math.h). Float results are quantized to Q15 rounded to
+// nearest, ties up like fixed::narrow.
+//
+// to_cc and the range normalization of the firmware match exactly. The other kernels are exact where the float
+// reference is rounded to 24 bits, so an exact result within a float step of a rounding point can land on the other
+// side of it in the reference. Those checks allow 1 LSB on at most kMaxMismatchRate of the inputs; a kernel that rounds
+// the other way or has a bias moves far more inputs than that.
+//
+// Usage: membrain_fixed_point_test
+// Prints one line per check and exits with 1 if one fails.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "fixed_point.h"
+#include "sensor_math.h"
+
+namespace
+{
+constexpr double kMaxMismatchRate = 0.001;
+
+// Parameters the firmware uses (midi_controller.cpp)
+constexpr float kOnePoleA1[] = {0.5f, 0.8f}; // Range, then Hall and slider
+constexpr fixed::Q15 kStrikePositionMinWeight = fixed::q15(0.02f);
+constexpr uint8_t kRangeMinMm = 5;
+constexpr uint8_t kRangeMaxMm = 17;
+
+constexpr uint16_t kAdcMax = 4095;
+constexpr int kOnePoleSequenceSteps = 1000000;
+
+class Check
+{
+  public:
+    Check(const char* name, int32_t tolerance) : name_(name), tolerance_(tolerance)
+    {
+    }
+
+    void compare(int32_t fixed, int32_t reference)
+    {
+        ++inputs_;
+        int32_t difference = std::abs(fixed - reference);
+        if (difference != 0)
+        {
+            ++mismatches_;
+            max_difference_ = std::max(max_difference_, difference);
+        }
+    }
+
+    bool report() const
+    {
+        bool passed = max_difference_ <= tolerance_ &&
+                      (tolerance_ == 0 || mismatches_ <= static_cast<uint64_t>(inputs_ * kMaxMismatchRate));
+        printf("%-28s %11llu inputs %8llu differ, by at most %d  %s\n", name_,
+               static_cast<unsigned long long>(inputs_), static_cast<unsigned long long>(mismatches_),
+               max_difference_, passed ? "ok" : "FAILED");
+        return passed;
+    }
+
+  private:
+    const char* name_;
+    int32_t tolerance_;
+    uint64_t inputs_ = 0;
+    uint64_t mismatches_ = 0;
+    int32_t max_difference_ = 0;
+};
+
+int32_t quantize(float x)
+{
+    return fixed::saturate16(static_cast<int32_t>(std::floor(static_cast<double>(x) * 32768.0 + 0.5)));
+}
+
+float midi_input(fixed::Q15 x)
+{
+    return x.raw == INT16_MAX ? 1.f : fixed::to_float(x);
+}
+
+template <typename Compare>
+void for_each_q15(Compare compare)
+{
+    for (int32_t raw = INT16_MIN; raw <= INT16_MAX; ++raw)
+    {
+        compare(fixed::Q15{static_cast<int16_t>(raw)});
+    }
+}
+
+bool check_midi_conversions()
+{
+    Check pitch_bend("to_pitch_bend", 1);
+    Check cc("to_cc", 0);
+    Check cc14("to_cc14", 1);
+    for_each_q15(
+        [&](fixed::Q15 x)
+        {
+            pitch_bend.compare(sensor_math::to_pitch_bend(x), sensor_math::to_pitch_bend(midi_input(x)));
+            cc.compare(sensor_math::to_cc(x), sensor_math::to_cc(midi_input(x)));
+            cc14.compare(sensor_math::to_cc14(x), sensor_math::to_cc14(midi_input(x)));
+        });
+    return pitch_bend.report() & cc.report() & cc14.report();
+}
+
+// The second and third sensors over every ADC code, the first one at 17 codes across its range
+bool check_strike_position()
+{
+    Check check("strike_position", 1);
+    const fixed::Q15 previous = fixed::q15(0.25f);
+    for (uint32_t code1 = 0; code1 <= kAdcMax + 1; code1 += 256)
+    {
+        const uint16_t adc1 = static_cast<uint16_t>(std::min<uint32_t>(code1, kAdcMax));
+        for (uint16_t adc2 = 0; adc2 <= kAdcMax; ++adc2)
+        {
+            for (uint16_t adc3 = 0; adc3 <= kAdcMax; ++adc3)
+            {
+                fixed::Q15 position = sensor_math::strike_position(
+                    sensor_math::hall_deflection<fixed::Q15>(adc1), sensor_math::hall_deflection<fixed::Q15>(adc2),
+                    sensor_math::hall_deflection<fixed::Q15>(adc3), kStrikePositionMinWeight, previous);
+                float reference = sensor_math::strike_position(
+                    sensor_math::hall_deflection(adc1), sensor_math::hall_deflection(adc2),
+                    sensor_math::hall_deflection(adc3), fixed::to_float(kStrikePositionMinWeight),
+                    fixed::to_float(previous));
+                check.compare(position.raw, quantize(reference));
+            }
+        }
+    }
+    return check.report();
+}
+
+// One step from every input and a grid of previous outputs, then a long run of steps and noise so that the Q31 state
+// and the float one can drift apart
+bool check_one_pole()
+{
+    bool passed = true;
+    for (float coefficient : kOnePoleA1)
+    {
+        const fixed::Q15 a1 = fixed::q15(coefficient);
+        const float a1_reference = fixed::to_float(a1);
+
+        char name[32];
+        snprintf(name, sizeof(name), "one_pole a1=%.2f step", coefficient);
+        Check step(name, 1);
+        for_each_q15(
+            [&](fixed::Q15 x)
+            {
+                for (int32_t previous = INT16_MIN; previous <= INT16_MAX; previous += 97)
+                {
+                    fixed::Q15 y = fixed::narrow(
+                        sensor_math::one_pole(x, fixed::widen({static_cast<int16_t>(previous)}), a1));
+                    float reference = sensor_math::one_pole(fixed::to_float(x), previous / 32768.f, a1_reference);
+                    step.compare(y.raw, quantize(reference));
+                }
+            });
+        passed &= step.report();
+
+        snprintf(name, sizeof(name), "one_pole a1=%.2f sequence", coefficient);
+        Check sequence(name, 1);
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int32_t> sample(INT16_MIN, INT16_MAX);
+        fixed::Q31 state = {0};
+        float state_reference = 0.f;
+        fixed::Q15 level = {0};
+        for (int i = 0; i < kOnePoleSequenceSteps; ++i)
+        {
+            // Holds a level for a while, alternating with runs of noise
+            if (i % 5000 == 0)
+            {
+                level = {static_cast<int16_t>(sample(random))};
+            }
+            fixed::Q15 x = (i / 5000) % 2 ? fixed::Q15{static_cast<int16_t>(sample(random))} : level;
+            state = sensor_math::one_pole(x, state, a1);
+            state_reference = sensor_math::one_pole(fixed::to_float(x), state_reference, a1_reference);
+            sequence.compare(fixed::narrow(state).raw, quantize(state_reference));
+        }
+        passed &= sequence.report();
+    }
+    return passed;
+}
+
+bool check_normalize_range()
+{
+    const fixed::Q15 min = sensor_math::range_fraction<fixed::Q15>(kRangeMinMm);
+    const fixed::Q15 max = sensor_math::range_fraction<fixed::Q15>(kRangeMaxMm);
+    Check check("normalize_range", 0);
+    for_each_q15(
+        [&](fixed::Q15 range)
+        {
+            float reference =
+                sensor_math::normalize_range(fixed::to_float(range), fixed::to_float(min), fixed::to_float(max));
+            check.compare(sensor_math::normalize_range(range, min, max).raw, quantize(reference));
+        });
+    return check.report();
+}
+} // namespace
+
+int main()
+{
+    bool passed = check_midi_conversions();
+    passed &= check_strike_position();
+    passed &= check_one_pole();
+    passed &= check_normalize_range();
+    return passed ? 0 : 1;
+}
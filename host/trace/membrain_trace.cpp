@@ -0,0 +1,340 @@
+// Converts a scheduler trace dump (membrain_capture -t) into the Chrome trace event format, which Perfetto
+// (ui.perfetto.dev) and chrome://tracing open directly.
+//
+// Usage: membrain_trace <dump file> <output.json>
+// Every core gets a track with the tasks it ran, including queue and notification events, and a track with its
+// interrupts. Every task gets a track with the spans it recorded. The buffer layout is described in
+// app/includes/trace_format.h.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+
+namespace
+{
+constexpr int kPid = 1;
+constexpr int kCoreTrackBase = 1;
+constexpr int kIsrTrackBase = 10;
+constexpr int kTaskTrackBase = 100;
+
+struct Event
+{
+    int64_t time_us;
+    uint32_t core;
+    trace::Event type;
+    uint16_t arg;
+};
+
+struct OpenSlice
+{
+    int64_t start_us;
+    uint16_t id;
+};
+
+std::string escape(const std::string& text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        if (static_cast<unsigned char>(c) >= 0x20)
+        {
+            out += c;
+        }
+    }
+    return out;
+}
+
+class Writer
+{
+  public:
+    explicit Writer(FILE* file) : file_(file)
+    {
+        fprintf(file_, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    }
+
+    ~Writer()
+    {
+        fprintf(file_, "\n]}\n");
+    }
+
+    void track_name(int tid, const std::string& name, int sort_index)
+    {
+        begin();
+        fprintf(file_, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}", kPid,
+                tid, escape(name).c_str());
+        begin();
+        fprintf(file_, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}",
+                kPid, tid, sort_index);
+    }
+
+    void process_name(const std::string& name)
+    {
+        begin();
+        fprintf(file_, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}", kPid,
+                escape(name).c_str());
+    }
+
+    void slice(int tid, const std::string& name, const char* category, int64_t start_us, int64_t end_us)
+    {
+        begin();
+        fprintf(file_, "{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"cat\":\"%s\",\"ts\":%lld,\"dur\":%lld}",
+                kPid, tid, escape(name).c_str(), category, static_cast<long long>(start_us),
+                static_cast<long long>(std::max<int64_t>(end_us - start_us, 0)));
+    }
+
+    void instant(int tid, const std::string& name, int64_t time_us, const std::string& args)
+    {
+        begin();
+        fprintf(file_, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%lld,\"args\":{%s}}",
+                kPid, tid, escape(name).c_str(), static_cast<long long>(time_us), args.c_str());
+    }
+
+  private:
+    void begin()
+    {
+        fprintf(file_, first_ ? "" : ",\n");
+        first_ = false;
+    }
+
+    FILE* file_;
+    bool first_ = true;
+};
+
+std::string task_name(const trace::Header& header, uint16_t number)
+{
+    if (number == 0 || number >= trace::kMaxTasks || header.task_names[number][0] == '\0')
+    {
+        return "task " + std::to_string(number);
+    }
+    return std::string(header.task_names[number], strnlen(header.task_names[number], trace::kTaskNameSize));
+}
+
+template <size_t N>
+std::string lookup(const char* const (&names)[N], uint16_t id, const char* fallback)
+{
+    return id < N ? names[id] : std::string(fallback) + " " + std::to_string(id);
+}
+
+// Reads the records of one core, oldest first. Times are unwrapped backwards from the dump time.
+std::vector<Event> read_core(const std::vector<char>& data, const trace::Header& header, uint32_t core)
+{
+    const uint32_t capacity = header.records_per_core;
+    const uint32_t written = header.write_index[core];
+    const uint32_t count = std::min(written, capacity);
+
+    std::vector<trace::Record> records(count);
+    const size_t base = sizeof(trace::Header) + static_cast<size_t>(core) * capacity * sizeof(trace::Record);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t index = (written - count + i) % capacity;
+        memcpy(&records[i], data.data() + base + index * sizeof(trace::Record), sizeof(trace::Record));
+    }
+
+    std::vector<Event> events;
+    int64_t time = header.dump_time_us;
+    uint32_t raw = header.dump_time_us;
+    for (auto it = records.rbegin(); it != records.rend(); ++it)
+    {
+        if (it->event == trace::Event::None || it->event >= trace::Event::Count)
+        {
+            continue;
+        }
+        time -= static_cast<int32_t>(raw - it->timestamp_us);
+        raw = it->timestamp_us;
+        events.push_back({time, core, it->event, it->arg});
+    }
+    std::reverse(events.begin(), events.end());
+
+    // An interrupt can write its record between another writer's slot claim and timestamp
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.time_us < b.time_us; });
+    return events;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <dump file> <output.json>\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (!input.good() && !input.eof())
+    {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return 1;
+    }
+
+    trace::Header header;
+    if (data.size() < sizeof(header))
+    {
+        fprintf(stderr, "%s is too short for a trace dump\n", argv[1]);
+        return 1;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != trace::kMagic || header.version != trace::kVersion)
+    {
+        fprintf(stderr, "%s is not a version %u trace dump\n", argv[1], static_cast<unsigned>(trace::kVersion));
+        return 1;
+    }
+    const uint32_t cores = std::min<uint32_t>(header.core_count, trace::kMaxCores);
+    if (header.records_per_core == 0 ||
+        data.size() < sizeof(header) + static_cast<size_t>(cores) * header.records_per_core * sizeof(trace::Record))
+    {
+        fprintf(stderr, "%s is truncated\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<Event> events;
+    for (uint32_t core = 0; core < cores; ++core)
+    {
+        std::vector<Event> core_events = read_core(data, header, core);
+        if (!core_events.empty())
+        {
+            fprintf(stderr, "Core %u: %zu events over %.1f ms%s\n", core, core_events.size(),
+                    (core_events.back().time_us - core_events.front().time_us) / 1000.0,
+                    header.write_index[core] > header.records_per_core ? " (ring wrapped)" : "");
+        }
+        events.insert(events.end(), core_events.begin(), core_events.end());
+    }
+    if (events.empty())
+    {
+        fprintf(stderr, "The dump contains no events\n");
+        return 1;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.time_us < b.time_us; });
+    const int64_t origin = events.front().time_us;
+    const int64_t end = events.back().time_us - origin;
+
+    FILE* output = fopen(argv[2], "w");
+    if (output == nullptr)
+    {
+        perror("Failed to open output file");
+        return 1;
+    }
+
+    {
+        Writer writer(output);
+        writer.process_name("Membrain");
+        for (uint32_t core = 0; core < cores; ++core)
+        {
+            writer.track_name(kCoreTrackBase + core, "Core " + std::to_string(core), core * 2);
+            writer.track_name(kIsrTrackBase + core, "Core " + std::to_string(core) + " interrupts", core * 2 + 1);
+        }
+        for (uint16_t task = 1; task < trace::kMaxTasks; ++task)
+        {
+            if (header.task_names[task][0] != '\0')
+            {
+                writer.track_name(kTaskTrackBase + task, task_name(header, task), kTaskTrackBase + task);
+            }
+        }
+
+        // Per core: the running task and the open interrupts. Per task: the open spans.
+        std::vector<OpenSlice> running(cores, OpenSlice{-1, 0});
+        std::vector<uint16_t> current_task(cores, 0);
+        std::vector<std::vector<OpenSlice>> isrs(cores);
+        std::vector<std::vector<OpenSlice>> spans(trace::kMaxTasks);
+
+        for (const Event& event : events)
+        {
+            const int64_t t = event.time_us - origin;
+            const int core_track = kCoreTrackBase + event.core;
+            const uint16_t task = current_task[event.core];
+            switch (event.type)
+            {
+            case trace::Event::TaskSwitchedIn:
+                running[event.core] = {t, event.arg};
+                current_task[event.core] = event.arg;
+                break;
+            case trace::Event::TaskSwitchedOut:
+                // The first switch out of a core can predate the window
+                if (running[event.core].start_us >= 0 && running[event.core].id == event.arg)
+                {
+                    writer.slice(core_track, task_name(header, event.arg), "task", running[event.core].start_us, t);
+                }
+                running[event.core].start_us = -1;
+                break;
+            case trace::Event::IsrEnter:
+                isrs[event.core].push_back({t, event.arg});
+                break;
+            case trace::Event::IsrExit:
+                if (!isrs[event.core].empty() && isrs[event.core].back().id == event.arg)
+                {
+                    writer.slice(kIsrTrackBase + event.core, lookup(trace::kIsrNames, event.arg, "irq"), "isr",
+                                 isrs[event.core].back().start_us, t);
+                    isrs[event.core].pop_back();
+                }
+                break;
+            case trace::Event::SpanBegin:
+                if (task < trace::kMaxTasks)
+                {
+                    spans[task].push_back({t, event.arg});
+                }
+                break;
+            case trace::Event::SpanEnd:
+                if (task < trace::kMaxTasks && !spans[task].empty() && spans[task].back().id == event.arg)
+                {
+                    writer.slice(kTaskTrackBase + task, lookup(trace::kSpanNames, event.arg, "span"), "span",
+                                 spans[task].back().start_us, t);
+                    spans[task].pop_back();
+                }
+                break;
+            case trace::Event::QueueSend:
+                writer.instant(core_track, "queue send", t, "\"queue\":" + std::to_string(event.arg));
+                break;
+            case trace::Event::QueueReceive:
+                writer.instant(core_track, "queue receive", t, "\"queue\":" + std::to_string(event.arg));
+                break;
+            case trace::Event::QueueBlock:
+                writer.instant(core_track, "queue block", t, "\"queue\":" + std::to_string(event.arg));
+                break;
+            case trace::Event::TaskNotify:
+                writer.instant(core_track, "notify", t, "\"task\":\"" + escape(task_name(header, event.arg)) + "\"");
+                break;
+            case trace::Event::NotifyTake:
+                writer.instant(core_track, "notify take", t, "");
+                break;
+            case trace::Event::NotifyBlock:
+                writer.instant(core_track, "notify block", t, "");
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Whatever is still open ran until the end of the window
+        for (uint32_t core = 0; core < cores; ++core)
+        {
+            if (running[core].start_us >= 0)
+            {
+                writer.slice(kCoreTrackBase + core, task_name(header, running[core].id), "task", running[core].start_us,
+                             end);
+            }
+        }
+        for (uint16_t task = 0; task < trace::kMaxTasks; ++task)
+        {
+            for (const OpenSlice& span : spans[task])
+            {
+                writer.slice(kTaskTrackBase + task, lookup(trace::kSpanNames, span.id, "span"), "span", span.start_us,
+                             end);
+            }
+        }
+    }
+
+    fclose(output);
+    fprintf(stderr, "Wrote %zu events to %s\n", events.size(), argv[2]);
+    return 0;
+}